@@ -1,6 +1,7 @@
 #ifndef ORIENTATIONESTIMATOR_H
 #define ORIENTATIONESTIMATOR_H
 
+#include "clock.h"
 #include "extkalman.h"
 
 namespace mart
@@ -17,11 +18,30 @@ public:
     static constexpr uint16_t STATE_VECS_COUNT = 4;
     static constexpr uint16_t MEAS_VECS_COUNT = 3;
     using EKF = ExtendedKalmanFilter<float, STATE_VECS_COUNT * VEC_SIZE, MEAS_VECS_COUNT * VEC_SIZE>;
+    using Measurement = EKF::Measurement;
 
-    OrientationEstimator();
+    // counterFrequency is the rate of the counter the samples are stamped with
+    explicit OrientationEstimator(uint32_t counterFrequency);
+
+    const EKF::State& state() const { return ekf_.state(); }
+    const EKF::ProcessMatrix& covariance() const { return ekf_.covariance(); }
+
+    // Forgets the estimate: zero state with a wide covariance, and the next
+    // update starts a new time base
+    void reset();
+
+    // z = (w, g, m) sampled at timestamp. dt is the exact interval to the
+    // previous update, so scheduling jitter does not enter the integration.
+    // The first call after reset() predicts with dt = 0, which only adds the
+    // process noise, before correcting.
+    void update(const EKF::Measurement& z, uint32_t timestamp);
 
 private:
+    EKF::Workspace workspace_;
     EKF ekf_;
+    CounterTime time_;
+    uint32_t lastTimestamp_{0};
+    bool started_{false};
 };
 
 }
@@ -0,0 +1,75 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+
+namespace mart
+{
+
+/*
+Bump allocator over a caller-provided buffer. Objects are never freed one by
+one, reset() releases everything at once, so there is no fragmentation and
+no heap involved. allocate() returns nullptr when the buffer is exhausted.
+*/
+class Arena
+{
+public:
+    Arena(void* buffer, std::size_t bytes)
+        : base_(static_cast<unsigned char*>(buffer)), capacity_(bytes)
+    {
+    }
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    // count value-initialised objects of T
+    template <class T>
+    T* allocate(std::size_t count)
+    {
+        static_assert(std::is_trivially_destructible<T>::value,
+                      "arena objects are never destroyed");
+
+        const std::uintptr_t start = reinterpret_cast<std::uintptr_t>(base_) + used_;
+        const std::uintptr_t aligned =
+            (start + alignof(T) - 1) & ~static_cast<std::uintptr_t>(alignof(T) - 1);
+        const std::size_t offset = aligned - reinterpret_cast<std::uintptr_t>(base_);
+        if (offset > capacity_ || count > (capacity_ - offset) / sizeof(T)) {
+            return nullptr;
+        }
+
+        T* result = reinterpret_cast<T*>(base_ + offset);
+        for (std::size_t i = 0; i < count; ++i) {
+            new (result + i) T();
+        }
+        used_ = offset + count * sizeof(T);
+        return result;
+    }
+
+    void reset() { used_ = 0; }
+
+    std::size_t used() const { return used_; }
+    std::size_t capacity() const { return capacity_; }
+
+private:
+    unsigned char* const base_;
+    const std::size_t capacity_;
+    std::size_t used_{0};
+};
+
+// An arena together with its buffer
+template <std::size_t bytes>
+class StaticArena : public Arena
+{
+public:
+    StaticArena() : Arena(buffer_, bytes) {}
+
+private:
+    alignas(std::max_align_t) unsigned char buffer_[bytes];
+};
+
+}  // namespace mart
+
+#endif /* ARENA_H */
@@ -0,0 +1,73 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <cstdint>
+
+namespace mart
+{
+
+// Source of sample timestamps, a free-running 32-bit counter such as the
+// DWT cycle counter or a timer
+using Clock = uint32_t (*)();
+
+/*
+Stamps of a free-running 32-bit counter counting at frequency Hz. Intervals
+are taken modulo 2^32, so a wrap between two stamps is harmless as long as
+they are less than one period apart: about 60 s for the cycle counter at
+72 MHz. extend() continues the count past the wraps for absolute times if
+it sees every period at least once.
+*/
+class CounterTime
+{
+public:
+    explicit CounterTime(uint32_t frequency) : frequency_(frequency) {}
+
+    uint32_t frequency() const { return frequency_; }
+
+    static uint32_t ticksBetween(uint32_t from, uint32_t to) { return to - from; }
+
+    // Whether stamp a was taken before b, for stamps less than half a
+    // period apart
+    static bool isBefore(uint32_t a, uint32_t b)
+    {
+        return static_cast<int32_t>(ticksBetween(b, a)) < 0;
+    }
+
+    template <class T>
+    T secondsBetween(uint32_t from, uint32_t to) const
+    {
+        return static_cast<T>(ticksBetween(from, to)) / static_cast<T>(frequency_);
+    }
+
+    template <class T>
+    T seconds(uint64_t ticks) const
+    {
+        return static_cast<T>(ticks) / static_cast<T>(frequency_);
+    }
+
+    uint64_t extend(uint32_t stamp)
+    {
+        if (stamp < last_) {
+            high_ += uint64_t(1) << 32;
+        }
+        last_ = stamp;
+        return high_ | stamp;
+    }
+
+    // Stamp of sample index of count taken evenly over (from, to], e.g. a
+    // FIFO batch between two watermark interrupts: the last one is at to
+    static uint32_t interpolate(uint32_t from, uint32_t to, uint8_t index, uint8_t count)
+    {
+        return from + static_cast<uint32_t>(
+                          static_cast<uint64_t>(ticksBetween(from, to)) * (index + 1u) / count);
+    }
+
+private:
+    uint32_t frequency_;
+    uint32_t last_{0};
+    uint64_t high_{0};
+};
+
+}  // namespace mart
+
+#endif /* CLOCK_H */
@@ -0,0 +1,253 @@
+#ifndef DYNKALMAN_H
+#define DYNKALMAN_H
+
+#include "dynmatrix.h"
+#include "sparse.h"
+#include <cmath>
+#include <functional>
+
+namespace mart
+{
+
+/*
+ExtendedKalmanFilter whose state and measurement sizes are chosen at run
+time, e.g. from a configuration file. The equations are those of extkalman.h
+and so are the callback signatures, with DynVector and DynMatrix in place
+of the fixed-size views.
+
+The filter and its workspace take their storage from an Arena when they are
+constructed and never allocate afterwards. If the arena is too small,
+valid() is false and the filter must not be used. requiredBytes() tells how
+much a given configuration needs.
+*/
+template <class T>
+struct DynamicExtendedKalmanWorkspace
+{
+    DynamicExtendedKalmanWorkspace(Arena& arena, uint16_t stateSize, uint16_t measurementSize)
+        : F(DynMatrix<T>::allocate(arena, stateSize, stateSize)),
+          H(DynMatrix<T>::allocate(arena, measurementSize, stateSize)),
+          K(DynMatrix<T>::allocate(arena, stateSize, measurementSize)),
+          S(DynMatrix<T>::allocate(arena, measurementSize, measurementSize)),
+          L(DynMatrix<T>::allocate(arena, measurementSize, measurementSize)),
+          U(DynMatrix<T>::allocate(arena, measurementSize, measurementSize)),
+          SInv(DynMatrix<T>::allocate(arena, measurementSize, measurementSize)),
+          zPredicted(DynVector<T>::allocate(arena, measurementSize)),
+          FSigma(DynMatrix<T>::allocate(arena, stateSize, stateSize)),
+          HSigma(DynMatrix<T>::allocate(arena, measurementSize, stateSize)),
+          SigmaHT(DynMatrix<T>::allocate(arena, stateSize, measurementSize)),
+          SInvInnovation(DynVector<T>::allocate(arena, measurementSize))
+    {
+    }
+
+    static std::size_t requiredBytes(uint16_t stateSize, uint16_t measurementSize)
+    {
+        const std::size_t n = stateSize, m = measurementSize;
+        return (2 * n * n + 4 * n * m + 4 * m * m + 2 * m) * sizeof(T) + alignof(T);
+    }
+
+    bool valid() const
+    {
+        return F.valid() && H.valid() && K.valid() && S.valid() && L.valid() &&
+               U.valid() && SInv.valid() && zPredicted.valid() && FSigma.valid() &&
+               HSigma.valid() && SigmaHT.valid() && SInvInnovation.valid();
+    }
+
+    DynMatrix<T> F;
+    DynMatrix<T> H;
+    DynMatrix<T> K;
+    DynMatrix<T> S;
+    DynMatrix<T> L;
+    DynMatrix<T> U;
+    DynMatrix<T> SInv;
+    DynVector<T> zPredicted;
+
+    // Intermediate products
+    DynMatrix<T> FSigma;
+    DynMatrix<T> HSigma;
+    DynMatrix<T> SigmaHT;
+    DynVector<T> SInvInnovation;
+};
+
+template <class T>
+class DynamicExtendedKalmanFilter
+{
+public:
+    using ValueType = T;
+
+    using State = DynVector<ValueType>;
+    using ProcessFunction =
+        std::function<void(State&, const State&, ValueType)>;
+    using ProcessMatrix = DynMatrix<ValueType>;
+    using GetProcessJacobianFunction =
+        std::function<void(const State&, ProcessMatrix&, ValueType)>;
+
+    using Measurement = DynVector<ValueType>;
+    using MeasurementFunction =
+        std::function<void(const State&, Measurement&, ValueType)>;
+    using MeasurementMatrix = DynMatrix<ValueType>;
+    using GetMeasurementJacobianFunction =
+        std::function<void(const State&, MeasurementMatrix&, ValueType)>;
+    using InnovationMatrix = DynMatrix<ValueType>;
+
+    using Workspace = DynamicExtendedKalmanWorkspace<ValueType>;
+
+    // The covariances are copied into the arena
+    DynamicExtendedKalmanFilter(
+        Arena& arena,
+        uint16_t stateSize,
+        uint16_t measurementSize,
+        ProcessFunction f,
+        GetProcessJacobianFunction getProcessJacobian,
+        const ProcessMatrix& processCovariance,
+        MeasurementFunction h,
+        GetMeasurementJacobianFunction getMeasurementJacobian,
+        const InnovationMatrix& measurementCovariance
+        ) :
+        f_(std::move(f)),
+        getProcessJacobian_(std::move(getProcessJacobian)),
+        h_(std::move(h)),
+        getMeasurementJacobian_(std::move(getMeasurementJacobian)),
+        R_(ProcessMatrix::allocate(arena, stateSize, stateSize)),
+        Q_(InnovationMatrix::allocate(arena, measurementSize, measurementSize)),
+        muPost_(State::allocate(arena, stateSize)),
+        muPrio_(State::allocate(arena, stateSize)),
+        SigmaPost_(ProcessMatrix::allocate(arena, stateSize, stateSize)),
+        SigmaPrio_(ProcessMatrix::allocate(arena, stateSize, stateSize)),
+        innovation_(Measurement::allocate(arena, measurementSize))
+    {
+        valid_ = R_.valid() && Q_.valid() && muPost_.valid() && muPrio_.valid() &&
+                 SigmaPost_.valid() && SigmaPrio_.valid() && innovation_.valid() &&
+                 copy(processCovariance, R_) && copy(measurementCovariance, Q_);
+    }
+
+    static std::size_t requiredBytes(uint16_t stateSize, uint16_t measurementSize)
+    {
+        const std::size_t n = stateSize, m = measurementSize;
+        return (3 * n * n + 2 * n + m * m + m) * sizeof(T) + alignof(T);
+    }
+
+    bool valid() const { return valid_; }
+
+    uint16_t stateSize() const { return muPost_.size(); }
+    uint16_t measurementSize() const { return innovation_.size(); }
+
+    const State& state() const { return muPost_; }
+    const ProcessMatrix& covariance() const { return SigmaPost_; }
+
+    const State& priorState() const { return muPrio_; }
+    const ProcessMatrix& priorCovariance() const { return SigmaPrio_; }
+
+    const Measurement& innovation() const { return innovation_; }
+
+    const ProcessMatrix& processJacobian(const Workspace& ws) const { return ws.F; }
+
+    ValueType logLikelihood() const { return logLikelihood_; }
+
+    bool reset(const State& mu, const ProcessMatrix& Sigma)
+    {
+        return copy(mu, muPost_) && copy(Sigma, SigmaPost_);
+    }
+
+    void update(const Measurement& z, ValueType dt, Workspace& ws)
+    {
+        predict(dt, ws);
+        correct(z, dt, ws);
+    }
+
+    void predict(ValueType dt, Workspace& ws)
+    {
+        getProcessJacobian_(muPost_, ws.F, dt);
+        f_(muPrio_, muPost_, dt);
+
+        multiply(ws.F, SigmaPost_, ws.FSigma);
+        multiply(ws.FSigma, transposed(ws.F), SigmaPrio_);
+        add(SigmaPrio_, R_, SigmaPrio_);
+    }
+
+    void correct(const Measurement& z, ValueType dt, Workspace& ws)
+    {
+        getMeasurementJacobian_(muPrio_, ws.H, dt);
+
+        multiply(ws.H, SigmaPrio_, ws.HSigma);
+        multiply(ws.HSigma, transposed(ws.H), ws.S);
+        innovate(z, dt, ws);
+
+        multiply(SigmaPrio_, transposed(ws.H), ws.SigmaHT);
+        gain(ws);
+
+        // (I - K*H) * Sigma_prio = Sigma_prio - K * (H * Sigma_prio)
+        multiply(ws.K, ws.HSigma, ws.FSigma);
+        subtract(SigmaPrio_, ws.FSigma, SigmaPost_);
+    }
+
+    // Correction with a Jacobian known in sparse form, e.g. a sensor that
+    // observes a few states of a large model: S and Sigma_prio * H^T cost
+    // O(nnz^2) and O(n * nnz) instead of O(m * n^2). getMeasurementJacobian
+    // is not called and ws.H is left alone.
+    void correct(const Measurement& z, ValueType dt,
+                 const CsrMatrix<ValueType>& H, Workspace& ws)
+    {
+        sandwich(H, SigmaPrio_, ws.S);
+        innovate(z, dt, ws);
+
+        multiplyTransposed(SigmaPrio_, H, ws.SigmaHT);
+        gain(ws);
+
+        // H * Sigma_prio = (Sigma_prio * H^T)^T as Sigma_prio is symmetric
+        multiply(ws.K, transposed(ws.SigmaHT), ws.FSigma);
+        subtract(SigmaPrio_, ws.FSigma, SigmaPost_);
+    }
+
+private:
+    // S += Q and its factors, the innovation and the log-likelihood
+    void innovate(const Measurement& z, ValueType dt, Workspace& ws)
+    {
+        add(ws.S, Q_, ws.S);
+        luDecompose(ws.S, ws.L, ws.U);
+        luInverse(ws.L, ws.U, ws.SInv);
+
+        h_(muPrio_, ws.zPredicted, dt);
+        subtract(z, ws.zPredicted, innovation_);
+
+        const uint16_t m = innovation_.size();
+        ValueType logDet = 0;
+        for (uint16_t i = 0; i < m; ++i) {
+            logDet += std::log(std::abs(ws.U(i, i)));
+        }
+        multiply(ws.SInv, innovation_, ws.SInvInnovation);
+        ValueType mahalanobis = 0;
+        for (uint16_t i = 0; i < m; ++i) {
+            mahalanobis += innovation_[i] * ws.SInvInnovation[i];
+        }
+        constexpr ValueType LOG_2PI = 1.8378770664093453;
+        logLikelihood_ = ValueType(-0.5) * (m * LOG_2PI + logDet + mahalanobis);
+    }
+
+    // K = Sigma_prio * H^T * S^-1 from ws.SigmaHT, and the posterior mean
+    void gain(Workspace& ws)
+    {
+        multiply(ws.SigmaHT, ws.SInv, ws.K);
+        multiply(ws.K, innovation_, muPost_);
+        add(muPost_, muPrio_, muPost_);
+    }
+
+    const ProcessFunction f_;
+    const GetProcessJacobianFunction getProcessJacobian_;
+    const MeasurementFunction h_;
+    const GetMeasurementJacobianFunction getMeasurementJacobian_;
+
+    ProcessMatrix R_;
+    InnovationMatrix Q_;
+
+    State muPost_;
+    State muPrio_;
+    ProcessMatrix SigmaPost_;
+    ProcessMatrix SigmaPrio_;
+    Measurement innovation_;
+    ValueType logLikelihood_{0};
+    bool valid_{false};
+};
+
+}  // namespace mart
+
+#endif /* DYNKALMAN_H */
@@ -0,0 +1,353 @@
+#ifndef DYNMATRIX_H
+#define DYNMATRIX_H
+
+#include "arena.h"
+#include "kernels.h"
+#include "matrix.h"
+#include "vector.h"
+#include <cstdint>
+
+namespace mart
+{
+
+/*
+Runtime-sized counterparts of Vector and Matrix for host tooling that reads
+its dimensions from a configuration. Like the fixed-size types they are
+views: a pointer plus the dimensions and strides. Storage comes from an
+Arena through allocate(), or from a fixed-size matrix, and a DynMatrix of
+matching shape can be looked at as a fixed-size view again with fixed().
+
+Nothing allocates behind the caller's back, so the operations are free
+functions writing to an output argument. They return false, leaving the
+output untouched, when the shapes do not agree. The output of a product
+must not alias an operand.
+*/
+
+template <class T>
+class DynVector
+{
+public:
+    using Type = T;
+
+    DynVector() = default;
+
+    DynVector(T* data, uint16_t size, uint16_t stride = 1)
+        : d_(data), size_(size), stride_(stride)
+    {
+    }
+
+    template <uint16_t size>
+    DynVector(const Vector<T, size>& vec)
+        : DynVector(const_cast<T*>(vec.raw()), size, vec.stride())
+    {
+    }
+
+    // Zero-filled, invalid if the arena is exhausted
+    static DynVector<T> allocate(Arena& arena, uint16_t size)
+    {
+        T* data = arena.template allocate<T>(size);
+        return data != nullptr ? DynVector<T>(data, size) : DynVector<T>();
+    }
+
+    bool valid() const { return d_ != nullptr; }
+
+    uint16_t size() const { return size_; }
+    uint16_t stride() const { return stride_; }
+
+    const T* raw() const { return d_; }
+    T* raw() { return d_; }
+
+    T& operator[](uint16_t i) { return d_[i * stride_]; }
+    T operator[](uint16_t i) const { return d_[i * stride_]; }
+
+    // Null view unless the sizes match
+    template <uint16_t size>
+    Vector<T, size> fixed() const
+    {
+        return Vector<T, size>(size == size_ ? d_ : nullptr, stride_);
+    }
+
+private:
+    T* d_{nullptr};
+    uint16_t size_{0};
+    uint16_t stride_{1};
+};
+
+template <class T>
+class DynMatrix
+{
+public:
+    using Type = T;
+
+    DynMatrix() = default;
+
+    DynMatrix(T* data, uint16_t rows, uint16_t cols)
+        : DynMatrix(data, rows, cols, cols)
+    {
+    }
+
+    DynMatrix(T* data, uint16_t rows, uint16_t cols, uint16_t stride)
+        : d_(data), rows_(rows), cols_(cols), stride_(stride)
+    {
+    }
+
+    template <uint16_t nrows, uint16_t ncols>
+    DynMatrix(const Matrix<T, nrows, ncols>& mat)
+        : DynMatrix(const_cast<T*>(mat.raw()), nrows, ncols, mat.stride())
+    {
+    }
+
+    // Zero-filled, invalid if the arena is exhausted
+    static DynMatrix<T> allocate(Arena& arena, uint16_t rows, uint16_t cols)
+    {
+        T* data = arena.template allocate<T>(static_cast<std::size_t>(rows) * cols);
+        return data != nullptr ? DynMatrix<T>(data, rows, cols) : DynMatrix<T>();
+    }
+
+    bool valid() const { return d_ != nullptr; }
+
+    uint16_t rows() const { return rows_; }
+    uint16_t cols() const { return cols_; }
+
+    // Distance between the starts of two consecutive rows
+    uint16_t stride() const { return stride_; }
+
+    const T* raw() const { return d_; }
+    T* raw() { return d_; }
+
+    T& operator()(uint16_t row, uint16_t col) { return d_[row * stride_ + col]; }
+    T operator()(uint16_t row, uint16_t col) const { return d_[row * stride_ + col]; }
+
+    DynMatrix<T> submat(uint16_t fromRow, uint16_t fromCol, uint16_t rows, uint16_t cols) const
+    {
+        return DynMatrix<T>(d_ + fromRow * stride_ + fromCol, rows, cols, stride_);
+    }
+
+    DynVector<T> row(uint16_t i) const { return DynVector<T>(d_ + i * stride_, cols_); }
+    DynVector<T> col(uint16_t j) const { return DynVector<T>(d_ + j, rows_, stride_); }
+    DynVector<T> diag() const { return DynVector<T>(d_, rows_ < cols_ ? rows_ : cols_, stride_ + 1); }
+
+    // Null view unless the shapes match
+    template <uint16_t nrows, uint16_t ncols>
+    Matrix<T, nrows, ncols> fixed() const
+    {
+        const bool match = nrows == rows_ && ncols == cols_;
+        return Matrix<T, nrows, ncols>(match ? d_ : nullptr, stride_ - ncols);
+    }
+
+    void fill(T value)
+    {
+        for (uint16_t row = 0; row < rows_; ++row) {
+            for (uint16_t col = 0; col < cols_; ++col) {
+                (*this)(row, col) = value;
+            }
+        }
+    }
+
+    void setIdentity()
+    {
+        fill(0);
+        for (uint16_t i = 0; i < rows_ && i < cols_; ++i) {
+            (*this)(i, i) = 1;
+        }
+    }
+
+private:
+    T* d_{nullptr};
+    uint16_t rows_{0};
+    uint16_t cols_{0};
+    uint16_t stride_{0};
+};
+
+// A DynMatrix read with its index order swapped, for products only
+template <class T>
+struct DynTransposed {
+    DynMatrix<T> m;
+};
+
+template <class T>
+DynTransposed<T> transposed(const DynMatrix<T>& m)
+{
+    return {m};
+}
+
+// Shape and kernel operand of a product argument
+template <class T>
+struct DynOperand {
+    uint16_t rows;
+    uint16_t cols;
+    kernel::Operand<T> op;
+};
+
+template <class T>
+DynOperand<T> dynOperand(const DynMatrix<T>& m)
+{
+    return {m.rows(), m.cols(), {m.raw(), m.stride(), 1, 1}};
+}
+
+template <class T>
+DynOperand<T> dynOperand(const DynTransposed<T>& t)
+{
+    return {t.m.cols(), t.m.rows(), {t.m.raw(), 1, t.m.stride(), 1}};
+}
+
+// c = a * b, a and b are DynMatrix or transposed(DynMatrix)
+template <class T, class A, class B>
+bool multiply(const A& a, const B& b, DynMatrix<T>& c)
+{
+    const DynOperand<T> x = dynOperand(a);
+    const DynOperand<T> y = dynOperand(b);
+    if (x.cols != y.rows || c.rows() != x.rows || c.cols() != y.cols) {
+        return false;
+    }
+    kernel::multiply<T>(x.rows, x.cols, y.cols, x.op, y.op, c.raw(), c.stride());
+    return true;
+}
+
+// y = a * x
+template <class T>
+bool multiply(const DynMatrix<T>& a, const DynVector<T>& x, DynVector<T>& y)
+{
+    if (a.cols() != x.size() || a.rows() != y.size()) {
+        return false;
+    }
+    kernel::multiplyVector<T>(a.rows(), a.cols(), a.raw(), a.stride(),
+                              x.raw(), x.stride(), y.raw(), y.stride());
+    return true;
+}
+
+// c = a + b and c = a - b, c may alias a or b
+template <class T>
+bool add(const DynMatrix<T>& a, const DynMatrix<T>& b, DynMatrix<T>& c)
+{
+    if (a.rows() != b.rows() || a.cols() != b.cols() ||
+        c.rows() != a.rows() || c.cols() != a.cols()) {
+        return false;
+    }
+    kernel::elementwise<T>(a.rows(), a.cols(), a.raw(), a.stride(), b.raw(), b.stride(),
+                           c.raw(), c.stride(), [](T x, T y) { return x + y; });
+    return true;
+}
+
+template <class T>
+bool subtract(const DynMatrix<T>& a, const DynMatrix<T>& b, DynMatrix<T>& c)
+{
+    if (a.rows() != b.rows() || a.cols() != b.cols() ||
+        c.rows() != a.rows() || c.cols() != a.cols()) {
+        return false;
+    }
+    kernel::elementwise<T>(a.rows(), a.cols(), a.raw(), a.stride(), b.raw(), b.stride(),
+                           c.raw(), c.stride(), [](T x, T y) { return x - y; });
+    return true;
+}
+
+template <class T>
+bool add(const DynVector<T>& a, const DynVector<T>& b, DynVector<T>& c)
+{
+    if (a.size() != b.size() || c.size() != a.size()) {
+        return false;
+    }
+    kernel::elementwise<T>(a.size(), 1, a.raw(), a.stride(), b.raw(), b.stride(),
+                           c.raw(), c.stride(), [](T x, T y) { return x + y; });
+    return true;
+}
+
+template <class T>
+bool subtract(const DynVector<T>& a, const DynVector<T>& b, DynVector<T>& c)
+{
+    if (a.size() != b.size() || c.size() != a.size()) {
+        return false;
+    }
+    kernel::elementwise<T>(a.size(), 1, a.raw(), a.stride(), b.raw(), b.stride(),
+                           c.raw(), c.stride(), [](T x, T y) { return x - y; });
+    return true;
+}
+
+template <class T>
+bool copy(const DynMatrix<T>& from, DynMatrix<T>& to)
+{
+    if (from.rows() != to.rows() || from.cols() != to.cols()) {
+        return false;
+    }
+    for (uint16_t row = 0; row < from.rows(); ++row) {
+        for (uint16_t col = 0; col < from.cols(); ++col) {
+            to(row, col) = from(row, col);
+        }
+    }
+    return true;
+}
+
+template <class T>
+bool copy(const DynVector<T>& from, DynVector<T>& to)
+{
+    if (from.size() != to.size()) {
+        return false;
+    }
+    for (uint16_t i = 0; i < from.size(); ++i) {
+        to[i] = from[i];
+    }
+    return true;
+}
+
+// Same factorisation as Matrix::luDecompose, without pivoting
+template <class T>
+bool luDecompose(const DynMatrix<T>& a, DynMatrix<T>& L, DynMatrix<T>& U)
+{
+    const uint16_t n = a.rows();
+    if (a.cols() != n || L.rows() != n || L.cols() != n || U.rows() != n || U.cols() != n) {
+        return false;
+    }
+    L.fill(0);
+    U.fill(0);
+    for (uint16_t i = 0; i < n; ++i) {
+        L(i, i) = 1;
+    }
+
+    for (uint16_t j = 0; j < n; ++j) {
+        for (uint16_t i = 0; i <= j; ++i) {
+            T sum = a(i, j);
+            for (uint16_t k = 0; k < i; ++k) {
+                sum -= L(i, k) * U(k, j);
+            }
+            U(i, j) = sum;
+        }
+        for (uint16_t i = j + 1; i < n; ++i) {
+            T sum = a(i, j);
+            for (uint16_t k = 0; k < j; ++k) {
+                sum -= L(i, k) * U(k, j);
+            }
+            L(i, j) = sum / U(j, j);
+        }
+    }
+    return true;
+}
+
+template <class T>
+bool luInverse(const DynMatrix<T>& L, const DynMatrix<T>& U, DynMatrix<T>& inv)
+{
+    const uint16_t n = L.rows();
+    if (inv.rows() != n || inv.cols() != n) {
+        return false;
+    }
+    for (uint16_t col = 0; col < n; ++col) {
+        for (uint16_t i = 0; i < n; ++i) {
+            T sum = (i == col) ? 1 : 0;
+            for (uint16_t k = 0; k < i; ++k) {
+                sum -= L(i, k) * inv(k, col);
+            }
+            inv(i, col) = sum;
+        }
+        for (uint16_t i = n; i-- > 0;) {
+            T sum = inv(i, col);
+            for (uint16_t k = i + 1; k < n; ++k) {
+                sum -= U(i, k) * inv(k, col);
+            }
+            inv(i, col) = sum / U(i, i);
+        }
+    }
+    return true;
+}
+
+}  // namespace mart
+
+#endif /* DYNMATRIX_H */
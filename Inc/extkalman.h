@@ -3,6 +3,7 @@
 
 #include "matrix.h"
 #include "vector.h"
+#include <cmath>
 #include <functional>
 
 namespace mart
@@ -34,11 +35,33 @@ Sigma_t = (I - K_t*H_t) * Sigma_prio_t
 For our purposes we'll ignore the control
 */
 
+/*
+Scratch matrices used by a single update step. Nothing in here survives
+between steps, so filters that are stepped one after another (e.g. the models
+of an InteractingMultipleModel) can share one workspace instead of each
+carrying its own copy. F is left intact by correct() so that smoothers can
+pick up the Jacobian of the last prediction.
+*/
+template<class T, uint16_t stateSize, uint16_t measurementSize>
+struct ExtendedKalmanWorkspace
+{
+    alloc::Matrix<T, stateSize, stateSize> F;
+    alloc::Matrix<T, measurementSize, stateSize> H;
+    alloc::Matrix<T, stateSize, measurementSize> K;
+    alloc::Matrix<T, measurementSize, measurementSize> S;
+    alloc::Matrix<T, measurementSize, measurementSize> L;
+    alloc::Matrix<T, measurementSize, measurementSize> U;
+    alloc::Matrix<T, measurementSize, measurementSize> SInv;
+    alloc::Vector<T, measurementSize> zPredicted;
+};
+
 template<class T, uint16_t stateSize, uint16_t measurementSize>
 class ExtendedKalmanFilter
 {
 public:
     using ValueType = T;
+    static constexpr uint16_t StateSize = stateSize;
+    static constexpr uint16_t MeasurementSize = measurementSize;
 
     using State = Vector<ValueType, stateSize>;
     using ProcessFunction =
@@ -46,12 +69,18 @@ public:
     using ProcessMatrix = Matrix<ValueType, stateSize, stateSize>;
     using GetProcessJacobianFunction =
         std::function<void(const State&, ProcessMatrix&, ValueType)>;
+    using GetConstantJacobianFunction =
+        std::function<void(ProcessMatrix&, ValueType)>;
 
     using Measurement = Vector<ValueType, measurementSize>;
-    using MeasurementFunction = std::function<Measurement(const State&, ValueType)>;
+    using MeasurementFunction =
+        std::function<void(const State&, Measurement&, ValueType)>;
     using MeasurementMatrix = Matrix<ValueType, measurementSize, stateSize>;
     using GetMeasurementJacobianFunction =
         std::function<void(const State&, MeasurementMatrix&, ValueType)>;
+    using InnovationMatrix = Matrix<ValueType, measurementSize, measurementSize>;
+
+    using Workspace = ExtendedKalmanWorkspace<ValueType, stateSize, measurementSize>;
 
     ExtendedKalmanFilter(
         ProcessFunction f,
@@ -59,7 +88,7 @@ public:
         ProcessMatrix processCovariance,
         MeasurementFunction h,
         GetMeasurementJacobianFunction getMeasurementJacobian,
-        MeasurementMatrix measurementCovariance
+        InnovationMatrix measurementCovariance
         ) :
         f_(std::move(f)),
         getProcessJacobian_(std::move(getProcessJacobian)),
@@ -70,50 +99,128 @@ public:
         I_(ProcessMatrix::eye())
     {}
 
+    // For models whose Jacobian is partly a function of dt only: those
+    // blocks are written by getConstantJacobian, only when dt changes, and
+    // getProcessJacobian refreshes the state-dependent blocks every step.
+    // The filter keeps its own copy of the dt-only blocks, so filters that
+    // share a workspace do not evict each other's.
+    ExtendedKalmanFilter(
+        ProcessFunction f,
+        GetConstantJacobianFunction getConstantJacobian,
+        GetProcessJacobianFunction getProcessJacobian,
+        ProcessMatrix processCovariance,
+        MeasurementFunction h,
+        GetMeasurementJacobianFunction getMeasurementJacobian,
+        InnovationMatrix measurementCovariance
+        ) :
+        ExtendedKalmanFilter(std::move(f),
+                             std::move(getProcessJacobian),
+                             processCovariance,
+                             std::move(h),
+                             std::move(getMeasurementJacobian),
+                             measurementCovariance)
+    {
+        getConstantJacobian_ = std::move(getConstantJacobian);
+    }
 
     const State& state() const { return muPost_; }
+    const ProcessMatrix& covariance() const { return SigmaPost_; }
+
+    const State& priorState() const { return muPrio_; }
+    const ProcessMatrix& priorCovariance() const { return SigmaPrio_; }
+
+    const Measurement& innovation() const { return innovation_; }
+
+    // Jacobian of the last prediction, it lives in the workspace
+    const ProcessMatrix& processJacobian(const Workspace& ws) const { return ws.F; }
 
-    void update(const Measurement& z, ValueType dt)
+    // log N(z; h(mu_prio), S) of the last correction, S = H*Sigma_prio*H^T + Q
+    ValueType logLikelihood() const { return logLikelihood_; }
+
+    void reset(const State& mu, const ProcessMatrix& Sigma)
     {
-        getProcessJacobian(muPost_, F_, dt);
-        F_.transpose(FT_);
+        muPost_ = mu;
+        SigmaPost_ = Sigma;
+    }
 
-        // prediction
-        f_(muPrio_, muPost_, dt);
-        SigmaPrio_ = F_ * SigmaPost_ * FT_ + R_;
+    void update(const Measurement& z, ValueType dt, Workspace& ws)
+    {
+        predict(dt, ws);
+        correct(z, dt, ws);
+    }
 
-        getMeasurementJacobian(muPrio_, H_, dt);
-        H_.transpose(HT_);
+    void predict(ValueType dt, Workspace& ws)
+    {
+        if (getConstantJacobian_) {
+            if (!constantJacobianValid_ || constantJacobianDt_ != dt) {
+                getConstantJacobian_(constantJacobian_, dt);
+                constantJacobianDt_ = dt;
+                constantJacobianValid_ = true;
+            }
+            ws.F = constantJacobian_;
+        }
+        getProcessJacobian_(muPost_, ws.F, dt);
 
-        // correction
-        K_ = SigmaPrio_ * (H_ * SigmaPrio_ * HT_ + Q_).inverse();
-        muPost_ = muPrio_ + K_ * (z - h_(muPrio_));
-        SigmaPost_ = (I_ - K_ * H_) * SigmaPrio_;
+        f_(muPrio_, muPost_, dt);
+        SigmaPrio_ = ws.F * SigmaPost_ * transposed(ws.F) + R_;
+    }
+
+    void correct(const Measurement& z, ValueType dt, Workspace& ws)
+    {
+        getMeasurementJacobian_(muPrio_, ws.H, dt);
+
+        // The LU factors of S give both its inverse and its determinant
+        ws.S = ws.H * SigmaPrio_ * transposed(ws.H) + Q_;
+        ws.S.luDecompose(ws.L, ws.U);
+        InnovationMatrix::luInverse(ws.L, ws.U, ws.SInv);
+
+        h_(muPrio_, ws.zPredicted, dt);
+        innovation_ = z - ws.zPredicted;
+
+        ws.K = SigmaPrio_ * transposed(ws.H) * ws.SInv;
+        muPost_ = muPrio_ + ws.K * innovation_;
+        SigmaPost_ = (I_ - ws.K * ws.H) * SigmaPrio_;
+
+        ValueType logDet = 0;
+        for (uint16_t i = 0; i < measurementSize; ++i) {
+            logDet += std::log(std::abs(ws.U(i, i)));
+        }
+        const auto SInvInnovation = ws.SInv * innovation_;
+        ValueType mahalanobis = 0;
+        for (uint16_t i = 0; i < measurementSize; ++i) {
+            mahalanobis += innovation_[i] * SInvInnovation[i];
+        }
+        constexpr ValueType LOG_2PI = 1.8378770664093453;
+        logLikelihood_ = ValueType(-0.5) *
+            (measurementSize * LOG_2PI + logDet + mahalanobis);
     }
 
 private:
-    using AllocKalmanMatrix = alloc::Matrix<ValueType, stateSize, measurementSize>;
-    using AllocState        = typename State::Alloc;
+    using AllocState             = typename State::Alloc;
     using AllocProcessMatrix     = typename ProcessMatrix::Alloc;
-    using AllocMeasurementMatrix = typename MeasurementMatrix::Alloc;
+    using AllocMeasurement       = typename Measurement::Alloc;
+    using AllocInnovationMatrix  = typename InnovationMatrix::Alloc;
 
     const ProcessFunction f_;
+    GetConstantJacobianFunction getConstantJacobian_;
     const GetProcessJacobianFunction getProcessJacobian_;
-    AllocProcessMatrix F_;
-    AllocProcessMatrix FT_;
     const AllocProcessMatrix R_;
     const MeasurementFunction h_;
     const GetMeasurementJacobianFunction getMeasurementJacobian_;
-    AllocMeasurementMatrix H_;
-    AllocMeasurementMatrix HT_;
-    const AllocMeasurementMatrix Q_;
+    const AllocInnovationMatrix Q_;
     const AllocProcessMatrix I_;
-    AllocKalmanMatrix K_;
 
     AllocState muPost_;
     AllocState muPrio_;
     AllocProcessMatrix SigmaPost_;
     AllocProcessMatrix SigmaPrio_;
+    AllocMeasurement innovation_;
+    ValueType logLikelihood_{0};
+
+    // dt-only blocks of F, the others are left zero
+    AllocProcessMatrix constantJacobian_;
+    ValueType constantJacobianDt_{0};
+    bool constantJacobianValid_{false};
 };
 
 }
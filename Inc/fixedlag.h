@@ -0,0 +1,131 @@
+#ifndef FIXEDLAG_H
+#define FIXEDLAG_H
+
+#include "smoother.h"
+
+namespace mart
+{
+
+/*
+Fixed-lag smoother trades a latency of lag steps for the benefit of the
+measurements that arrived after the estimated step. It wraps a
+KalmanFilter or an ExtendedKalmanFilter and keeps the last lag + 1 steps in
+a preallocated ring buffer.
+
+When step t arrives, the RTS gain G_{t-1} is computed once and kept with
+step t-1. The smoothed mean at t - lag is then a backward sweep over the
+window using only the stored gains:
+mu_s_t = mu_t
+mu_s_k = mu_k + G_k * (mu_s_{k+1} - mu_prio_{k+1}), k = t-1 ... t-lag
+which costs O(lag * n^2) per step. The smoothed covariance needs the
+matrix products of the full recursion and is computed only on request.
+
+Before the window fills up, state() is the smoothed estimate of the very
+first step.
+*/
+template <class Filter, uint16_t lag>
+class FixedLagSmoother
+{
+public:
+    using ValueType     = typename Filter::ValueType;
+    using State         = typename Filter::State;
+    using ProcessMatrix = typename Filter::ProcessMatrix;
+    using Measurement   = typename Filter::Measurement;
+    using Workspace     = typename Filter::Workspace;
+
+    static constexpr uint16_t Lag = lag;
+
+    explicit FixedLagSmoother(const Filter& filter) : filter_(filter) {}
+
+    const Filter& filter() const { return filter_; }
+
+    // The arguments besides the measurement are passed on to the filter
+    // update, e.g. dt for ExtendedKalmanFilter
+    template <class... Args>
+    void update(const Measurement& z, Args... args)
+    {
+        filter_.update(z, args..., ws_);
+        push();
+    }
+
+    // True once state() refers to t - lag
+    bool ready() const { return count_ == capacity; }
+
+    const State& state() const { return muSmooth_; }
+
+    // O(lag * n^3), Sigma_s of the step returned by state()
+    void covariance(ProcessMatrix& SigmaSmooth)
+    {
+        unpackSymmetric(entry(0).SigmaPost, SigmaSmooth);
+        for (uint16_t age = 1; age < count_; ++age) {
+            const Entry& e = entry(age);
+            unpackSymmetric(e.SigmaPost, Sigma_);
+            unpackSymmetric(entry(age - 1).SigmaPrio, SigmaPrio_);
+            rtsCovariance(Sigma_, e.G, SigmaSmooth, SigmaPrio_, SigmaSmooth);
+        }
+    }
+
+private:
+    static constexpr uint16_t capacity = lag + 1;
+    using AllocState         = typename State::Alloc;
+    using AllocProcessMatrix = typename ProcessMatrix::Alloc;
+
+    struct Entry {
+        AllocState muPost;
+        AllocState muPrio;
+        ValueType SigmaPost[packedSize<State::Size>()];
+        ValueType SigmaPrio[packedSize<State::Size>()];
+        // Gain towards the next (newer) step, valid for all but the newest
+        AllocProcessMatrix G;
+    };
+
+    // age 0 is the newest step
+    Entry& entry(uint16_t age)
+    {
+        return entries_[(newest_ + capacity - age) % capacity];
+    }
+
+    void push()
+    {
+        const uint16_t previous = newest_;
+        newest_ = (newest_ + 1) % capacity;
+        if (count_ < capacity) {
+            ++count_;
+        }
+
+        Entry& e = entries_[newest_];
+        e.muPost = filter_.state();
+        e.muPrio = filter_.priorState();
+        packSymmetric(filter_.covariance(), e.SigmaPost);
+        packSymmetric(filter_.priorCovariance(), e.SigmaPrio);
+
+        if (count_ > 1) {
+            Entry& prev = entries_[previous];
+            unpackSymmetric(prev.SigmaPost, Sigma_);
+            unpackSymmetric(e.SigmaPrio, SigmaPrio_);
+            rtsGain(Sigma_, filter_.processJacobian(ws_), SigmaPrio_, prev.G);
+        }
+
+        muSmooth_ = e.muPost;
+        for (uint16_t age = 1; age < count_; ++age) {
+            const Entry& older = entry(age);
+            rtsMean(older.muPost, older.G, muSmooth_, entry(age - 1).muPrio,
+                    muSmooth_);
+        }
+    }
+
+    Filter filter_;
+    Workspace ws_;
+
+    Entry entries_[capacity];
+    uint16_t newest_{capacity - 1};
+    uint16_t count_{0};
+
+    AllocState muSmooth_;
+    AllocProcessMatrix Sigma_;
+    AllocProcessMatrix SigmaPrio_;
+};
+
+}  // namespace mart
+
+#endif /* FIXEDLAG_H */
@@ -0,0 +1,138 @@
+#ifndef GEMM_H
+#define GEMM_H
+
+#include "dynmatrix.h"
+#include "kernels.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace mart
+{
+namespace kernel
+{
+
+/*
+Cache-blocked matrix product for the large host models. C is cut into
+BLOCK_M x BLOCK_N tiles which are the tasks handed to the thread pool. A
+tile walks the inner dimension in steps of BLOCK_K: the BLOCK_M x BLOCK_K
+slice of A (with the scale folded in) and the BLOCK_K x BLOCK_N slice of B
+are copied into contiguous per-thread buffers first. The copies undo any
+stride or transposition of the operands, fit in L2, and let the innermost
+loop run over unit-stride rows of B and C that the compiler vectorises.
+*/
+
+constexpr uint32_t GEMM_BLOCK_M = 64;
+constexpr uint32_t GEMM_BLOCK_N = 128;
+constexpr uint32_t GEMM_BLOCK_K = 128;
+
+// Below this the plain loops win, packing costs more than it saves
+constexpr uint32_t GEMM_THRESHOLD = 48;
+
+template <class T>
+void gemmTile(uint32_t rowBegin, uint32_t rowEnd,
+              uint32_t colBegin, uint32_t colEnd,
+              uint32_t inner,
+              const Operand<T>& a, const Operand<T>& b,
+              T* c, uint32_t strideC)
+{
+    thread_local std::vector<T> packedA;
+    thread_local std::vector<T> packedB;
+    packedA.resize(GEMM_BLOCK_M * GEMM_BLOCK_K);
+    packedB.resize(GEMM_BLOCK_K * GEMM_BLOCK_N);
+
+    const uint32_t rows = rowEnd - rowBegin;
+    const uint32_t cols = colEnd - colBegin;
+    const T scale = a.scale * b.scale;
+
+    for (uint32_t row = rowBegin; row < rowEnd; ++row) {
+        std::fill(c + row * strideC + colBegin, c + row * strideC + colEnd, T(0));
+    }
+
+    for (uint32_t kBegin = 0; kBegin < inner; kBegin += GEMM_BLOCK_K) {
+        const uint32_t depth = std::min(GEMM_BLOCK_K, inner - kBegin);
+
+        T* pa = packedA.data();
+        for (uint32_t i = 0; i < rows; ++i) {
+            const T* aRow = a.d + (rowBegin + i) * a.rowStride;
+            for (uint32_t k = 0; k < depth; ++k) {
+                pa[i * depth + k] = aRow[(kBegin + k) * a.colStride] * scale;
+            }
+        }
+
+        T* pb = packedB.data();
+        for (uint32_t k = 0; k < depth; ++k) {
+            const T* bRow = b.d + (kBegin + k) * b.rowStride;
+            for (uint32_t j = 0; j < cols; ++j) {
+                pb[k * cols + j] = bRow[(colBegin + j) * b.colStride];
+            }
+        }
+
+        for (uint32_t i = 0; i < rows; ++i) {
+            T* cRow = c + (rowBegin + i) * strideC + colBegin;
+            const T* aRow = pa + i * depth;
+            for (uint32_t k = 0; k < depth; ++k) {
+                const T aik = aRow[k];
+                const T* bRow = pb + k * cols;
+                for (uint32_t j = 0; j < cols; ++j) {
+                    cRow[j] += aik * bRow[j];
+                }
+            }
+        }
+    }
+}
+
+// c = a * b with a nrows x inner and b inner x ncols, the tiles are spread
+// over pool when one is given
+template <class T>
+void gemm(uint32_t nrows, uint32_t inner, uint32_t ncols,
+          const Operand<T>& a, const Operand<T>& b,
+          T* c, uint32_t strideC, ThreadPool* pool = nullptr)
+{
+    const uint32_t tileRows = (nrows + GEMM_BLOCK_M - 1) / GEMM_BLOCK_M;
+    const uint32_t tileCols = (ncols + GEMM_BLOCK_N - 1) / GEMM_BLOCK_N;
+
+    // Consecutive tasks share a row of A, which the stealing pool keeps
+    // together on one thread
+    auto tile = [&](uint32_t t) {
+        const uint32_t rowBegin = (t / tileCols) * GEMM_BLOCK_M;
+        const uint32_t colBegin = (t % tileCols) * GEMM_BLOCK_N;
+        gemmTile(rowBegin, std::min(rowBegin + GEMM_BLOCK_M, nrows),
+                 colBegin, std::min(colBegin + GEMM_BLOCK_N, ncols),
+                 inner, a, b, c, strideC);
+    };
+
+    if (pool != nullptr) {
+        pool->parallelFor(tileRows * tileCols, tile);
+    } else {
+        for (uint32_t t = 0; t < tileRows * tileCols; ++t) {
+            tile(t);
+        }
+    }
+}
+
+}  // namespace kernel
+
+// c = a * b for DynMatrix operands (or transposed ones), the blocked
+// kernel takes over above GEMM_THRESHOLD
+template <class T, class A, class B>
+bool multiply(const A& a, const B& b, DynMatrix<T>& c, ThreadPool& pool)
+{
+    const DynOperand<T> x = dynOperand(a);
+    const DynOperand<T> y = dynOperand(b);
+    if (x.cols != y.rows || c.rows() != x.rows || c.cols() != y.cols) {
+        return false;
+    }
+    const uint32_t largest = std::max({x.rows, x.cols, y.cols});
+    if (largest < kernel::GEMM_THRESHOLD) {
+        kernel::multiply<T>(x.rows, x.cols, y.cols, x.op, y.op, c.raw(), c.stride());
+    } else {
+        kernel::gemm<T>(x.rows, x.cols, y.cols, x.op, y.op, c.raw(), c.stride(), &pool);
+    }
+    return true;
+}
+
+}  // namespace mart
+
+#endif /* GEMM_H */
@@ -0,0 +1,199 @@
+#ifndef IMM_H
+#define IMM_H
+
+#include "extkalman.h"
+#include "matrix.h"
+#include "vector.h"
+#include <array>
+#include <cmath>
+
+namespace mart
+{
+
+/*
+Interacting Multiple Model estimator runs a bank of filters which share the
+same state layout but describe different motion regimes (e.g. static,
+handheld, vehicle), and blends them by model probabilities mu.
+
+Pi(i, j) is the probability to switch from model i to model j between two
+steps. Every step consists of:
+1) Mixing
+c_j = sum_i Pi(i, j) * mu_i
+mu_{i|j} = Pi(i, j) * mu_i / c_j
+x0_j = sum_i mu_{i|j} * x_i
+P0_j = sum_i mu_{i|j} * (P_i + (x_i - x0_j) * (x_i - x0_j)^T)
+
+2) Model matched filtering
+Every filter j is restarted from (x0_j, P0_j) and updated with z. Its
+likelihood Lambda_j = N(z; h(x_prio_j), S_j) comes from the LU factors of
+the innovation covariance computed during the correction.
+
+3) Model probability update
+mu_j = Lambda_j * c_j / sum_k Lambda_k * c_k
+
+4) Combination
+x = sum_j mu_j * x_j
+P = sum_j mu_j * (P_j + (x_j - x) * (x_j - x)^T)
+
+How the filters are stepped is up to the Execution policy. The default one
+steps them one after another through a single shared workspace, so the
+scratch memory does not grow with the number of models.
+*/
+
+template <class Workspace, uint16_t numTasks>
+class SequentialExecution
+{
+public:
+    template <class Fn>
+    void forEach(Fn&& fn)
+    {
+        for (uint16_t i = 0; i < numTasks; ++i) {
+            fn(i, workspace_);
+        }
+    }
+
+private:
+    Workspace workspace_;
+};
+
+template <class Filter,
+          uint16_t numModels,
+          class Execution = SequentialExecution<typename Filter::Workspace, numModels>>
+class InteractingMultipleModel
+{
+public:
+    using ValueType     = typename Filter::ValueType;
+    using State         = typename Filter::State;
+    using ProcessMatrix = typename Filter::ProcessMatrix;
+    using Measurement   = typename Filter::Measurement;
+    using ModelVector   = Vector<ValueType, numModels>;
+    using ModelMatrix   = Matrix<ValueType, numModels, numModels>;
+
+    InteractingMultipleModel(const std::array<Filter, numModels>& filters,
+                             const ModelMatrix& transitions,
+                             const ModelVector& probabilities)
+        : filters_(filters), Pi_(transitions), mu_(probabilities)
+    {
+        combine();
+    }
+
+    const State& state() const { return x_; }
+    const ProcessMatrix& covariance() const { return P_; }
+    const ModelVector& probabilities() const { return mu_; }
+
+    const Filter& filter(uint16_t model) const { return filters_[model]; }
+
+    void update(const Measurement& z, ValueType dt)
+    {
+        mix();
+
+        execution_.forEach([&](uint16_t j, typename Filter::Workspace& ws) {
+            filters_[j].reset(x0_[j], P0_[j]);
+            filters_[j].update(z, dt, ws);
+        });
+
+        updateProbabilities();
+        combine();
+    }
+
+private:
+    using AllocState         = typename State::Alloc;
+    using AllocProcessMatrix = typename ProcessMatrix::Alloc;
+    static constexpr uint16_t stateSize = State::Size;
+
+    void mix()
+    {
+        for (uint16_t j = 0; j < numModels; ++j) {
+            c_[j] = 0;
+            for (uint16_t i = 0; i < numModels; ++i) {
+                c_[j] += Pi_(i, j) * mu_[i];
+            }
+        }
+
+        for (uint16_t j = 0; j < numModels; ++j) {
+            ValueType weights[numModels];
+            for (uint16_t i = 0; i < numModels; ++i) {
+                weights[i] = c_[j] > 0 ? Pi_(i, j) * mu_[i] / c_[j] : 0;
+            }
+            blend(weights, x0_[j], P0_[j]);
+        }
+    }
+
+    void updateProbabilities()
+    {
+        // Likelihoods are combined in the log domain, relative to the
+        // largest one, so that far-off models do not underflow all at once
+        ValueType maxLog = filters_[0].logLikelihood();
+        for (uint16_t j = 1; j < numModels; ++j) {
+            maxLog = std::max(maxLog, filters_[j].logLikelihood());
+        }
+
+        ValueType total = 0;
+        for (uint16_t j = 0; j < numModels; ++j) {
+            mu_[j] = c_[j] * std::exp(filters_[j].logLikelihood() - maxLog);
+            total += mu_[j];
+        }
+        for (uint16_t j = 0; j < numModels; ++j) {
+            mu_[j] /= total;
+        }
+    }
+
+    void combine()
+    {
+        ValueType weights[numModels];
+        for (uint16_t j = 0; j < numModels; ++j) {
+            weights[j] = mu_[j];
+        }
+        blend(weights, x_, P_);
+    }
+
+    // Gaussian mixture of the filter posteriors collapsed to a single
+    // mean and covariance
+    void blend(const ValueType (&weights)[numModels],
+               State& x,
+               ProcessMatrix& P) const
+    {
+        for (uint16_t r = 0; r < stateSize; ++r) {
+            x[r] = 0;
+            for (uint16_t i = 0; i < numModels; ++i) {
+                x[r] += weights[i] * filters_[i].state()[r];
+            }
+        }
+
+        for (uint16_t r = 0; r < stateSize; ++r) {
+            for (uint16_t c = 0; c < stateSize; ++c) {
+                P(r, c) = 0;
+            }
+        }
+        for (uint16_t i = 0; i < numModels; ++i) {
+            if (weights[i] == 0) {
+                continue;
+            }
+            const State& xi      = filters_[i].state();
+            const ProcessMatrix& Pi = filters_[i].covariance();
+            for (uint16_t r = 0; r < stateSize; ++r) {
+                const ValueType dr = xi[r] - x[r];
+                for (uint16_t c = 0; c < stateSize; ++c) {
+                    P(r, c) += weights[i] * (Pi(r, c) + dr * (xi[c] - x[c]));
+                }
+            }
+        }
+    }
+
+    std::array<Filter, numModels> filters_;
+    const typename ModelMatrix::Alloc Pi_;
+    typename ModelVector::Alloc mu_;
+    typename ModelVector::Alloc c_;
+
+    AllocState x0_[numModels];
+    AllocProcessMatrix P0_[numModels];
+
+    AllocState x_;
+    AllocProcessMatrix P_;
+
+    Execution execution_;
+};
+
+}  // namespace mart
+
+#endif /* IMM_H */
@@ -31,46 +31,103 @@ Sigma_t = (I - K_t*C_t) * Sigma_prio_t
 For our purposes we'll ignore the control
  */
 
+// Scratch matrices of a single update step, see ExtendedKalmanWorkspace
+template <class T, uint16_t stateSize, uint16_t measurementSize>
+struct KalmanWorkspace
+{
+    alloc::Matrix<T, stateSize, measurementSize> K;
+    alloc::Matrix<T, measurementSize, measurementSize> S;
+    alloc::Matrix<T, measurementSize, measurementSize> L;
+    alloc::Matrix<T, measurementSize, measurementSize> U;
+    alloc::Matrix<T, measurementSize, measurementSize> SInv;
+};
+
 template <class T, uint16_t stateSize, uint16_t measurementSize>
 class KalmanFilter
 {
 public:
     using ValueType = T;
+    static constexpr uint16_t StateSize = stateSize;
+    static constexpr uint16_t MeasurementSize = measurementSize;
+
     using State = Vector<ValueType, stateSize>;
     using Measurement = Vector<ValueType, measurementSize>;
     using ProcessMatrix = Matrix<ValueType, stateSize, stateSize>;
-    using MeasurementMatrix = Matrix<ValueType, measurementSize, measurementSize>;
+    using MeasurementMatrix = Matrix<ValueType, measurementSize, stateSize>;
+    using InnovationMatrix = Matrix<ValueType, measurementSize, measurementSize>;
+
+    using Workspace = KalmanWorkspace<ValueType, stateSize, measurementSize>;
+
+    KalmanFilter(ProcessMatrix A,
+                 ProcessMatrix processCovariance,
+                 MeasurementMatrix C,
+                 InnovationMatrix measurementCovariance)
+        : A_(A),
+          R_(processCovariance),
+          C_(C),
+          Q_(measurementCovariance),
+          I_(ProcessMatrix::eye())
+    {
+    }
 
     const State& state() const { return muPost_; }
+    const ProcessMatrix& covariance() const { return SigmaPost_; }
+
+    const State& priorState() const { return muPrio_; }
+    const ProcessMatrix& priorCovariance() const { return SigmaPrio_; }
+
+    const Measurement& innovation() const { return innovation_; }
 
-    void update(const Measurement& z)
+    const ProcessMatrix& processJacobian(const Workspace&) const { return A_; }
+
+    void reset(const State& mu, const ProcessMatrix& Sigma)
+    {
+        muPost_ = mu;
+        SigmaPost_ = Sigma;
+    }
+
+    void update(const Measurement& z, Workspace& ws)
+    {
+        predict(ws);
+        correct(z, ws);
+    }
+
+    void predict(Workspace&)
     {
-        // prediction
         muPrio_ = A_ * muPost_;
-        SigmaPrio_ = A_ * SigmaPost_ * AT_ + R_;
+        SigmaPrio_ = A_ * SigmaPost_ * transposed(A_) + R_;
+    }
 
-        // correction
-        K_ = SigmaPrio_ * (C_ * SigmaPrio_ * CT_ + Q_).inverse();
-        muPost_ = muPrio_ + K_ * (z - C_ * muPrio_);
-        SigmaPost_ = (I_ - K_ * C_) * SigmaPrio_;
+    void correct(const Measurement& z, Workspace& ws)
+    {
+        ws.S = C_ * SigmaPrio_ * transposed(C_) + Q_;
+        ws.S.luDecompose(ws.L, ws.U);
+        InnovationMatrix::luInverse(ws.L, ws.U, ws.SInv);
+
+        ws.K = SigmaPrio_ * transposed(C_) * ws.SInv;
+        innovation_ = z - C_ * muPrio_;
+        muPost_ = muPrio_ + ws.K * innovation_;
+        SigmaPost_ = (I_ - ws.K * C_) * SigmaPrio_;
     }
 
 private:
-    using KalmanMatrix = Matrix<ValueType, stateSize, measurementSize>;
-
-    const ProcessMatrix A_;
-    const ProcessMatrix AT_;
-    const ProcessMatrix R_;
-    const MeasurementMatrix C_;
-    const MeasurementMatrix CT_;
-    const MeasurementMatrix Q_;
-    const ProcessMatrix I_;
-    KalmanMatrix K_;
-
-    State muPost_;
-    State muPrio_;
-    ProcessMatrix SigmaPost_;
-    ProcessMatrix SigmaPrio_;
+    using AllocState = typename State::Alloc;
+    using AllocProcessMatrix = typename ProcessMatrix::Alloc;
+    using AllocMeasurement = typename Measurement::Alloc;
+    using AllocMeasurementMatrix = typename MeasurementMatrix::Alloc;
+    using AllocInnovationMatrix = typename InnovationMatrix::Alloc;
+
+    const AllocProcessMatrix A_;
+    const AllocProcessMatrix R_;
+    const AllocMeasurementMatrix C_;
+    const AllocInnovationMatrix Q_;
+    const AllocProcessMatrix I_;
+
+    AllocState muPost_;
+    AllocState muPrio_;
+    AllocProcessMatrix SigmaPost_;
+    AllocProcessMatrix SigmaPrio_;
+    AllocMeasurement innovation_;
 };
 
 }  // namespace mart
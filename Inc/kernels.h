@@ -0,0 +1,277 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <cstdint>
+#include <utility>
+
+namespace mart
+{
+namespace kernel
+{
+
+/*
+Raw kernels behind the Matrix operators. Matrices are passed as a pointer to
+the first element and a row pitch (ncols + skipCols for a view), vectors as
+a pointer and the distance between their elements.
+
+The generic kernels are plain loops. For shapes up to 4x4 the dispatching
+kernels switch to fully unrolled versions: the loops run over compile-time
+index packs, row pointers are resolved once per row and the operands are
+loaded into locals before the arithmetic, which lets the compiler keep the
+whole computation in registers.
+*/
+
+constexpr uint16_t MAX_UNROLLED = 4;
+
+template <uint16_t... dims>
+constexpr bool unrolled()
+{
+    return ((dims <= MAX_UNROLLED) && ...);
+}
+
+template <class Fn, std::size_t... I>
+inline void unroll(Fn&& fn, std::index_sequence<I...>)
+{
+    (fn(std::integral_constant<uint16_t, I>{}), ...);
+}
+
+template <uint16_t count, class Fn>
+inline void unroll(Fn&& fn)
+{
+    unroll(fn, std::make_index_sequence<count>{});
+}
+
+// Left fold keeps the summation order of the generic loops
+template <class T, std::size_t... I>
+inline T dot(const T* x, const T* y, std::index_sequence<I...>)
+{
+    return (T(0) + ... + (x[I] * y[I]));
+}
+
+// A matrix read in place: element (row, col) is
+// scale * d[row * rowStride + col * colStride], so a transposed operand is
+// the same memory with the two strides swapped
+template <class T>
+struct Operand {
+    const T* d;
+    uint16_t rowStride;
+    uint16_t colStride;
+    T scale;
+};
+
+// c = a * b, the scales of the operands are applied once to every sum
+template <class T, uint16_t nrows, uint16_t ncols, uint16_t size>
+void multiplyGeneric(const Operand<T>& a, const Operand<T>& b,
+                     T* c, uint16_t strideC)
+{
+    const T scale = a.scale * b.scale;
+    for (uint16_t row = 0; row < nrows; ++row) {
+        for (uint16_t col = 0; col < size; ++col) {
+            T sum = 0;
+            for (uint16_t i = 0; i < ncols; ++i) {
+                sum += a.d[row * a.rowStride + i * a.colStride] *
+                       b.d[i * b.rowStride + col * b.colStride];
+            }
+            c[row * strideC + col] = sum * scale;
+        }
+    }
+}
+
+template <class T, uint16_t nrows, uint16_t ncols, uint16_t size>
+void multiplyGeneric(const T* a, uint16_t strideA,
+                     const T* b, uint16_t strideB,
+                     T* c, uint16_t strideC)
+{
+    for (uint16_t row = 0; row < nrows; ++row) {
+        for (uint16_t col = 0; col < size; ++col) {
+            T sum = 0;
+            for (uint16_t i = 0; i < ncols; ++i) {
+                sum += a[row * strideA + i] * b[i * strideB + col];
+            }
+            c[row * strideC + col] = sum;
+        }
+    }
+}
+
+template <class T, uint16_t nrows, uint16_t ncols, uint16_t size>
+void multiplyUnrolled(const Operand<T>& a, const Operand<T>& b,
+                      T* c, uint16_t strideC)
+{
+    // b is kept column-wise so every output is a dot of two local arrays
+    T bt[size][ncols];
+    unroll<ncols>([&](auto i) {
+        const T* bRow = b.d + i * b.rowStride;
+        unroll<size>([&](auto j) { bt[j][i] = bRow[j * b.colStride]; });
+    });
+
+    const T scale = a.scale * b.scale;
+    unroll<nrows>([&](auto row) {
+        const T* aRow = a.d + row * a.rowStride;
+        T ar[ncols];
+        unroll<ncols>([&](auto i) { ar[i] = aRow[i * a.colStride]; });
+
+        T* cRow = c + row * strideC;
+        unroll<size>([&](auto col) {
+            cRow[col] = dot(ar, bt[col], std::make_index_sequence<ncols>{}) * scale;
+        });
+    });
+}
+
+template <class T, uint16_t nrows, uint16_t ncols, uint16_t size>
+void multiplyUnrolled(const T* a, uint16_t strideA,
+                      const T* b, uint16_t strideB,
+                      T* c, uint16_t strideC)
+{
+    // b is kept column-wise so every output is a dot of two local arrays
+    T bt[size][ncols];
+    unroll<ncols>([&](auto i) {
+        const T* bRow = b + i * strideB;
+        unroll<size>([&](auto j) { bt[j][i] = bRow[j]; });
+    });
+
+    unroll<nrows>([&](auto row) {
+        const T* aRow = a + row * strideA;
+        T ar[ncols];
+        unroll<ncols>([&](auto i) { ar[i] = aRow[i]; });
+
+        T* cRow = c + row * strideC;
+        unroll<size>([&](auto col) {
+            cRow[col] = dot(ar, bt[col], std::make_index_sequence<ncols>{});
+        });
+    });
+}
+
+template <class T, uint16_t nrows, uint16_t ncols, uint16_t size>
+inline void multiply(const Operand<T>& a, const Operand<T>& b,
+                     T* c, uint16_t strideC)
+{
+    if constexpr (unrolled<nrows, ncols, size>()) {
+        multiplyUnrolled<T, nrows, ncols, size>(a, b, c, strideC);
+    } else {
+        multiplyGeneric<T, nrows, ncols, size>(a, b, c, strideC);
+    }
+}
+
+template <class T, uint16_t nrows, uint16_t ncols, uint16_t size>
+inline void multiply(const T* a, uint16_t strideA,
+                     const T* b, uint16_t strideB,
+                     T* c, uint16_t strideC)
+{
+    if constexpr (unrolled<nrows, ncols, size>()) {
+        multiplyUnrolled<T, nrows, ncols, size>(a, strideA, b, strideB, c, strideC);
+    } else {
+        multiplyGeneric<T, nrows, ncols, size>(a, strideA, b, strideB, c, strideC);
+    }
+}
+
+template <class T, uint16_t nrows, uint16_t ncols>
+void multiplyVectorGeneric(const T* a, uint16_t strideA,
+                           const T* x, uint16_t strideX, T* y)
+{
+    for (uint16_t row = 0; row < nrows; ++row) {
+        T sum = 0;
+        for (uint16_t col = 0; col < ncols; ++col) {
+            sum += a[row * strideA + col] * x[col * strideX];
+        }
+        y[row] = sum;
+    }
+}
+
+template <class T, uint16_t nrows, uint16_t ncols>
+void multiplyVectorUnrolled(const T* a, uint16_t strideA,
+                            const T* x, uint16_t strideX, T* y)
+{
+    T xr[ncols];
+    unroll<ncols>([&](auto i) { xr[i] = x[i * strideX]; });
+
+    unroll<nrows>([&](auto row) {
+        y[row] = dot(a + row * strideA, xr, std::make_index_sequence<ncols>{});
+    });
+}
+
+template <class T, uint16_t nrows, uint16_t ncols>
+inline void multiplyVector(const T* a, uint16_t strideA,
+                           const T* x, uint16_t strideX, T* y)
+{
+    if constexpr (unrolled<nrows, ncols>()) {
+        multiplyVectorUnrolled<T, nrows, ncols>(a, strideA, x, strideX, y);
+    } else {
+        multiplyVectorGeneric<T, nrows, ncols>(a, strideA, x, strideX, y);
+    }
+}
+
+// c = op(a, b) element by element
+template <class T, uint16_t nrows, uint16_t ncols, class Op>
+inline void elementwise(const T* a, uint16_t strideA,
+                        const T* b, uint16_t strideB,
+                        T* c, uint16_t strideC, Op op)
+{
+    if constexpr (unrolled<nrows, ncols>()) {
+        unroll<nrows>([&](auto row) {
+            const T* aRow = a + row * strideA;
+            const T* bRow = b + row * strideB;
+            T* cRow       = c + row * strideC;
+            unroll<ncols>([&](auto col) { cRow[col] = op(aRow[col], bRow[col]); });
+        });
+    } else {
+        for (uint16_t row = 0; row < nrows; ++row) {
+            for (uint16_t col = 0; col < ncols; ++col) {
+                c[row * strideC + col] =
+                    op(a[row * strideA + col], b[row * strideB + col]);
+            }
+        }
+    }
+}
+
+// Runtime-sized counterparts for DynMatrix, plain loops only
+
+template <class T>
+void multiply(uint16_t nrows, uint16_t ncols, uint16_t size,
+              const Operand<T>& a, const Operand<T>& b,
+              T* c, uint16_t strideC)
+{
+    const T scale = a.scale * b.scale;
+    for (uint16_t row = 0; row < nrows; ++row) {
+        for (uint16_t col = 0; col < size; ++col) {
+            T sum = 0;
+            for (uint16_t i = 0; i < ncols; ++i) {
+                sum += a.d[row * a.rowStride + i * a.colStride] *
+                       b.d[i * b.rowStride + col * b.colStride];
+            }
+            c[row * strideC + col] = sum * scale;
+        }
+    }
+}
+
+template <class T>
+void multiplyVector(uint16_t nrows, uint16_t ncols,
+                    const T* a, uint16_t strideA,
+                    const T* x, uint16_t strideX,
+                    T* y, uint16_t strideY)
+{
+    for (uint16_t row = 0; row < nrows; ++row) {
+        T sum = 0;
+        for (uint16_t col = 0; col < ncols; ++col) {
+            sum += a[row * strideA + col] * x[col * strideX];
+        }
+        y[row * strideY] = sum;
+    }
+}
+
+template <class T, class Op>
+void elementwise(uint16_t nrows, uint16_t ncols,
+                 const T* a, uint16_t strideA,
+                 const T* b, uint16_t strideB,
+                 T* c, uint16_t strideC, Op op)
+{
+    for (uint16_t row = 0; row < nrows; ++row) {
+        for (uint16_t col = 0; col < ncols; ++col) {
+            c[row * strideC + col] = op(a[row * strideA + col], b[row * strideB + col]);
+        }
+    }
+}
+
+}  // namespace kernel
+}  // namespace mart
+
+#endif /* KERNELS_H */
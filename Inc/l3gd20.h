@@ -1,6 +1,10 @@
 #ifndef L3GD20_H
 #define L3GD20_H
 
+#include "clock.h"
+#include "regshadow.h"
+#include "sensor.h"
+#include "transferguard.h"
 #include "types.h"
 #include "stm32f3xx_hal.h"
 
@@ -39,23 +43,149 @@ public:
         INT1_DURATION = 0x38
     };
 
+    // FM2..FM0 of FIFO_CTRL_REG
+    enum class FifoMode : uint8_t {
+        BYPASS           = 0x0,
+        FIFO             = 0x1,
+        STREAM           = 0x2,
+        STREAM_TO_FIFO   = 0x3,
+        BYPASS_TO_STREAM = 0x4
+    };
+
+    // Samples the hardware FIFO holds
+    static constexpr uint8_t FIFO_DEPTH = 32;
+    static constexpr uint8_t MAX_BURST = FIFO_DEPTH;
+
+    // Streaming setup applied by configure(), the ticks are those of clock
+    struct Config {
+        uint8_t ctrlReg1;         // data rate, bandwidth, power and axes
+        uint8_t samplesPerBurst;  // FIFO watermark and DMA burst length
+        GPIO_TypeDef* drdyPort;   // DRDY/INT2
+        uint16_t drdyPin;
+        Clock clock;
+        BusRecovery recoverBus{nullptr};
+        uint32_t timeoutTicks{0};  // of a burst, 0 waits forever
+        uint32_t retryTicks{0};    // after a failed burst
+    };
+
     L3GD20(GPIO_TypeDef* csPort, uint16_t csPin, SPI_HandleTypeDef& hspi);
 
+    // Sets the data rate, runs the FIFO in stream mode with a watermark
+    // interrupt and enables asynchronous acquisition. false on a bus error
+    // or when the control registers do not read back, i.e. the device does
+    // not answer.
+    bool configure(const Config& config);
+
+    /*
+    The configuration registers are shadowed in RAM: read() serves them
+    without a transaction once known, and write() drops writes of the value
+    the device already holds. Status and output registers always go to the
+    bus, and so do multiRead() bursts, which leave the shadow alone.
+
+    The blocking calls return false on a bus error, which read() reports as
+    0, and count it in busStats(). A failed write forgets the shadow, as
+    the device may hold anything now.
+    */
     uint8_t read(Register reg);
-    void write(Register reg, uint8_t value);
+    bool write(Register reg, uint8_t value);
+
+    bool multiRead(Register startReg, uint8_t* data, uint8_t count);
+    bool multiWrite(Register startReg, uint8_t* data, uint8_t count);
+
+    // Writes the registers from startReg on that differ from values in one
+    // burst, if there are any, false when the write failed
+    bool applyProfile(Register startReg, const uint8_t* values, uint8_t count);
+
+    // Makes the next access go to the bus, e.g. after a reboot of the device
+    void forgetConfiguration() { shadow_.forget(); }
+
+    bool read(Vector3& angularRates);
 
-    void multiRead(Register startReg, uint8_t* data, uint8_t count);
-    void multiWrite(Register startReg, uint8_t* data, uint8_t count);
+    /*
+    FIFO streaming. The gyroscope queues up to FIFO_DEPTH samples by itself,
+    so the CPU only has to wake up once per batch instead of once per sample.
+    watermark (0..31) sets the level at which the WTM flag goes up, and is
+    routed to DRDY/INT2 when interruptOnWatermark is set.
+    */
+    void enableFifo(FifoMode mode, uint8_t watermark, bool interruptOnWatermark = false);
+    void disableFifo();
 
-    void read(Vector3& angularRates);
+    // Number of unread samples in the FIFO
+    uint8_t fifoLevel();
+
+    // Drains up to maxCount samples, oldest first, in one SPI burst and
+    // returns how many were read, 0 on a bus error
+    uint8_t readFifo(Vector3* angularRates, uint8_t maxCount);
+
+    /*
+    Asynchronous acquisition. Once enabled, the DRDY/INT2 line (data-ready
+    or FIFO watermark) calls onDataReady() from its EXTI interrupt, which
+    stamps the burst with clock and starts a full-duplex DMA read of
+    samplesPerBurst samples into one half of a double buffer.
+    onTransferComplete(), called from HAL_SPI_TxRxCpltCallback, releases the
+    chip select and publishes that half while the next burst goes to the
+    other one. The samples of a burst are stamped evenly between the
+    previous burst and this one. The first burst after enabling has no
+    previous one, so it is read but only starts the time base, unless it is
+    a single sample stamped at its interrupt. The blocking calls above must
+    not be used while asynchronous acquisition is enabled. Failed bursts
+    are handled as described for TransferGuard.
+    */
+    void enableAsync(GPIO_TypeDef* drdyPort, uint16_t drdyPin, uint8_t samplesPerBurst,
+                     Clock clock);
+    // Waits for the burst in flight up to the timeout, then aborts it
+    void disableAsync();
+
+    // Interrupt context
+    void onDataReady();
+    bool onTransferComplete();
+    void onTransferError();
+
+    // Task context: abandons an overdue burst and restarts after a failure
+    void service();
+
+    const BusStats& busStats() const { return guard_.stats(); }
+
+    // Copies the last published burst, each sample with its clock stamp,
+    // 0 when nothing new arrived
+    uint8_t readBurst(RawSample* samples, uint8_t maxCount);
+
+    // Bursts that were overwritten before readBurst() got to them
+    uint32_t overruns() const { return overruns_; }
 
 private:
     void csLow();
     void csHigh();
+    bool drdyHigh() const;
+    bool checked(HAL_StatusTypeDef status);
 
     GPIO_TypeDef* const csPort_;
     const uint16_t csPin_;
     SPI_HandleTypeDef& hspi_;
+
+    // CTRL_REG1 .. INT1_DURATION
+    RegisterShadow<0x20, 0x19> shadow_;
+
+    // Address byte followed by FIFO_DEPTH samples
+    static constexpr uint16_t BURST_BYTES = 1 + FIFO_DEPTH * 6;
+
+    uint8_t txBuffer_[BURST_BYTES] = {};
+    uint8_t rxBuffers_[2][BURST_BYTES] = {};
+    GPIO_TypeDef* drdyPort_{nullptr};
+    uint16_t drdyPin_{0};
+    uint8_t burstSamples_{0};
+    Clock clock_{nullptr};
+    uint32_t burstTime_{0};
+    uint32_t lastBurstTime_{0};
+    bool lastBurstValid_{false};
+    uint32_t readyFrom_{0};
+    uint32_t readyTo_{0};
+    volatile uint8_t fillIndex_{0};
+    volatile uint8_t readyCount_{0};
+    volatile bool busy_{false};
+    volatile uint32_t overruns_{0};
+
+    TransferGuard guard_;
 };
 
 }  // namespace mart
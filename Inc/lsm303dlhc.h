@@ -1,6 +1,10 @@
 #ifndef LSM303DLHC_H
 #define LSM303DLHC_H
 
+#include "clock.h"
+#include "regshadow.h"
+#include "sensor.h"
+#include "transferguard.h"
 #include "types.h"
 #include "stm32f3xx_hal.h"
 
@@ -47,12 +51,13 @@ public:
         CRA_REG_M = 0x00,
         CRB_REG_M = 0x01,
         MR_REG_M = 0x02,
+        // The DLHC orders the axes X, Z, Y
         OUT_X_H_M = 0x03,
         OUT_X_L_M = 0x04,
-        OUT_Y_H_M = 0x05,
-        OUT_Y_L_M = 0x06,
-        OUT_Z_H_M = 0x07,
-        OUT_Z_L_M = 0x08,
+        OUT_Z_H_M = 0x05,
+        OUT_Z_L_M = 0x06,
+        OUT_Y_H_M = 0x07,
+        OUT_Y_L_M = 0x08,
         SR_REG_Mg = 0x09,
         IRA_REG_M = 0x0A,
         IRB_REG_M = 0x0B,
@@ -61,26 +66,180 @@ public:
         TEMP_OUT_L_M = 0x32
     };
 
+    // Streaming setup applied by configure(), the ticks are those of clock
+    struct Config {
+        uint8_t ctrlReg1A;        // accelerometer data rate, power and axes
+        uint8_t ctrlReg4A;        // accelerometer scale and resolution, BLE is cleared
+        uint8_t craRegM;          // magnetometer data rate
+        uint8_t samplesPerBurst;  // FIFO watermark and DMA burst length
+        GPIO_TypeDef* int1Port;
+        uint16_t int1Pin;
+        Clock clock;
+        BusRecovery recoverBus{nullptr};
+        uint32_t timeoutTicks{0};  // of both reads of a sample, 0 waits forever
+        uint32_t retryTicks{0};    // after a failed read
+    };
+
     explicit Lsm303dlhc(I2C_HandleTypeDef& hi2c);
 
+    // Sets both data rates, runs the magnetometer continuously and the
+    // accelerometer FIFO in stream mode with a watermark interrupt, and
+    // enables asynchronous acquisition. false on a bus error or when the
+    // accelerometer control registers do not read back, i.e. the device
+    // does not answer.
+    bool configure(const Config& config);
+
+    /*
+    The configuration registers of both devices are shadowed in RAM: the
+    single-register read() serves them without a transaction once known,
+    and write() drops writes of the value the device already holds. Status
+    and output registers always go to the bus, and so do burst reads, which
+    leave the shadow alone.
+
+    The blocking calls return false on a bus error, which the
+    single-register read() reports as 0, and count it in busStats(). A
+    failed transfer recovers the bus right away, as a slave holding SDA
+    low would fail every further one, and a failed write forgets the
+    shadow of that device.
+    */
     uint8_t read(AccRegister reg);
-    void read(AccRegister startReg, uint8_t* data, uint8_t count);
-    void write(AccRegister reg, uint8_t value);
-    void write(AccRegister startReg, uint8_t* data, uint8_t count);
+    bool read(AccRegister startReg, uint8_t* data, uint8_t count);
+    bool write(AccRegister reg, uint8_t value);
+    bool write(AccRegister startReg, uint8_t* data, uint8_t count);
 
     uint8_t read(MagRegister reg);
-    void write(MagRegister reg, uint8_t value);
-    void read(MagRegister startReg, uint8_t* data, uint8_t count);
-    void write(MagRegister startReg, uint8_t* data, uint8_t count);
+    bool write(MagRegister reg, uint8_t value);
+    bool read(MagRegister startReg, uint8_t* data, uint8_t count);
+    bool write(MagRegister startReg, uint8_t* data, uint8_t count);
+
+    // Writes the registers from startReg on that differ from values in one
+    // burst, if there are any, false when the write failed
+    bool applyProfile(AccRegister startReg, const uint8_t* values, uint8_t count);
+    bool applyProfile(MagRegister startReg, const uint8_t* values, uint8_t count);
+
+    // Makes the next accesses go to the bus, e.g. after a reboot
+    void forgetConfiguration();
+
+    // One bus transaction each: the accelerometer auto-increments when the
+    // MSB of the sub-address is set, the magnetometer always does
+    bool readAcceleration(Vector3& accelerations);
+    bool readMagneticField(Vector3& magneticField);
+
+    // FM1..FM0 of FIFO_CTRL_REG_A
+    enum class FifoMode : uint8_t {
+        BYPASS  = 0x0,
+        FIFO    = 0x1,
+        STREAM  = 0x2,
+        TRIGGER = 0x3
+    };
+
+    // Accelerometer samples the hardware FIFO holds
+    static constexpr uint8_t FIFO_DEPTH = 32;
+    // A full FIFO and the magnetometer sample taken with it
+    static constexpr uint8_t MAX_BURST = FIFO_DEPTH + 1;
+
+    /*
+    Accelerometer FIFO. The sensor queues up to FIFO_DEPTH samples, so a
+    high output data rate costs one bus transaction per batch rather than
+    per sample. watermark (0..31) sets the level of the WTM flag, which is
+    routed to INT1 instead of DRDY1 when interruptOnWatermark is set.
+    */
+    void enableFifo(FifoMode mode, uint8_t watermark, bool interruptOnWatermark = false);
+    void disableFifo();
+
+    // Number of unread accelerometer samples in the FIFO
+    uint8_t fifoLevel();
+
+    // Drains up to maxCount samples, oldest first, in one transaction and
+    // returns how many were read, 0 on a bus error
+    uint8_t readFifo(Vector3* accelerations, uint8_t maxCount);
 
-    void readAcceleration(Vector3& accelerations);
-    void readMagneticField(Vector3& magneticField);
+    // One acquisition: accelerationCount accelerometer samples, oldest
+    // first, and a magnetometer sample, each with its clock stamp
+    struct Sample {
+        Vector3 acceleration[FIFO_DEPTH];
+        uint32_t accelerationTime[FIFO_DEPTH];
+        uint8_t accelerationCount;
+        Vector3 magneticField;
+        uint32_t magneticFieldTime;
+    };
+
+    /*
+    Non-blocking acquisition. Once enabled, INT1 (DRDY1 or the FIFO
+    watermark) calls onDataReady() from its EXTI interrupt, which stamps
+    the batch with clock and starts a DMA read of samplesPerBurst
+    accelerometer samples, stamped evenly between the previous batch and
+    this one. The first batch after enabling only starts the time base and
+    is dropped, unless it is a single sample stamped at its interrupt. Its
+    completion, onTransferComplete() from
+    HAL_I2C_MemRxCpltCallback, chains the magnetometer read, and the second
+    completion publishes the sample, so no task ever waits on the bus. The
+    magnetometer runs at its own rate and may repeat its last value. The
+    blocking calls above must not be used meanwhile. A failure in either
+    read drops the sample and is retried as described for TransferGuard.
+    */
+    void enableAsync(GPIO_TypeDef* int1Port, uint16_t int1Pin, uint8_t samplesPerBurst,
+                     Clock clock);
+    // Waits for the read in flight up to the timeout, then aborts it
+    void disableAsync();
+
+    // Interrupt context, onTransferComplete() is true once a sample is ready
+    void onDataReady();
+    bool onTransferComplete();
+    void onTransferError();
+
+    // Task context: abandons an overdue read and restarts after a failure
+    void service();
+
+    const BusStats& busStats() const { return guard_.stats(); }
+
+    // false when no sample arrived since the previous call
+    bool takeSample(Sample& sample);
+
+    // The same as a flat list, the accelerometer samples followed by the
+    // magnetometer one, 0 when nothing arrived. A maxCount below
+    // MAX_BURST drops the rest of the sample.
+    uint8_t readBurst(RawSample* samples, uint8_t maxCount);
+
+    // Samples that were overwritten before takeSample() got to them
+    uint32_t overruns() const { return overruns_; }
 
 private:
-    void read(uint8_t devAddr, uint8_t regAddr, uint8_t* data, uint8_t count);
-    void write(uint8_t devAddr, uint8_t regAddr, uint8_t* data, uint8_t count);
+    enum class State : uint8_t {
+        IDLE,
+        ACCELERATION,
+        MAGNETIC_FIELD
+    };
+
+    bool read(uint8_t devAddr, uint8_t regAddr, uint8_t* data, uint8_t count);
+    bool write(uint8_t devAddr, uint8_t regAddr, uint8_t* data, uint8_t count);
+    bool blockingFailed();
+    bool startRead(uint8_t devAddr, uint8_t regAddr, uint8_t* data, uint8_t count);
+    void fail();
+    bool int1High() const;
 
     I2C_HandleTypeDef& hi2c_;
+
+    // CTRL_REG1_A .. TIME_WINDOW_A and CRA_REG_M .. MR_REG_M
+    RegisterShadow<0x20, 0x1E> accelerometerShadow_;
+    RegisterShadow<0x00, 0x03> magnetometerShadow_;
+
+    uint8_t accelerationData_[FIFO_DEPTH * 6] = {};
+    uint8_t magneticFieldData_[6] = {};
+    Sample pending_{};
+    Sample ready_{};
+    GPIO_TypeDef* int1Port_{nullptr};
+    uint16_t int1Pin_{0};
+    uint8_t burstSamples_{1};
+    Clock clock_{nullptr};
+    uint32_t batchTime_{0};
+    uint32_t lastBatchTime_{0};
+    bool lastBatchValid_{false};
+    volatile State state_{State::IDLE};
+    volatile bool fresh_{false};
+    volatile uint32_t overruns_{0};
+
+    TransferGuard guard_;
 };
 
 }
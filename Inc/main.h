@@ -57,8 +57,14 @@ void Error_Handler(void);
 /* USER CODE END EFP */
 
 /* Private defines -----------------------------------------------------------*/
+#define GYRO_INT2_Pin GPIO_PIN_1
+#define GYRO_INT2_GPIO_Port GPIOE
+#define GYRO_INT2_EXTI_IRQn EXTI1_IRQn
 #define GYRO_CS_Pin GPIO_PIN_3
 #define GYRO_CS_GPIO_Port GPIOE
+#define ACC_INT1_Pin GPIO_PIN_4
+#define ACC_INT1_GPIO_Port GPIOE
+#define ACC_INT1_EXTI_IRQn EXTI4_IRQn
 #define LD4_Pin GPIO_PIN_8
 #define LD4_GPIO_Port GPIOE
 #define LD3_Pin GPIO_PIN_9
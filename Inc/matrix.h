@@ -1,16 +1,53 @@
 #ifndef MATRIX_H
 #define MATRIX_H
 
+#include "kernels.h"
 #include "vector.h"
 #include <initializer_list>
 #include <algorithm>
+#include <cmath>
+#include <cstddef>
 #include <cstdint>
+#include <type_traits>
 
 namespace mart
 {
 
 namespace alloc {
-template <class T, uint16_t nrows, uint16_t ncols>
+
+/*
+Storage layout of an owning matrix. The buffer starts at a multiple of
+alignment bytes and every row is padded to a whole number of alignment
+bytes, so each row starts aligned too and a full-width vector load never
+needs a scalar remainder. The padding is skipped by the view through
+skipCols, the elements in it are kept zero.
+
+Dense (no padding, natural alignment) is the default and what the target
+uses, e.g. Aligned<32> suits AVX on the host.
+*/
+template <std::size_t alignment>
+struct Aligned {
+    static_assert((alignment & (alignment - 1)) == 0,
+                  "alignment must be a power of two");
+
+    template <class T>
+    static constexpr std::size_t align()
+    {
+        return alignment > alignof(T) ? alignment : alignof(T);
+    }
+
+    template <class T>
+    static constexpr uint16_t leadingDim(uint16_t ncols)
+    {
+        constexpr uint16_t multiple =
+            alignment > sizeof(T) ? alignment / sizeof(T) : 1;
+        return (ncols + multiple - 1) / multiple * multiple;
+    }
+};
+
+using Dense = Aligned<1>;
+
+template <class T, uint16_t nrows, uint16_t ncols, class Layout = Dense>
 class Matrix;
 }
 
@@ -31,6 +68,10 @@ public:
     Matrix<T, nrows, ncols>& operator=(std::initializer_list<T> il);
 
     const T* raw() const { return d_; }
+    T* raw() { return d_; }
+
+    // Distance between the starts of two consecutive rows
+    uint16_t stride() const { return ncols + skipCols_; }
 
     T& operator()(uint16_t row, uint16_t col) { return at(row, col); }
 
@@ -40,9 +81,13 @@ public:
 
     Matrix<T, nrows, ncols>& operator+=(const Matrix<T, nrows, ncols>& rhs);
 
+    Alloc operator-(const Matrix<T, nrows, ncols>& rhs) const;
+
+    Matrix<T, nrows, ncols>& operator-=(const Matrix<T, nrows, ncols>& rhs);
+
     alloc::Matrix<T, nrows, ncols> operator*(T mul) const;
 
-    Matrix<T, nrows, ncols>& operator*=(T mul) const;
+    Matrix<T, nrows, ncols>& operator*=(T mul);
 
     alloc::Vector<T, nrows> operator*(const Vector<T, ncols>& vec) const;
 
@@ -55,14 +100,42 @@ public:
 
     void luDecompose(Matrix<T, nrows, nrows>& L, Matrix<T, nrows, nrows>& U) const;
 
-    Matrix<T, nrows, nrows> inverse() const;
+    // Inverse of a matrix given by its LU factors, lets callers which
+    // already hold a factorisation (and its determinant) skip a second one
+    static void luInverse(const Matrix<T, nrows, nrows>& L,
+                          const Matrix<T, nrows, nrows>& U,
+                          Matrix<T, nrows, nrows>& inv);
+
+    alloc::Matrix<T, nrows, nrows> inverse() const;
     void inverse(Matrix<T, nrows, nrows>& inv) const;
 
+    T determinant() const;
+
+    // e^A by a (6, 6) Pade approximant with scaling and squaring
+    alloc::Matrix<T, nrows, nrows> expm() const;
+    void expm(Matrix<T, nrows, nrows>& result) const;
+
     static alloc::Matrix<T, nrows, ncols> eye();
 
     template <uint16_t subRows, uint16_t subCols>
     Matrix<T, subRows, subCols> submat(uint16_t fromRow, uint16_t fromCol);
 
+    // In-place views, writes through them change the matrix
+    Vector<T, ncols> row(uint16_t i) const { return Vector<T, ncols>(d_ + i * stride()); }
+
+    Vector<T, nrows> col(uint16_t j) const { return Vector<T, nrows>(d_ + j, stride()); }
+
+    Vector<T, nrows> diag() const
+    {
+        static_assert(nrows == ncols, "diagonal of a non-square matrix");
+        return Vector<T, nrows>(d_, stride() + 1);
+    }
+
+    // View of block (blockRow, blockCol) of the grid of subRows x subCols
+    // blocks, the counterpart of partition() without building a view table
+    template <uint16_t blockRow, uint16_t blockCol, uint16_t subRows, uint16_t subCols>
+    Matrix<T, subRows, subCols> block();
+
     template <uint16_t subRows, uint16_t subCols>
     alloc::Matrix<Matrix<T, subRows, subCols>, nrows / subRows, ncols / subCols>
     partition();
@@ -78,34 +151,64 @@ protected:
 
 namespace alloc
 {
-template <class T, uint16_t nrows, uint16_t ncols>
+template <class T, uint16_t nrows, uint16_t ncols, class Layout>
 class Matrix : public ::mart::Matrix<T, nrows, ncols>
 {
 public:
-    Matrix() : ::mart::Matrix<T, nrows, ncols>(data_) {}
+    // Distance between the starts of two rows of the buffer
+    static constexpr uint16_t LeadingDim = Layout::template leadingDim<T>(ncols);
 
+    Matrix() : ::mart::Matrix<T, nrows, ncols>(data_, LeadingDim - ncols) {}
+
+    // data holds nrows * ncols elements without padding
     explicit Matrix(const T* data) : Matrix()
     {
-        std::copy(data, data + nrows * ncols, data_);
+        for (uint16_t row = 0; row < nrows; ++row) {
+            std::copy(data + row * ncols, data + (row + 1) * ncols,
+                      data_ + row * LeadingDim);
+        }
     }
 
-    Matrix(const Matrix<T, nrows, ncols>& other) : Matrix(other.data_) {}
+    Matrix(const Matrix<T, nrows, ncols, Layout>& other) : Matrix()
+    {
+        *this = other;
+    }
 
-    Matrix(const ::mart::Matrix<T, nrows, ncols>& other) : Matrix(other.raw()) {}
+    Matrix(const ::mart::Matrix<T, nrows, ncols>& other) : Matrix()
+    {
+        *this = other;
+    }
 
     Matrix(std::initializer_list<T> il) : Matrix()
     {
-        std::copy(il.begin(), il.end(), data_);
+        ::mart::Matrix<T, nrows, ncols>::operator=(std::move(il));
+    }
+
+    // Assignment copies the elements, the view must keep pointing to data_
+    Matrix<T, nrows, ncols, Layout>& operator=(const Matrix<T, nrows, ncols, Layout>& other)
+    {
+        std::copy(other.data_, other.data_ + nrows * LeadingDim, data_);
+        return *this;
+    }
+
+    Matrix<T, nrows, ncols, Layout>& operator=(const ::mart::Matrix<T, nrows, ncols>& other)
+    {
+        for (uint16_t row = 0; row < nrows; ++row) {
+            for (uint16_t col = 0; col < ncols; ++col) {
+                data_[row * LeadingDim + col] = other(row, col);
+            }
+        }
+        return *this;
     }
 
-    Matrix<T, nrows, ncols>& operator=(std::initializer_list<T> il)
+    Matrix<T, nrows, ncols, Layout>& operator=(std::initializer_list<T> il)
     {
         ::mart::Matrix<T, nrows, ncols>::operator=(std::move(il));
         return *this;
     }
 
 private:
-    T data_[nrows * ncols]{};
+    alignas(Layout::template align<T>()) T data_[nrows * LeadingDim]{};
 };
 
 }  // namespace alloc
@@ -130,22 +233,37 @@ template <class T, uint16_t nrows, uint16_t ncols>
 alloc::Matrix<T, nrows, ncols> Matrix<T, nrows, ncols>::operator+(const Matrix<T, nrows, ncols>& rhs) const
 {
     alloc::Matrix<T, nrows, ncols> result;
-    for (uint16_t row = 0; row < nrows; ++row) {
-        for (uint16_t col = 0; col < ncols; ++col) {
-            result(row, col) = at(row, col) + rhs(row, col);
-        }
-    }
+    kernel::elementwise<T, nrows, ncols>(d_, stride(), rhs.raw(), rhs.stride(),
+                                         result.raw(), result.stride(),
+                                         [](T a, T b) { return a + b; });
     return result;
 }
 
 template <class T, uint16_t nrows, uint16_t ncols>
 Matrix<T, nrows, ncols>& Matrix<T, nrows, ncols>::operator+=(const Matrix<T, nrows, ncols>& rhs)
 {
-    for (uint16_t row = 0; row < nrows; ++row) {
-        for (uint16_t col = 0; col < ncols; ++col) {
-            at(row, col) += rhs(row, col);
-        }
-    }
+    kernel::elementwise<T, nrows, ncols>(d_, stride(), rhs.raw(), rhs.stride(),
+                                         d_, stride(),
+                                         [](T a, T b) { return a + b; });
+    return *this;
+}
+
+template <class T, uint16_t nrows, uint16_t ncols>
+alloc::Matrix<T, nrows, ncols> Matrix<T, nrows, ncols>::operator-(const Matrix<T, nrows, ncols>& rhs) const
+{
+    alloc::Matrix<T, nrows, ncols> result;
+    kernel::elementwise<T, nrows, ncols>(d_, stride(), rhs.raw(), rhs.stride(),
+                                         result.raw(), result.stride(),
+                                         [](T a, T b) { return a - b; });
+    return result;
+}
+
+template <class T, uint16_t nrows, uint16_t ncols>
+Matrix<T, nrows, ncols>& Matrix<T, nrows, ncols>::operator-=(const Matrix<T, nrows, ncols>& rhs)
+{
+    kernel::elementwise<T, nrows, ncols>(d_, stride(), rhs.raw(), rhs.stride(),
+                                         d_, stride(),
+                                         [](T a, T b) { return a - b; });
     return *this;
 }
 
@@ -162,7 +280,7 @@ alloc::Matrix<T, nrows, ncols> Matrix<T, nrows, ncols>::operator*(T mul) const
 }
 
 template <class T, uint16_t nrows, uint16_t ncols>
-Matrix<T, nrows, ncols>& Matrix<T, nrows, ncols>::operator*=(T mul) const
+Matrix<T, nrows, ncols>& Matrix<T, nrows, ncols>::operator*=(T mul)
 {
     for (uint16_t row = 0; row < nrows; ++row) {
         for (uint16_t col = 0; col < ncols; ++col) {
@@ -176,11 +294,8 @@ template <class T, uint16_t nrows, uint16_t ncols>
 alloc::Vector<T, nrows> Matrix<T, nrows, ncols>::operator*(const Vector<T, ncols>& vec) const
 {
     alloc::Vector<T, nrows> result;
-    for (uint16_t row = 0; row < nrows; ++row) {
-        for (uint16_t col = 0; col < ncols; ++col) {
-            result[row] += at(row, col) * vec[col];
-        }
-    }
+    kernel::multiplyVector<T, nrows, ncols>(d_, stride(), vec.raw(), vec.stride(),
+                                            result.raw());
     return result;
 }
 
@@ -189,20 +304,15 @@ template <uint16_t size>
 alloc::Matrix<T, nrows, size> Matrix<T, nrows, ncols>::operator*(const Matrix<T, ncols, size>& mat) const
 {
     alloc::Matrix<T, nrows, size> result;
-    for (uint16_t row = 0; row < nrows; ++row) {
-        for (uint16_t col = 0; col < size; ++col) {
-            for (uint16_t i = 0; i < ncols; ++i) {
-                result(row, col) += at(row, i) * mat(i, col);
-            }
-        }
-    }
+    kernel::multiply<T, nrows, ncols, size>(d_, stride(), mat.raw(), mat.stride(),
+                                            result.raw(), result.stride());
     return result;
 }
 
 template <class T, uint16_t nrows, uint16_t ncols>
 alloc::Matrix<T, ncols, nrows> Matrix<T, nrows, ncols>::transpose() const
 {
-    alloc::Matrix<T, nrows, ncols> result;
+    alloc::Matrix<T, ncols, nrows> result;
     transpose(result);
     return result;
 }
@@ -212,7 +322,7 @@ void Matrix<T, nrows, ncols>::transpose(Matrix<T, ncols, nrows>& tr) const
 {
     for (uint16_t row = 0; row < nrows; ++row) {
         for (uint16_t col = 0; col < ncols; ++col) {
-            tr(row, col) = at(col, row);
+            tr(col, row) = at(row, col);
         }
     }
 }
@@ -241,6 +351,128 @@ void Matrix<T, nrows, ncols>::luDecompose(Matrix<T, nrows, nrows>& L, Matrix<T,
     }
 }
 
+template <class T, uint16_t nrows, uint16_t ncols>
+void Matrix<T, nrows, ncols>::luInverse(const Matrix<T, nrows, nrows>& L,
+                                        const Matrix<T, nrows, nrows>& U,
+                                        Matrix<T, nrows, nrows>& inv)
+{
+    // Solve L * U * inv = I column by column
+    for (uint16_t col = 0; col < nrows; ++col) {
+        // forward substitution: L * y = e_col, y is kept in inv(:, col)
+        for (uint16_t i = 0; i < nrows; ++i) {
+            T sum = (i == col) ? 1 : 0;
+            for (uint16_t k = 0; k < i; ++k) {
+                sum -= L(i, k) * inv(k, col);
+            }
+            inv(i, col) = sum;
+        }
+        // back substitution: U * x = y
+        for (uint16_t i = nrows; i-- > 0;) {
+            T sum = inv(i, col);
+            for (uint16_t k = i + 1; k < nrows; ++k) {
+                sum -= U(i, k) * inv(k, col);
+            }
+            inv(i, col) = sum / U(i, i);
+        }
+    }
+}
+
+template <class T, uint16_t nrows, uint16_t ncols>
+alloc::Matrix<T, nrows, nrows> Matrix<T, nrows, ncols>::inverse() const
+{
+    alloc::Matrix<T, nrows, nrows> result;
+    inverse(result);
+    return result;
+}
+
+template <class T, uint16_t nrows, uint16_t ncols>
+void Matrix<T, nrows, ncols>::inverse(Matrix<T, nrows, nrows>& inv) const
+{
+    alloc::Matrix<T, nrows, nrows> L, U;
+    luDecompose(L, U);
+    luInverse(L, U, inv);
+}
+
+template <class T, uint16_t nrows, uint16_t ncols>
+T Matrix<T, nrows, ncols>::determinant() const
+{
+    alloc::Matrix<T, nrows, nrows> L, U;
+    luDecompose(L, U);
+    T det = 1;
+    for (uint16_t i = 0; i < nrows; ++i) {
+        det *= U(i, i);
+    }
+    return det;
+}
+
+template <class T, uint16_t nrows, uint16_t ncols>
+alloc::Matrix<T, nrows, nrows> Matrix<T, nrows, ncols>::expm() const
+{
+    alloc::Matrix<T, nrows, nrows> result;
+    expm(result);
+    return result;
+}
+
+template <class T, uint16_t nrows, uint16_t ncols>
+void Matrix<T, nrows, ncols>::expm(Matrix<T, nrows, nrows>& result) const
+{
+    static_assert(nrows == ncols, "exponential of a non-square matrix");
+
+    // Golub & Van Loan, Algorithm 11.3.1: A is scaled by 2^-s so that
+    // ||X||_inf <= 1/2, then e^X ~ D^-1 * N with
+    // N = sum c_k X^k, D = sum (-1)^k c_k X^k, k = 0..q
+    // and e^A = (e^X)^(2^s)
+    constexpr uint16_t q = 6;
+
+    T normInf = 0;
+    for (uint16_t row = 0; row < nrows; ++row) {
+        T sum = 0;
+        for (uint16_t col = 0; col < ncols; ++col) {
+            sum += std::abs(at(row, col));
+        }
+        normInf = std::max(normInf, sum);
+    }
+    int exponent = 0;
+    std::frexp(normInf, &exponent);
+    const int s = std::max(0, exponent + 1);
+
+    alloc::Matrix<T, nrows, nrows> X(*this);
+    X *= std::ldexp(T(1), -s);
+
+    alloc::Matrix<T, nrows, nrows> power(X);
+    alloc::Matrix<T, nrows, nrows> N = eye();
+    alloc::Matrix<T, nrows, nrows> D = eye();
+    T c = 1;
+    for (uint16_t k = 1; k <= q; ++k) {
+        c = c * (q - k + 1) / (k * (2 * q - k + 1));
+        if (k > 1) {
+            power = X * power;
+        }
+        const T sign = k % 2 == 0 ? 1 : -1;
+        for (uint16_t row = 0; row < nrows; ++row) {
+            for (uint16_t col = 0; col < ncols; ++col) {
+                N(row, col) += c * power(row, col);
+                D(row, col) += sign * c * power(row, col);
+            }
+        }
+    }
+
+    // D is close to I, LU without pivoting is safe
+    D.inverse(X);
+    kernel::multiply<T, nrows, nrows, nrows>(X.raw(), X.stride(), N.raw(), N.stride(),
+                                             result.raw(), result.stride());
+    for (int i = 0; i < s; ++i) {
+        kernel::multiply<T, nrows, nrows, nrows>(result.raw(), result.stride(),
+                                                 result.raw(), result.stride(),
+                                                 X.raw(), X.stride());
+        for (uint16_t row = 0; row < nrows; ++row) {
+            for (uint16_t col = 0; col < ncols; ++col) {
+                result(row, col) = X(row, col);
+            }
+        }
+    }
+}
+
 template <class T, uint16_t nrows, uint16_t ncols>
 alloc::Matrix<T, nrows, ncols> Matrix<T, nrows, ncols>::eye()
 {
@@ -259,6 +491,15 @@ Matrix<T, nrows, ncols>::submat(uint16_t fromRow, uint16_t fromCol)
     return Matrix<T, subRows, subCols>(&at(fromRow, fromCol), ncols + skipCols_ - subCols);
 }
 
+template <class T, uint16_t nrows, uint16_t ncols>
+template <uint16_t blockRow, uint16_t blockCol, uint16_t subRows, uint16_t subCols>
+Matrix<T, subRows, subCols> Matrix<T, nrows, ncols>::block()
+{
+    static_assert((blockRow + 1) * subRows <= nrows, "block row out of range");
+    static_assert((blockCol + 1) * subCols <= ncols, "block column out of range");
+    return submat<subRows, subCols>(blockRow * subRows, blockCol * subCols);
+}
+
 template <class T, uint16_t nrows, uint16_t ncols>
 template <uint16_t subRows, uint16_t subCols>
 alloc::Matrix<Matrix<T, subRows, subCols>, nrows / subRows, ncols / subCols>
@@ -273,6 +514,139 @@ Matrix<T, nrows, ncols>::partition()
     return P;
 }
 
+
+/*
+Lazy operands for matrix products. transposed(A) and scaled(A, s) keep a
+view of A only: the product kernels read A in place with the index order
+swapped and apply the scale once to every sum, so neither A^T nor s * A is
+materialised. The adaptors nest, e.g. scaled(transposed(A), s).
+*/
+
+template <class M>
+class Transposed;
+
+template <class M>
+class Scaled;
+
+template <class M>
+struct IsLazy : std::false_type {};
+
+template <class M>
+struct IsLazy<Transposed<M>> : std::true_type {};
+
+template <class M>
+struct IsLazy<Scaled<M>> : std::true_type {};
+
+template <class T, uint16_t nrows, uint16_t ncols>
+kernel::Operand<T> operand(const Matrix<T, nrows, ncols>& m)
+{
+    return {m.raw(), m.stride(), 1, 1};
+}
+
+template <class M>
+kernel::Operand<typename M::Type> operand(const Transposed<M>& m);
+
+template <class M>
+kernel::Operand<typename M::Type> operand(const Scaled<M>& m);
+
+template <class M>
+class Transposed
+{
+public:
+    using Type = typename M::Type;
+    static constexpr uint16_t NumRows = M::NumCols;
+    static constexpr uint16_t NumCols = M::NumRows;
+
+    explicit Transposed(const M& m) : m_(m) {}
+
+    Type operator()(uint16_t row, uint16_t col) const { return m_(col, row); }
+
+    kernel::Operand<Type> operand() const
+    {
+        auto op = ::mart::operand(m_);
+        std::swap(op.rowStride, op.colStride);
+        return op;
+    }
+
+private:
+    const M m_;
+};
+
+template <class M>
+class Scaled
+{
+public:
+    using Type = typename M::Type;
+    static constexpr uint16_t NumRows = M::NumRows;
+    static constexpr uint16_t NumCols = M::NumCols;
+
+    Scaled(const M& m, Type scale) : m_(m), scale_(scale) {}
+
+    Type operator()(uint16_t row, uint16_t col) const { return m_(row, col) * scale_; }
+
+    kernel::Operand<Type> operand() const
+    {
+        auto op = ::mart::operand(m_);
+        op.scale *= scale_;
+        return op;
+    }
+
+private:
+    const M m_;
+    const Type scale_;
+};
+
+template <class M>
+kernel::Operand<typename M::Type> operand(const Transposed<M>& m)
+{
+    return m.operand();
+}
+
+template <class M>
+kernel::Operand<typename M::Type> operand(const Scaled<M>& m)
+{
+    return m.operand();
+}
+
+// A plain matrix is taken by view, an adaptor by value
+template <class T, uint16_t nrows, uint16_t ncols>
+Transposed<Matrix<T, nrows, ncols>> transposed(const Matrix<T, nrows, ncols>& m)
+{
+    return Transposed<Matrix<T, nrows, ncols>>(m);
+}
+
+template <class M, class = std::enable_if_t<IsLazy<M>::value>>
+Transposed<M> transposed(const M& m)
+{
+    return Transposed<M>(m);
+}
+
+template <class T, uint16_t nrows, uint16_t ncols>
+Scaled<Matrix<T, nrows, ncols>> scaled(const Matrix<T, nrows, ncols>& m, T scale)
+{
+    return Scaled<Matrix<T, nrows, ncols>>(m, scale);
+}
+
+template <class M, class = std::enable_if_t<IsLazy<M>::value>>
+Scaled<M> scaled(const M& m, typename M::Type scale)
+{
+    return Scaled<M>(m, scale);
+}
+
+// Products with at least one lazy operand, Matrix * Matrix stays a member
+template <class A, class B,
+          class = std::enable_if_t<IsLazy<A>::value || IsLazy<B>::value>>
+alloc::Matrix<typename A::Type, A::NumRows, B::NumCols>
+operator*(const A& a, const B& b)
+{
+    static_assert(A::NumCols == B::NumRows, "inner dimensions must agree");
+    using T = typename A::Type;
+    alloc::Matrix<T, A::NumRows, B::NumCols> result;
+    kernel::multiply<T, A::NumRows, A::NumCols, B::NumCols>(
+        operand(a), operand(b), result.raw(), result.stride());
+    return result;
+}
+
 }
 
 #endif /* MATRIX_H */
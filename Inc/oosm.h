@@ -0,0 +1,168 @@
+#ifndef OOSM_H
+#define OOSM_H
+
+#include "clock.h"
+#include "smoother.h"
+
+namespace mart
+{
+
+/*
+Out-of-sequence measurement handling for an ExtendedKalmanFilter whose
+samples may arrive late, e.g. when the magnetometer is read over DMA after
+newer gyroscope samples were already processed.
+
+The last `window` measurements are kept, ordered by timestamp, together with
+the filter posterior each of them produced, plus the posterior right before
+the oldest one (the base). A sample newer than everything seen is applied
+right away. A late sample is inserted at its place in time, the filter is
+rolled back to the posterior preceding it and the newer measurements are
+replayed with the dt between their timestamps. The worst case is thus
+`window` filter updates per late sample. Samples older than the base cannot
+be placed any more and are rejected.
+
+Timestamps are stamps of a free-running counter, as the sensors deliver
+them, and not seconds in ValueType: a float clock cannot tell samples a
+few ms apart after hours of uptime. Stamps are ordered and differenced
+modulo 2^32, so the window must span less than half a counter period.
+*/
+template <class Filter, uint16_t window>
+class OutOfSequenceFilter
+{
+public:
+    using ValueType     = typename Filter::ValueType;
+    using State         = typename Filter::State;
+    using ProcessMatrix = typename Filter::ProcessMatrix;
+    using Measurement   = typename Filter::Measurement;
+    using Workspace     = typename Filter::Workspace;
+
+    enum class Status : uint8_t {
+        Applied,   // in order, one filter update
+        Replayed,  // late, the newer part of the window was replayed
+        TooOld     // older than the window, dropped
+    };
+
+    // counterFrequency is the rate of the counter the samples are stamped with
+    OutOfSequenceFilter(const Filter& filter, uint32_t counterFrequency, uint32_t startStamp)
+        : filter_(filter), time_(counterFrequency)
+    {
+        base_.time = startStamp;
+        snapshot(base_);
+    }
+
+    const Filter& filter() const { return filter_; }
+    const State& state() const { return filter_.state(); }
+    const ProcessMatrix& covariance() const { return filter_.covariance(); }
+
+    uint16_t size() const { return count_; }
+
+    // Stamp of the oldest sample that can still be accepted
+    uint32_t horizon() const { return base_.time; }
+
+    Status update(const Measurement& z, uint32_t timestamp)
+    {
+        const uint32_t newestTime = count_ > 0 ? at(count_ - 1).time : base_.time;
+        if (!CounterTime::isBefore(timestamp, newestTime)) {
+            filter_.update(z, time_.secondsBetween<ValueType>(newestTime, timestamp), ws_);
+            if (count_ == window) {
+                dropOldest();
+            }
+            Entry& e = at(count_++);
+            e.time = timestamp;
+            e.z = z;
+            snapshot(e);
+            return Status::Applied;
+        }
+
+        if (CounterTime::isBefore(timestamp, base_.time)) {
+            return Status::TooOld;
+        }
+
+        uint16_t pos = 0;
+        while (!CounterTime::isBefore(timestamp, at(pos).time)) {
+            ++pos;
+        }
+        if (count_ == window) {
+            if (pos == 0) {
+                // Making room would drop the posterior we have to start from
+                return Status::TooOld;
+            }
+            dropOldest();
+            --pos;
+        }
+
+        for (uint16_t i = count_; i > pos; --i) {
+            at(i) = at(i - 1);
+        }
+        ++count_;
+        at(pos).time = timestamp;
+        at(pos).z = z;
+
+        replay(pos);
+        return Status::Replayed;
+    }
+
+private:
+    static constexpr uint16_t stateSize = State::Size;
+    using AllocState       = typename State::Alloc;
+    using AllocMeasurement = typename Measurement::Alloc;
+
+    struct Snapshot {
+        uint32_t time;
+        AllocState mu;
+        ValueType Sigma[packedSize<stateSize>()];
+    };
+
+    struct Entry : Snapshot {
+        AllocMeasurement z;
+    };
+
+    Entry& at(uint16_t i) { return entries_[(oldest_ + i) % window]; }
+
+    void snapshot(Snapshot& s) const
+    {
+        s.mu = filter_.state();
+        packSymmetric(filter_.covariance(), s.Sigma);
+    }
+
+    void restore(const Snapshot& s)
+    {
+        unpackSymmetric(s.Sigma, Sigma_);
+        filter_.reset(s.mu, Sigma_);
+    }
+
+    void dropOldest()
+    {
+        base_ = at(0);
+        oldest_ = (oldest_ + 1) % window;
+        --count_;
+    }
+
+    void replay(uint16_t from)
+    {
+        const Snapshot& start = from == 0 ? base_ : at(from - 1);
+        restore(start);
+        uint32_t time = start.time;
+        for (uint16_t i = from; i < count_; ++i) {
+            Entry& e = at(i);
+            filter_.update(e.z, time_.secondsBetween<ValueType>(time, e.time), ws_);
+            snapshot(e);
+            time = e.time;
+        }
+    }
+
+    Filter filter_;
+    Workspace ws_;
+    CounterTime time_;
+
+    Snapshot base_;
+    Entry entries_[window];
+    uint16_t oldest_{0};
+    uint16_t count_{0};
+
+    typename ProcessMatrix::Alloc Sigma_;
+};
+
+}  // namespace mart
+
+#endif /* OOSM_H */
@@ -0,0 +1,73 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "types.h"
+#include <cstdint>
+
+namespace mart
+{
+
+/*
+Turns the raw sample stream into filter updates. The latest acceleration
+and magnetic field are held, and every gyroscope sample, the fastest
+stream, triggers one Estimator::update(z, timestamp) with
+z = (w, g, m) in physical units. Nothing is fed before both slower sensors
+have reported once.
+
+Estimator needs a Measurement vector type of size 9 and
+update(const Measurement&, uint32_t timestamp), as OrientationEstimator.
+*/
+template <class Estimator>
+class SampleFusion
+{
+public:
+    using Measurement = typename Estimator::Measurement;
+
+    // Physical units per LSB, per sensor and axis, indexed by SensorId
+    struct Scales {
+        float perLsb[3][3];
+    };
+
+    SampleFusion(Estimator& estimator, const Scales& scales)
+        : estimator_(estimator), scales_(scales)
+    {
+    }
+
+    // Returns the number of filter updates
+    uint32_t consume(const RawSample* samples, uint32_t count)
+    {
+        uint32_t updates = 0;
+        for (uint32_t i = 0; i < count; ++i) {
+            const RawSample& sample = samples[i];
+            const uint8_t sensor = static_cast<uint8_t>(sample.sensor);
+            if (sensor > static_cast<uint8_t>(SensorId::MAGNETOMETER)) {
+                continue;
+            }
+
+            const int16_t raw[3] = {sample.value.x, sample.value.y, sample.value.z};
+            for (uint16_t axis = 0; axis < 3; ++axis) {
+                z_[sensor * 3 + axis] = raw[axis] * scales_.perLsb[sensor][axis];
+            }
+            seen_ |= static_cast<uint8_t>(1u << sensor);
+
+            if (sample.sensor == SensorId::GYROSCOPE && seen_ == ALL_SEEN) {
+                estimator_.update(z_, sample.timestamp);
+                ++updates;
+            }
+        }
+        return updates;
+    }
+
+private:
+    static constexpr uint8_t ALL_SEEN = 0x7;
+
+    Estimator& estimator_;
+    const Scales scales_;
+    // SensorId order matches z = (w, g, m)
+    typename Measurement::Alloc z_;
+    uint8_t seen_{0};
+};
+
+}  // namespace mart
+
+#endif /* PIPELINE_H */
@@ -0,0 +1,102 @@
+#ifndef REGSHADOW_H
+#define REGSHADOW_H
+
+#include <cstdint>
+
+namespace mart
+{
+
+/*
+RAM copy of the configuration registers first .. first + count - 1 of a
+device, so that reading back a setting or writing the value it already has
+costs no bus transaction. Only the registers set in the cacheable mask
+(bit i for first + i) are kept: status, output and self-clearing source
+registers always go to the bus. A register is known once it has been
+written or read, forget() drops everything, e.g. after a reset of the
+device or a failed transfer that may have left it half-written.
+
+A driver applies a configuration profile, the values of a run of
+consecutive registers, with changedSpan(): only the span between the first
+and the last register that differ is sent, in one burst. The unchanged
+ones in between are rewritten with the value they already hold.
+*/
+template <uint8_t first, uint8_t count>
+class RegisterShadow
+{
+    static_assert(count >= 1 && count <= 32, "one bit per register in a 32-bit mask");
+
+public:
+    static constexpr uint8_t FIRST = first;
+    static constexpr uint8_t COUNT = count;
+
+    explicit RegisterShadow(uint32_t cacheable) : cacheable_(cacheable) {}
+
+    bool cacheable(uint8_t reg) const
+    {
+        return reg >= first && reg - first < count && (cacheable_ & bit(reg)) != 0;
+    }
+
+    bool known(uint8_t reg) const { return cacheable(reg) && (known_ & bit(reg)) != 0; }
+
+    // Only meaningful when known(reg)
+    uint8_t value(uint8_t reg) const { return values_[reg - first]; }
+
+    // false when the device is known to hold value already
+    bool needsWrite(uint8_t reg, uint8_t value) const
+    {
+        return !known(reg) || values_[reg - first] != value;
+    }
+
+    // Records count values the device holds from startReg on, after a
+    // write or a read, the registers that are not cacheable are skipped
+    void store(uint8_t startReg, const uint8_t* data, uint8_t valueCount)
+    {
+        for (uint8_t i = 0; i < valueCount; ++i) {
+            const uint8_t reg = static_cast<uint8_t>(startReg + i);
+            if (cacheable(reg)) {
+                values_[reg - first] = data[i];
+                known_ |= bit(reg);
+            }
+        }
+    }
+
+    void store(uint8_t reg, uint8_t value) { store(reg, &value, 1); }
+
+    void forget() { known_ = 0; }
+
+    // Narrows the profile data[0 .. valueCount - 1] for the registers from
+    // startReg on down to data[offset .. offset + spanCount - 1], the part
+    // that has to be written, false when nothing has
+    bool changedSpan(uint8_t startReg, const uint8_t* data, uint8_t valueCount,
+                     uint8_t& offset, uint8_t& spanCount) const
+    {
+        auto changed = [&](uint8_t i) {
+            return needsWrite(static_cast<uint8_t>(startReg + i), data[i]);
+        };
+        uint8_t begin = 0;
+        while (begin < valueCount && !changed(begin)) {
+            ++begin;
+        }
+        if (begin == valueCount) {
+            return false;
+        }
+        uint8_t end = valueCount;
+        while (!changed(static_cast<uint8_t>(end - 1))) {
+            --end;
+        }
+        offset = begin;
+        spanCount = static_cast<uint8_t>(end - begin);
+        return true;
+    }
+
+private:
+    static uint32_t bit(uint8_t reg) { return uint32_t(1) << (reg - first); }
+
+    const uint32_t cacheable_;
+    uint32_t known_{0};
+    uint8_t values_[count] = {};
+};
+
+}  // namespace mart
+
+#endif /* REGSHADOW_H */
@@ -0,0 +1,153 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "clock.h"
+#include "sensor.h"
+#include "types.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+
+namespace mart
+{
+
+/*
+Host stand-in for the sensor drivers (std::thread and files are not
+available on target): readBurst() returns the samples of a recorded log,
+so the acquisition and filter code can be run and profiled on a
+workstation with real data. The log is a sequence of RECORD_BYTES
+little-endian records, see writeRecord().
+
+At full speed every readBurst() returns the next maxCount samples. In real
+time it sleeps until the next sample is due, as the sensors task waits for
+its notification on target, and returns it together with the ones that
+have come due meanwhile. Due times follow the stamps, taken at
+Config::counterFrequency, from the first sample on.
+*/
+class ReplaySensor
+{
+public:
+    struct Config {
+        const char* path;
+        uint32_t counterFrequency;  // of the recorded stamps
+        bool realTime;              // pace the samples, else full speed
+    };
+
+    static constexpr uint8_t MAX_BURST = 32;
+
+    // Stamp, x, y, z, sensor and a padding byte
+    static constexpr std::size_t RECORD_BYTES = 12;
+
+    ReplaySensor() = default;
+    ReplaySensor(const ReplaySensor&) = delete;
+    ReplaySensor& operator=(const ReplaySensor&) = delete;
+
+    ~ReplaySensor() { close(); }
+
+    // Opens the log and rewinds to its start, false if it cannot be opened
+    bool configure(const Config& config)
+    {
+        close();
+        file_ = std::fopen(config.path, "rb");
+        time_ = CounterTime(config.counterFrequency);
+        realTime_ = config.realTime;
+        started_ = false;
+        hasNext_ = file_ != nullptr && readRecord(next_);
+        return file_ != nullptr;
+    }
+
+    // 0 once the log is exhausted
+    uint8_t readBurst(RawSample* samples, uint8_t maxCount)
+    {
+        uint8_t count = 0;
+        if (realTime_ && hasNext_ && maxCount > 0) {
+            std::this_thread::sleep_until(dueTime(next_.timestamp));
+        }
+        while (count < maxCount && hasNext_) {
+            if (realTime_ && count > 0 &&
+                dueTime(next_.timestamp) > std::chrono::steady_clock::now()) {
+                break;
+            }
+            samples[count++] = next_;
+            hasNext_ = readRecord(next_);
+        }
+        return count;
+    }
+
+    bool finished() const { return !hasNext_; }
+
+    // Appends sample to a log in the format readBurst() replays
+    static bool writeRecord(std::FILE* file, const RawSample& sample)
+    {
+        unsigned char record[RECORD_BYTES] = {};
+        for (uint16_t i = 0; i < 4; ++i) {
+            record[i] = static_cast<unsigned char>(sample.timestamp >> (8 * i));
+        }
+        const int16_t values[3] = {sample.value.x, sample.value.y, sample.value.z};
+        for (uint16_t axis = 0; axis < 3; ++axis) {
+            const uint16_t value = static_cast<uint16_t>(values[axis]);
+            record[4 + 2 * axis] = static_cast<unsigned char>(value);
+            record[5 + 2 * axis] = static_cast<unsigned char>(value >> 8);
+        }
+        record[10] = static_cast<unsigned char>(sample.sensor);
+        return std::fwrite(record, 1, RECORD_BYTES, file) == RECORD_BYTES;
+    }
+
+private:
+    using TimePoint = std::chrono::steady_clock::time_point;
+
+    bool readRecord(RawSample& sample)
+    {
+        unsigned char record[RECORD_BYTES];
+        if (std::fread(record, 1, RECORD_BYTES, file_) != RECORD_BYTES) {
+            return false;
+        }
+        sample.timestamp = 0;
+        for (uint16_t i = 0; i < 4; ++i) {
+            sample.timestamp |= static_cast<uint32_t>(record[i]) << (8 * i);
+        }
+        sample.value.x = static_cast<int16_t>(record[4] | record[5] << 8);
+        sample.value.y = static_cast<int16_t>(record[6] | record[7] << 8);
+        sample.value.z = static_cast<int16_t>(record[8] | record[9] << 8);
+        sample.sensor = static_cast<SensorId>(record[10]);
+        return true;
+    }
+
+    // The first call starts the replay clock. Stamps must come in order.
+    TimePoint dueTime(uint32_t stamp)
+    {
+        const uint64_t ticks = time_.extend(stamp);
+        if (!started_) {
+            start_ = std::chrono::steady_clock::now();
+            origin_ = ticks;
+            started_ = true;
+        }
+        const std::chrono::duration<double> offset(time_.seconds<double>(ticks - origin_));
+        return start_ + std::chrono::duration_cast<std::chrono::steady_clock::duration>(offset);
+    }
+
+    void close()
+    {
+        if (file_ != nullptr) {
+            std::fclose(file_);
+            file_ = nullptr;
+        }
+        hasNext_ = false;
+    }
+
+    std::FILE* file_{nullptr};
+    CounterTime time_{1};
+    bool realTime_{false};
+    RawSample next_{};
+    bool hasNext_{false};
+    bool started_{false};
+    TimePoint start_{};
+    uint64_t origin_{0};
+};
+
+static_assert(IsSensor<ReplaySensor>::value, "ReplaySensor must implement the Sensor concept");
+
+}  // namespace mart
+
+#endif /* REPLAY_H */
@@ -0,0 +1,100 @@
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <atomic>
+#include <cstdint>
+
+namespace mart
+{
+
+/*
+Wait-free queue between exactly one producer and one consumer, e.g. a DMA
+completion interrupt and the filter task on target, or two threads on the
+host. Each side owns one index and only reads the other one, so no locks
+or read-modify-write instructions are needed: the indices are 32-bit
+atomics with acquire/release ordering, which the Cortex-M4 does with plain
+loads and stores plus a barrier.
+
+The indices run freely and wrap at 2^32, capacity must be a power of two.
+A full queue drops the new items and counts them in overflows().
+*/
+template <class T, uint32_t capacity>
+class RingBuffer
+{
+    static_assert(capacity > 0 && (capacity & (capacity - 1)) == 0,
+                  "capacity must be a power of two");
+
+public:
+    // Producer side
+    bool push(const T& item)
+    {
+        return push(&item, 1) == 1;
+    }
+
+    // Pushes as many of the items as fit and returns how many
+    uint32_t push(const T* items, uint32_t count)
+    {
+        const uint32_t head = head_.load(std::memory_order_relaxed);
+        const uint32_t tail = tail_.load(std::memory_order_acquire);
+        const uint32_t space = capacity - (head - tail);
+        const uint32_t pushed = count < space ? count : space;
+
+        for (uint32_t i = 0; i < pushed; ++i) {
+            items_[(head + i) & MASK] = items[i];
+        }
+        head_.store(head + pushed, std::memory_order_release);
+
+        if (pushed < count) {
+            // Only the producer writes the counter
+            overflows_.store(overflows_.load(std::memory_order_relaxed) + (count - pushed),
+                             std::memory_order_relaxed);
+        }
+        return pushed;
+    }
+
+    // Consumer side
+    bool pop(T& item)
+    {
+        return pop(&item, 1) == 1;
+    }
+
+    // Pops up to maxCount items, oldest first, and returns how many
+    uint32_t pop(T* items, uint32_t maxCount)
+    {
+        const uint32_t tail = tail_.load(std::memory_order_relaxed);
+        const uint32_t head = head_.load(std::memory_order_acquire);
+        const uint32_t available = head - tail;
+        const uint32_t popped = maxCount < available ? maxCount : available;
+
+        for (uint32_t i = 0; i < popped; ++i) {
+            items[i] = items_[(tail + i) & MASK];
+        }
+        tail_.store(tail + popped, std::memory_order_release);
+        return popped;
+    }
+
+    // Either side, a snapshot that may be stale by the time it is used
+    uint32_t size() const
+    {
+        return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+    }
+
+    bool empty() const { return size() == 0; }
+
+    // Items dropped because the queue was full
+    uint32_t overflows() const { return overflows_.load(std::memory_order_relaxed); }
+
+    static constexpr uint32_t CAPACITY = capacity;
+
+private:
+    static constexpr uint32_t MASK = capacity - 1;
+
+    T items_[capacity];
+    std::atomic<uint32_t> head_{0};
+    std::atomic<uint32_t> tail_{0};
+    std::atomic<uint32_t> overflows_{0};
+};
+
+}  // namespace mart
+
+#endif /* RINGBUFFER_H */
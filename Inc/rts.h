@@ -0,0 +1,217 @@
+#ifndef RTS_H
+#define RTS_H
+
+#include "smoother.h"
+#include <cstddef>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <type_traits>
+#include <unistd.h>
+#include <vector>
+
+namespace mart
+{
+
+/*
+Append-only log of trivially copyable records for host tooling. The first
+ramCapacity records are kept in memory, the rest is streamed to a spill
+file which is memory mapped for reading, so the resident size stays bounded
+no matter how long the log is.
+*/
+template <class Record>
+class SpillBuffer
+{
+    static_assert(std::is_trivially_copyable<Record>::value,
+                  "records are written to the spill file byte by byte");
+
+public:
+    SpillBuffer(std::size_t ramCapacity, std::string spillPath)
+        : ramCapacity_(ramCapacity), spillPath_(std::move(spillPath))
+    {
+        ram_.reserve(ramCapacity_);
+    }
+
+    ~SpillBuffer()
+    {
+        unmap();
+        if (fd_ >= 0) {
+            ::close(fd_);
+            ::unlink(spillPath_.c_str());
+        }
+    }
+
+    SpillBuffer(const SpillBuffer&) = delete;
+    SpillBuffer& operator=(const SpillBuffer&) = delete;
+
+    std::size_t size() const { return ram_.size() + spilled_; }
+    std::size_t spilled() const { return spilled_; }
+
+    bool push(const Record& record)
+    {
+        if (ram_.size() < ramCapacity_) {
+            ram_.push_back(record);
+            return true;
+        }
+
+        if (fd_ < 0) {
+            fd_ = ::open(spillPath_.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+            if (fd_ < 0) {
+                return false;
+            }
+        }
+        unmap();
+
+        const char* bytes = reinterpret_cast<const char*>(&record);
+        std::size_t left  = sizeof(Record);
+        while (left > 0) {
+            const ssize_t written = ::write(fd_, bytes, left);
+            if (written <= 0) {
+                return false;
+            }
+            bytes += written;
+            left -= static_cast<std::size_t>(written);
+        }
+        ++spilled_;
+        return true;
+    }
+
+    // Records past the in-memory part are served from the mapped spill file,
+    // the returned pointer stays valid until the next push()
+    const Record* at(std::size_t index)
+    {
+        if (index < ram_.size()) {
+            return &ram_[index];
+        }
+        if (!map()) {
+            return nullptr;
+        }
+        return mapped_ + (index - ram_.size());
+    }
+
+private:
+    bool map()
+    {
+        if (mapped_ != nullptr) {
+            return true;
+        }
+        const std::size_t bytes = spilled_ * sizeof(Record);
+        void* addr = ::mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd_, 0);
+        if (addr == MAP_FAILED) {
+            return false;
+        }
+        // The backward pass walks the file from its end to its start,
+        // forward readahead would only fetch pages that were just used
+        ::madvise(addr, bytes, MADV_RANDOM);
+        mapped_ = static_cast<const Record*>(addr);
+        return true;
+    }
+
+    void unmap()
+    {
+        if (mapped_ != nullptr) {
+            ::munmap(const_cast<Record*>(mapped_), spilled_ * sizeof(Record));
+            mapped_ = nullptr;
+        }
+    }
+
+    const std::size_t ramCapacity_;
+    const std::string spillPath_;
+    std::vector<Record> ram_;
+    std::size_t spilled_{0};
+    int fd_{-1};
+    const Record* mapped_{nullptr};
+};
+
+/*
+Fixed-interval smoother for offline processing of recorded logs. record()
+is called after every filter update, smooth() then runs the RTS recursion
+in one sweep from the last step to the first one and hands each smoothed
+estimate to the callback fn(step, mu_s, Sigma_s).
+*/
+template <class Filter>
+class RtsSmoother
+{
+public:
+    using ValueType     = typename Filter::ValueType;
+    using State         = typename Filter::State;
+    using ProcessMatrix = typename Filter::ProcessMatrix;
+    using Step          = SmootherStep<ValueType, State::Size>;
+
+    RtsSmoother(std::size_t ramSteps, std::string spillPath)
+        : steps_(ramSteps, std::move(spillPath))
+    {
+    }
+
+    std::size_t size() const { return steps_.size(); }
+    std::size_t spilled() const { return steps_.spilled(); }
+
+    bool record(const Filter& filter, const typename Filter::Workspace& ws)
+    {
+        Step step;
+        step.store(filter, ws);
+        return steps_.push(step);
+    }
+
+    template <class Fn>
+    bool smooth(Fn&& fn)
+    {
+        if (steps_.size() == 0) {
+            return true;
+        }
+
+        AllocState mu, muPrioNext, muSmooth;
+        AllocProcessMatrix Sigma, SigmaPrioNext, FNext, G, SigmaSmooth;
+
+        std::size_t t = steps_.size() - 1;
+        const Step* step = steps_.at(t);
+        if (step == nullptr) {
+            return false;
+        }
+        load(*step, muSmooth, SigmaSmooth);
+        fn(t, static_cast<const State&>(muSmooth),
+           static_cast<const ProcessMatrix&>(SigmaSmooth));
+
+        while (t-- > 0) {
+            // Everything needed from step t + 1 is copied out before step t
+            // is fetched, since that may remap the spill file
+            for (uint16_t i = 0; i < stateSize; ++i) {
+                muPrioNext[i] = step->muPrio[i];
+            }
+            unpackSymmetric(step->SigmaPrio, SigmaPrioNext);
+            FNext = AllocProcessMatrix(step->F);
+
+            step = steps_.at(t);
+            if (step == nullptr) {
+                return false;
+            }
+            load(*step, mu, Sigma);
+
+            rtsGain(Sigma, FNext, SigmaPrioNext, G);
+            rtsMean(mu, G, muSmooth, muPrioNext, muSmooth);
+            rtsCovariance(Sigma, G, SigmaSmooth, SigmaPrioNext, SigmaSmooth);
+            fn(t, static_cast<const State&>(muSmooth),
+               static_cast<const ProcessMatrix&>(SigmaSmooth));
+        }
+        return true;
+    }
+
+private:
+    static constexpr uint16_t stateSize = State::Size;
+    using AllocState         = typename State::Alloc;
+    using AllocProcessMatrix = typename ProcessMatrix::Alloc;
+
+    static void load(const Step& step, AllocState& mu, AllocProcessMatrix& Sigma)
+    {
+        for (uint16_t i = 0; i < stateSize; ++i) {
+            mu[i] = step.muPost[i];
+        }
+        unpackSymmetric(step.SigmaPost, Sigma);
+    }
+
+    SpillBuffer<Step> steps_;
+};
+
+}  // namespace mart
+
+#endif /* RTS_H */
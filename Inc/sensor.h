@@ -0,0 +1,69 @@
+#ifndef SENSOR_H
+#define SENSOR_H
+
+#include "types.h"
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+namespace mart
+{
+
+/*
+What the acquisition code needs from a sensor, so that the drivers on
+target and the stand-ins on the host are interchangeable:
+
+    S::Config                               device settings
+    S::MAX_BURST                            most samples one read returns
+    bool configure(const S::Config&)        applies them, false on failure
+    uint8_t readBurst(RawSample*, uint8_t)  copies out what was acquired
+                                            since the previous call, oldest
+                                            first, without touching the bus
+
+Each sample carries the stamp of the sensor's clock and its SensorId, as a
+device may measure several quantities. IsSensor checks the shape at
+compile time.
+*/
+template <class S, class = void>
+struct IsSensor : std::false_type {};
+
+template <class S>
+struct IsSensor<
+    S,
+    std::void_t<typename S::Config,
+                decltype(S::MAX_BURST),
+                decltype(std::declval<S&>().configure(
+                    std::declval<const typename S::Config&>())),
+                decltype(std::declval<S&>().readBurst(std::declval<RawSample*>(),
+                                                      uint8_t()))>>
+    : std::integral_constant<
+          bool,
+          std::is_same<decltype(std::declval<S&>().configure(
+                           std::declval<const typename S::Config&>())),
+                       bool>::value &&
+              std::is_same<decltype(std::declval<S&>().readBurst(
+                               std::declval<RawSample*>(), uint8_t())),
+                           uint8_t>::value> {};
+
+// Reads bursts from sensor into sink(samples, count) until it has nothing
+// left, returns the number of samples passed on
+template <class S, class Sink>
+uint32_t drain(S& sensor, Sink&& sink)
+{
+    static_assert(IsSensor<S>::value, "S does not implement the Sensor concept");
+
+    RawSample samples[S::MAX_BURST];
+    uint32_t total = 0;
+    for (;;) {
+        const uint8_t count = sensor.readBurst(samples, S::MAX_BURST);
+        if (count == 0) {
+            return total;
+        }
+        sink(static_cast<const RawSample*>(samples), static_cast<uint32_t>(count));
+        total += count;
+    }
+}
+
+}  // namespace mart
+
+#endif /* SENSOR_H */
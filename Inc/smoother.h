@@ -0,0 +1,122 @@
+#ifndef SMOOTHER_H
+#define SMOOTHER_H
+
+#include "matrix.h"
+#include "vector.h"
+
+namespace mart
+{
+
+/*
+Rauch-Tung-Striebel recursion runs backwards over the filtered estimates:
+G_t = Sigma_t * F^T_{t+1} * Sigma_prio_{t+1}^{-1}
+mu_s_t = mu_t + G_t * (mu_s_{t+1} - mu_prio_{t+1})
+Sigma_s_t = Sigma_t + G_t * (Sigma_s_{t+1} - Sigma_prio_{t+1}) * G^T_t
+
+The recursion starts at the last step with mu_s = mu, Sigma_s = Sigma.
+*/
+
+// Covariances are symmetric, so only the upper triangle is kept
+template <uint16_t size>
+constexpr uint32_t packedSize()
+{
+    return static_cast<uint32_t>(size) * (size + 1) / 2;
+}
+
+template <class T, uint16_t size>
+void packSymmetric(const Matrix<T, size, size>& mat, T* packed)
+{
+    for (uint16_t row = 0; row < size; ++row) {
+        for (uint16_t col = row; col < size; ++col) {
+            *packed++ = mat(row, col);
+        }
+    }
+}
+
+template <class T, uint16_t size>
+void unpackSymmetric(const T* packed, Matrix<T, size, size>& mat)
+{
+    for (uint16_t row = 0; row < size; ++row) {
+        for (uint16_t col = row; col < size; ++col) {
+            mat(row, col) = *packed;
+            mat(col, row) = *packed;
+            ++packed;
+        }
+    }
+}
+
+// What the smoothers need to know about one filter step: the prediction,
+// the correction and the process Jacobian that led to the prediction
+template <class T, uint16_t stateSize>
+struct SmootherStep {
+    static constexpr uint32_t CovarianceSize = packedSize<stateSize>();
+
+    template <class Filter>
+    void store(const Filter& filter, const typename Filter::Workspace& ws)
+    {
+        for (uint16_t i = 0; i < stateSize; ++i) {
+            muPrio[i] = filter.priorState()[i];
+            muPost[i] = filter.state()[i];
+        }
+        packSymmetric(filter.priorCovariance(), SigmaPrio);
+        packSymmetric(filter.covariance(), SigmaPost);
+        const auto& jacobian = filter.processJacobian(ws);
+        for (uint16_t row = 0; row < stateSize; ++row) {
+            for (uint16_t col = 0; col < stateSize; ++col) {
+                F[row * stateSize + col] = jacobian(row, col);
+            }
+        }
+    }
+
+    T muPrio[stateSize];
+    T SigmaPrio[CovarianceSize];
+    T muPost[stateSize];
+    T SigmaPost[CovarianceSize];
+    T F[stateSize * stateSize];
+};
+
+template <class T, uint16_t size>
+void rtsGain(const Matrix<T, size, size>& Sigma,
+             const Matrix<T, size, size>& FNext,
+             const Matrix<T, size, size>& SigmaPrioNext,
+             Matrix<T, size, size>& G)
+{
+    const auto gain = Sigma * transposed(FNext) * SigmaPrioNext.inverse();
+    for (uint16_t row = 0; row < size; ++row) {
+        for (uint16_t col = 0; col < size; ++col) {
+            G(row, col) = gain(row, col);
+        }
+    }
+}
+
+template <class T, uint16_t size>
+void rtsMean(const Vector<T, size>& mu,
+             const Matrix<T, size, size>& G,
+             const Vector<T, size>& muSmoothNext,
+             const Vector<T, size>& muPrioNext,
+             Vector<T, size>& muSmooth)
+{
+    const auto correction = G * (muSmoothNext - muPrioNext);
+    for (uint16_t i = 0; i < size; ++i) {
+        muSmooth[i] = mu[i] + correction[i];
+    }
+}
+
+template <class T, uint16_t size>
+void rtsCovariance(const Matrix<T, size, size>& Sigma,
+                   const Matrix<T, size, size>& G,
+                   const Matrix<T, size, size>& SigmaSmoothNext,
+                   const Matrix<T, size, size>& SigmaPrioNext,
+                   Matrix<T, size, size>& SigmaSmooth)
+{
+    const auto correction = G * (SigmaSmoothNext - SigmaPrioNext) * transposed(G);
+    for (uint16_t row = 0; row < size; ++row) {
+        for (uint16_t col = 0; col < size; ++col) {
+            SigmaSmooth(row, col) = Sigma(row, col) + correction(row, col);
+        }
+    }
+}
+
+}  // namespace mart
+
+#endif /* SMOOTHER_H */
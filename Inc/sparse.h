@@ -0,0 +1,291 @@
+#ifndef SPARSE_H
+#define SPARSE_H
+
+#include "arena.h"
+#include "dynmatrix.h"
+#include <cstdint>
+
+namespace mart
+{
+
+/*
+Sparse matrices for measurement Jacobians in which every row touches only
+a few states. CooMatrix collects (row, col, value) triplets in any order,
+CsrMatrix is the compressed row form the products work on. Both take their
+storage from an Arena like DynMatrix. The dense operands are DynMatrix
+views, so fixed-size matrices take part through DynMatrix(mat).
+
+With nnz non-zeros in an m x n H and a dense n x n P:
+H * P      O(nnz * n)
+P * H^T    O(nnz * n)
+H * P * H^T O(nnz^2) for a symmetric P, independent of n
+Duplicate entries add up.
+*/
+
+template <class T>
+class CooMatrix
+{
+public:
+    CooMatrix() = default;
+
+    static CooMatrix<T> allocate(Arena& arena, uint16_t rows, uint16_t cols, uint32_t capacity)
+    {
+        CooMatrix<T> coo;
+        coo.rows_ = rows;
+        coo.cols_ = cols;
+        coo.rowIndex_ = arena.template allocate<uint16_t>(capacity);
+        coo.colIndex_ = arena.template allocate<uint16_t>(capacity);
+        coo.values_ = arena.template allocate<T>(capacity);
+        coo.capacity_ = coo.valid() ? capacity : 0;
+        return coo;
+    }
+
+    bool valid() const
+    {
+        return rowIndex_ != nullptr && colIndex_ != nullptr && values_ != nullptr;
+    }
+
+    // false when the capacity is exhausted or (row, col) is out of range
+    bool insert(uint16_t row, uint16_t col, T value)
+    {
+        if (size_ == capacity_ || row >= rows_ || col >= cols_) {
+            return false;
+        }
+        rowIndex_[size_] = row;
+        colIndex_[size_] = col;
+        values_[size_] = value;
+        ++size_;
+        return true;
+    }
+
+    void clear() { size_ = 0; }
+
+    uint16_t rows() const { return rows_; }
+    uint16_t cols() const { return cols_; }
+    uint32_t nonZeros() const { return size_; }
+
+    uint16_t rowIndex(uint32_t k) const { return rowIndex_[k]; }
+    uint16_t colIndex(uint32_t k) const { return colIndex_[k]; }
+    T value(uint32_t k) const { return values_[k]; }
+
+private:
+    uint16_t* rowIndex_{nullptr};
+    uint16_t* colIndex_{nullptr};
+    T* values_{nullptr};
+    uint16_t rows_{0};
+    uint16_t cols_{0};
+    uint32_t capacity_{0};
+    uint32_t size_{0};
+};
+
+template <class T>
+class CsrMatrix
+{
+public:
+    CsrMatrix() = default;
+
+    // Entries keep their insertion order within a row
+    static CsrMatrix<T> fromCoo(Arena& arena, const CooMatrix<T>& coo)
+    {
+        CsrMatrix<T> csr = allocate(arena, coo.rows(), coo.cols(), coo.nonZeros());
+        if (!csr.valid()) {
+            return csr;
+        }
+
+        for (uint32_t k = 0; k < coo.nonZeros(); ++k) {
+            ++csr.rowStart_[coo.rowIndex(k) + 1];
+        }
+        for (uint16_t row = 0; row < csr.rows_; ++row) {
+            csr.rowStart_[row + 1] += csr.rowStart_[row];
+        }
+        // rowStart_[row] serves as the insertion cursor of row and ends
+        // up at the start of row + 1, shifted back afterwards
+        for (uint32_t k = 0; k < coo.nonZeros(); ++k) {
+            const uint32_t at = csr.rowStart_[coo.rowIndex(k)]++;
+            csr.colIndex_[at] = coo.colIndex(k);
+            csr.values_[at] = coo.value(k);
+        }
+        for (uint16_t row = csr.rows_; row > 0; --row) {
+            csr.rowStart_[row] = csr.rowStart_[row - 1];
+        }
+        csr.rowStart_[0] = 0;
+        return csr;
+    }
+
+    // Keeps the elements that are not exactly zero
+    static CsrMatrix<T> fromDense(Arena& arena, const DynMatrix<T>& dense)
+    {
+        uint32_t nonZeros = 0;
+        for (uint16_t row = 0; row < dense.rows(); ++row) {
+            for (uint16_t col = 0; col < dense.cols(); ++col) {
+                nonZeros += dense(row, col) != 0 ? 1 : 0;
+            }
+        }
+
+        CsrMatrix<T> csr = allocate(arena, dense.rows(), dense.cols(), nonZeros);
+        if (!csr.valid()) {
+            return csr;
+        }
+        uint32_t k = 0;
+        for (uint16_t row = 0; row < dense.rows(); ++row) {
+            csr.rowStart_[row] = k;
+            for (uint16_t col = 0; col < dense.cols(); ++col) {
+                if (dense(row, col) != 0) {
+                    csr.colIndex_[k] = col;
+                    csr.values_[k] = dense(row, col);
+                    ++k;
+                }
+            }
+        }
+        csr.rowStart_[csr.rows_] = k;
+        return csr;
+    }
+
+    bool valid() const
+    {
+        return rowStart_ != nullptr && colIndex_ != nullptr && values_ != nullptr;
+    }
+
+    uint16_t rows() const { return rows_; }
+    uint16_t cols() const { return cols_; }
+    uint32_t nonZeros() const { return rowStart_[rows_]; }
+
+    // Entries rowBegin(row) .. rowEnd(row) - 1 belong to row
+    uint32_t rowBegin(uint16_t row) const { return rowStart_[row]; }
+    uint32_t rowEnd(uint16_t row) const { return rowStart_[row + 1]; }
+    uint16_t colIndex(uint32_t k) const { return colIndex_[k]; }
+    T value(uint32_t k) const { return values_[k]; }
+
+    // Element lookup, linear in the non-zeros of the row
+    T operator()(uint16_t row, uint16_t col) const
+    {
+        T sum = 0;
+        for (uint32_t k = rowBegin(row); k < rowEnd(row); ++k) {
+            if (colIndex_[k] == col) {
+                sum += values_[k];
+            }
+        }
+        return sum;
+    }
+
+private:
+    static CsrMatrix<T> allocate(Arena& arena, uint16_t rows, uint16_t cols, uint32_t nonZeros)
+    {
+        CsrMatrix<T> csr;
+        csr.rows_ = rows;
+        csr.cols_ = cols;
+        csr.rowStart_ = arena.template allocate<uint32_t>(rows + 1u);
+        // Keep valid() meaningful for an all-zero matrix
+        csr.colIndex_ = arena.template allocate<uint16_t>(nonZeros > 0 ? nonZeros : 1);
+        csr.values_ = arena.template allocate<T>(nonZeros > 0 ? nonZeros : 1);
+        return csr;
+    }
+
+    uint32_t* rowStart_{nullptr};
+    uint16_t* colIndex_{nullptr};
+    T* values_{nullptr};
+    uint16_t rows_{0};
+    uint16_t cols_{0};
+};
+
+// c = a * b
+template <class T>
+bool multiply(const CsrMatrix<T>& a, const DynMatrix<T>& b, DynMatrix<T>& c)
+{
+    if (a.cols() != b.rows() || c.rows() != a.rows() || c.cols() != b.cols()) {
+        return false;
+    }
+    for (uint16_t row = 0; row < a.rows(); ++row) {
+        for (uint16_t col = 0; col < c.cols(); ++col) {
+            c(row, col) = 0;
+        }
+        for (uint32_t k = a.rowBegin(row); k < a.rowEnd(row); ++k) {
+            const T v = a.value(k);
+            const uint16_t i = a.colIndex(k);
+            for (uint16_t col = 0; col < c.cols(); ++col) {
+                c(row, col) += v * b(i, col);
+            }
+        }
+    }
+    return true;
+}
+
+// y = a * x
+template <class T>
+bool multiply(const CsrMatrix<T>& a, const DynVector<T>& x, DynVector<T>& y)
+{
+    if (a.cols() != x.size() || y.size() != a.rows()) {
+        return false;
+    }
+    for (uint16_t row = 0; row < a.rows(); ++row) {
+        T sum = 0;
+        for (uint32_t k = a.rowBegin(row); k < a.rowEnd(row); ++k) {
+            sum += a.value(k) * x[a.colIndex(k)];
+        }
+        y[row] = sum;
+    }
+    return true;
+}
+
+// c = a * b^T, e.g. Sigma * H^T
+template <class T>
+bool multiplyTransposed(const DynMatrix<T>& a, const CsrMatrix<T>& b, DynMatrix<T>& c)
+{
+    if (a.cols() != b.cols() || c.rows() != a.rows() || c.cols() != b.rows()) {
+        return false;
+    }
+    for (uint16_t row = 0; row < a.rows(); ++row) {
+        for (uint16_t col = 0; col < b.rows(); ++col) {
+            T sum = 0;
+            for (uint32_t k = b.rowBegin(col); k < b.rowEnd(col); ++k) {
+                sum += a(row, b.colIndex(k)) * b.value(k);
+            }
+            c(row, col) = sum;
+        }
+    }
+    return true;
+}
+
+// out = h * p * h^T for a symmetric p, only the upper triangle is computed
+template <class T>
+bool sandwich(const CsrMatrix<T>& h, const DynMatrix<T>& p, DynMatrix<T>& out)
+{
+    if (p.rows() != h.cols() || p.cols() != h.cols() ||
+        out.rows() != h.rows() || out.cols() != h.rows()) {
+        return false;
+    }
+    for (uint16_t r = 0; r < h.rows(); ++r) {
+        for (uint16_t s = r; s < h.rows(); ++s) {
+            T sum = 0;
+            for (uint32_t k = h.rowBegin(r); k < h.rowEnd(r); ++k) {
+                T inner = 0;
+                for (uint32_t l = h.rowBegin(s); l < h.rowEnd(s); ++l) {
+                    inner += p(h.colIndex(k), h.colIndex(l)) * h.value(l);
+                }
+                sum += h.value(k) * inner;
+            }
+            out(r, s) = sum;
+            out(s, r) = sum;
+        }
+    }
+    return true;
+}
+
+template <class T>
+bool toDense(const CsrMatrix<T>& a, DynMatrix<T>& dense)
+{
+    if (dense.rows() != a.rows() || dense.cols() != a.cols()) {
+        return false;
+    }
+    dense.fill(0);
+    for (uint16_t row = 0; row < a.rows(); ++row) {
+        for (uint32_t k = a.rowBegin(row); k < a.rowEnd(row); ++k) {
+            dense(row, a.colIndex(k)) += a.value(k);
+        }
+    }
+    return true;
+}
+
+}  // namespace mart
+
+#endif /* SPARSE_H */
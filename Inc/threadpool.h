@@ -0,0 +1,224 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mart
+{
+
+/*
+Fixed set of worker threads for host builds (std::thread is not available
+on target). parallelFor() splits the indices into one contiguous range per
+thread, the calling thread included, so neighbouring indices (e.g. adjacent
+matrix tiles) tend to run on the same core. A thread works its own range
+from the front and, once that is empty, steals single indices from the back
+of the others, which keeps uneven tasks balanced. parallelFor() returns only
+when every index has been processed.
+*/
+class ThreadPool
+{
+public:
+    explicit ThreadPool(unsigned numWorkers = defaultWorkers())
+        : ranges_(numWorkers + 1)
+    {
+        for (unsigned i = 0; i < numWorkers; ++i) {
+            workers_.emplace_back([this, i] { workerLoop(i); });
+        }
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (auto& worker : workers_) {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned size() const { return static_cast<unsigned>(workers_.size()); }
+
+    template <class Fn>
+    void parallelFor(uint32_t count, Fn&& fn)
+    {
+        if (workers_.empty() || count < 2) {
+            for (uint32_t i = 0; i < count; ++i) {
+                fn(i);
+            }
+            return;
+        }
+
+        const uint32_t participants = static_cast<uint32_t>(ranges_.size());
+        for (uint32_t t = 0; t < participants; ++t) {
+            const uint64_t begin = static_cast<uint64_t>(count) * t / participants;
+            const uint64_t end = static_cast<uint64_t>(count) * (t + 1) / participants;
+            ranges_[t].span.store(pack(begin, end), std::memory_order_relaxed);
+        }
+
+        Job job{[&fn](uint32_t i) { fn(i); }, count};
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            job_ = &job;
+            ++generation_;
+        }
+        wake_.notify_all();
+
+        run(job, participants - 1);
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [&] { return job.pending == 0 && active_ == 0; });
+        job_ = nullptr;
+    }
+
+    static unsigned defaultWorkers()
+    {
+        const unsigned cores = std::thread::hardware_concurrency();
+        return cores > 1 ? cores - 1 : 0;
+    }
+
+private:
+    struct Job {
+        std::function<void(uint32_t)> fn;
+        uint32_t count;
+        std::atomic<uint32_t> pending{count};
+    };
+
+    // [begin, end) of the indices left to a thread, packed so that the
+    // owner and a thief can both claim an index with one compare-exchange
+    struct alignas(64) Range {
+        std::atomic<uint64_t> span{0};
+    };
+
+    static uint64_t pack(uint64_t begin, uint64_t end) { return begin << 32 | end; }
+
+    bool takeFront(uint32_t self, uint32_t& index)
+    {
+        uint64_t span = ranges_[self].span.load(std::memory_order_relaxed);
+        for (;;) {
+            const uint32_t begin = static_cast<uint32_t>(span >> 32);
+            const uint32_t end = static_cast<uint32_t>(span);
+            if (begin >= end) {
+                return false;
+            }
+            if (ranges_[self].span.compare_exchange_weak(span, pack(begin + 1, end))) {
+                index = begin;
+                return true;
+            }
+        }
+    }
+
+    bool stealBack(uint32_t self, uint32_t& index)
+    {
+        const uint32_t participants = static_cast<uint32_t>(ranges_.size());
+        for (uint32_t k = 1; k < participants; ++k) {
+            Range& victim = ranges_[(self + k) % participants];
+            uint64_t span = victim.span.load(std::memory_order_relaxed);
+            for (;;) {
+                const uint32_t begin = static_cast<uint32_t>(span >> 32);
+                const uint32_t end = static_cast<uint32_t>(span);
+                if (begin >= end) {
+                    break;
+                }
+                if (victim.span.compare_exchange_weak(span, pack(begin, end - 1))) {
+                    index = end - 1;
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    void run(Job& job, uint32_t self)
+    {
+        uint32_t i = 0;
+        while (takeFront(self, i) || stealBack(self, i)) {
+            job.fn(i);
+            if (--job.pending == 0) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                done_.notify_all();
+            }
+        }
+    }
+
+    void workerLoop(uint32_t self)
+    {
+        uint64_t seen = 0;
+        for (;;) {
+            Job* job = nullptr;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+                if (stop_) {
+                    return;
+                }
+                seen = generation_;
+                job  = job_;
+                if (job == nullptr) {
+                    continue;
+                }
+                ++active_;
+            }
+
+            run(*job, self);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                --active_;
+            }
+            done_.notify_all();
+        }
+    }
+
+    std::vector<Range> ranges_;
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    Job* job_{nullptr};
+    uint64_t generation_{0};
+    unsigned active_{0};
+    bool stop_{false};
+};
+
+/*
+Execution policy for InteractingMultipleModel on the host: every task gets a
+workspace of its own so that the models can be stepped concurrently.
+*/
+template <class Workspace, uint16_t numTasks>
+class ParallelExecution
+{
+public:
+    explicit ParallelExecution(
+        unsigned numWorkers = std::min(ThreadPool::defaultWorkers(),
+                                       static_cast<unsigned>(numTasks - 1)))
+        : pool_(numWorkers)
+    {
+    }
+
+    template <class Fn>
+    void forEach(Fn&& fn)
+    {
+        pool_.parallelFor(numTasks,
+                          [&](uint32_t i) { fn(static_cast<uint16_t>(i), workspaces_[i]); });
+    }
+
+private:
+    ThreadPool pool_;
+    Workspace workspaces_[numTasks];
+};
+
+}  // namespace mart
+
+#endif /* THREADPOOL_H */
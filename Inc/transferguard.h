@@ -0,0 +1,150 @@
+#ifndef TRANSFERGUARD_H
+#define TRANSFERGUARD_H
+
+#include <cstdint>
+
+namespace mart
+{
+
+// Brings a hung bus back, e.g. clocks SCL until the slave lets go of SDA and
+// re-initialises the peripheral. Runs in task context and must take a
+// bounded time.
+using BusRecovery = void (*)();
+
+// Transfer counters of one device, latencies in ticks of its Clock from
+// the start of an asynchronous read to its completion
+struct BusStats {
+    uint32_t transfers{0};
+    uint32_t errors{0};  // failed starts, error callbacks, timeouts and
+                         // failed blocking transfers
+    uint32_t timeouts{0};
+    uint32_t recoveries{0};
+    uint32_t lastLatency{0};
+    uint32_t maxLatency{0};
+};
+
+/*
+Failure handling of the asynchronous transfers of one device. A transfer
+that fails to start, reports an error or is in flight for longer than
+timeoutTicks stops the acquisition: the driver's interrupt handlers leave
+a failed() device alone, so nothing races the recovery. The driver's
+service(), called regularly from a task, passes the time on to expire()
+and service() here. Once retryTicks have passed, doubled with every
+further failure in a row up to 2^MAX_BACKOFF_SHIFT times, the bus is
+recovered and the driver restarts. A dead device thus costs an occasional
+recovery instead of a busy bus, and neither the interrupts nor the task
+ever wait on it.
+
+Intervals are taken modulo 2^32 like CounterTime. Except for service(),
+the caller serialises the calls with the interrupts.
+*/
+class TransferGuard
+{
+public:
+    static constexpr uint8_t MAX_BACKOFF_SHIFT = 4;
+
+    // timeoutTicks 0 disables the timeout, recoverBus may be nullptr
+    void configure(uint32_t timeoutTicks, uint32_t retryTicks, BusRecovery recoverBus)
+    {
+        timeoutTicks_ = timeoutTicks;
+        retryTicks_ = retryTicks;
+        recoverBus_ = recoverBus;
+        consecutiveFailures_ = 0;
+        failed_ = false;
+    }
+
+    void start(uint32_t now) { startedAt_ = now; }
+
+    void complete(uint32_t now)
+    {
+        stats_.lastLatency = now - startedAt_;
+        if (stats_.lastLatency > stats_.maxLatency) {
+            stats_.maxLatency = stats_.lastLatency;
+        }
+        ++stats_.transfers;
+        consecutiveFailures_ = 0;
+    }
+
+    // Counts the error and schedules the retry
+    void fail(uint32_t now)
+    {
+        failed_ = true;
+        ++stats_.errors;
+        const uint8_t shift = consecutiveFailures_ < MAX_BACKOFF_SHIFT ? consecutiveFailures_
+                                                                       : MAX_BACKOFF_SHIFT;
+        retryAt_ = now + (retryTicks_ << shift);
+        if (consecutiveFailures_ < MAX_BACKOFF_SHIFT) {
+            ++consecutiveFailures_;
+        }
+    }
+
+    bool overdue(uint32_t now) const
+    {
+        return timeoutTicks_ != 0 && now - startedAt_ > timeoutTicks_;
+    }
+
+    // Whether a driver stopping its acquisition should still wait for the
+    // transfer in flight: until its timeout, and not at all without one
+    bool withinTimeout(uint32_t now) const
+    {
+        return timeoutTicks_ != 0 && !overdue(now);
+    }
+
+    bool failed() const { return failed_; }
+
+    // With the interrupts disabled: true when the transfer in flight is
+    // overdue, it then counts as failed and the driver abandons it, so a
+    // late completion is ignored
+    bool expire(uint32_t now, bool inFlight)
+    {
+        if (!inFlight || !overdue(now)) {
+            return false;
+        }
+        ++stats_.timeouts;
+        fail(now);
+        return true;
+    }
+
+    bool retryDue(uint32_t now) const { return static_cast<int32_t>(now - retryAt_) >= 0; }
+
+    // Task context, with the interrupts enabled: true once the retry of a
+    // failure is due and the bus has been recovered, the driver then
+    // restarts its acquisition
+    bool service(uint32_t now)
+    {
+        if (!failed_ || !retryDue(now)) {
+            return false;
+        }
+        recover();
+        failed_ = false;
+        return true;
+    }
+
+    // Runs the recovery hook, if there is one
+    void recover()
+    {
+        if (recoverBus_ != nullptr) {
+            recoverBus_();
+            ++stats_.recoveries;
+        }
+    }
+
+    // A blocking transfer failed, nothing is scheduled
+    void countError() { ++stats_.errors; }
+
+    const BusStats& stats() const { return stats_; }
+
+private:
+    BusStats stats_{};
+    uint32_t timeoutTicks_{0};
+    uint32_t retryTicks_{0};
+    uint32_t startedAt_{0};
+    uint32_t retryAt_{0};
+    BusRecovery recoverBus_{nullptr};
+    uint8_t consecutiveFailures_{0};
+    volatile bool failed_{false};
+};
+
+}  // namespace mart
+
+#endif /* TRANSFERGUARD_H */
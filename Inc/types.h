@@ -9,4 +9,17 @@ struct Vector3 {
     int16_t z;
 };
 
+enum class SensorId : uint8_t {
+    GYROSCOPE,
+    ACCELEROMETER,
+    MAGNETOMETER
+};
+
+// A raw sensor reading and the time it was taken at
+struct RawSample {
+    uint32_t timestamp;
+    Vector3 value;
+    SensorId sensor;
+};
+
 #endif /* TYPES_H */
@@ -0,0 +1,116 @@
+#ifndef VANLOAN_H
+#define VANLOAN_H
+
+#include "matrix.h"
+#include <cmath>
+
+namespace mart
+{
+
+/*
+Exact discretisation of a linear continuous-time model
+dx/dt = A * x + G * w, w white noise with spectral density Q_c
+
+over a step dt (Van Loan, 1978). With
+
+    M = | -A  G*Q_c*G^T | * dt        e^M = | .  E12 |
+        |  0  A^T       |                   | 0  E22 |
+
+the transition matrix and the discrete process noise are
+Phi = E22^T
+Q_d = Phi * E12
+
+Unlike the first-order Euler step x + A * x * dt this stays accurate for
+long steps, so a model can be propagated at a lower rate.
+*/
+template <class T, uint16_t n>
+void vanLoan(const Matrix<T, n, n>& A,
+             const Matrix<T, n, n>& GQcGT,
+             T dt,
+             Matrix<T, n, n>& Phi,
+             Matrix<T, n, n>& Qd)
+{
+    alloc::Matrix<T, 2 * n, 2 * n> M;
+    for (uint16_t row = 0; row < n; ++row) {
+        for (uint16_t col = 0; col < n; ++col) {
+            M(row, col)         = -A(row, col) * dt;
+            M(row, n + col)     = GQcGT(row, col) * dt;
+            M(n + row, n + col) = A(col, row) * dt;
+        }
+    }
+
+    const auto E = M.expm();
+    for (uint16_t row = 0; row < n; ++row) {
+        for (uint16_t col = 0; col < n; ++col) {
+            Phi(row, col) = E(n + col, n + row);
+        }
+    }
+
+    alloc::Matrix<T, n, n> E12;
+    for (uint16_t row = 0; row < n; ++row) {
+        for (uint16_t col = 0; col < n; ++col) {
+            E12(row, col) = E(row, n + col);
+        }
+    }
+    kernel::multiply<T, n, n, n>(Phi.raw(), Phi.stride(), E12.raw(), E12.stride(),
+                                 Qd.raw(), Qd.stride());
+}
+
+/*
+(Phi, Q_d) of a time-invariant model for the last few step lengths seen.
+At a fixed sample rate there is one dt, so the matrix exponential is
+computed once and every later step is a lookup. Steps within tolerance of a
+cached dt reuse its entry, which absorbs timestamp jitter. On a miss the
+oldest entry is replaced.
+*/
+template <class T, uint16_t n, uint16_t entries = 1>
+class VanLoanCache
+{
+public:
+    struct Entry {
+        T dt;
+        alloc::Matrix<T, n, n> Phi;
+        alloc::Matrix<T, n, n> Qd;
+    };
+
+    VanLoanCache(const Matrix<T, n, n>& A, const Matrix<T, n, n>& GQcGT, T tolerance = 0)
+        : A_(A), GQcGT_(GQcGT), tolerance_(tolerance)
+    {
+    }
+
+    const Entry& operator()(T dt)
+    {
+        for (uint16_t i = 0; i < count_; ++i) {
+            if (std::abs(entries_[i].dt - dt) <= tolerance_) {
+                return entries_[i];
+            }
+        }
+
+        Entry& e = entries_[next_];
+        next_ = (next_ + 1) % entries;
+        if (count_ < entries) {
+            ++count_;
+        }
+        e.dt = dt;
+        ++misses_;
+        vanLoan(A_, GQcGT_, dt, e.Phi, e.Qd);
+        return e;
+    }
+
+    // Number of times (Phi, Q_d) had to be computed
+    uint32_t misses() const { return misses_; }
+
+private:
+    const alloc::Matrix<T, n, n> A_;
+    const alloc::Matrix<T, n, n> GQcGT_;
+    const T tolerance_;
+
+    Entry entries_[entries];
+    uint16_t next_{0};
+    uint16_t count_{0};
+    uint32_t misses_{0};
+};
+
+}  // namespace mart
+
+#endif /* VANLOAN_H */
@@ -2,6 +2,7 @@
 #define VECTOR_H
 
 #include <algorithm>
+#include <cmath>
 #include <cstdint>
 #include <initializer_list>
 
@@ -24,7 +25,14 @@ public:
 
     Vector() = default;
 
-    explicit Vector(T* data);
+    // stride is the distance between two consecutive elements, so a view
+    // can also walk a matrix column or diagonal in place
+    explicit Vector(T* data, uint16_t stride = 1);
+
+    const T* raw() const { return d_; }
+    T* raw() { return d_; }
+
+    uint16_t stride() const { return stride_; }
 
     T& operator[](uint16_t i);
 
@@ -34,6 +42,10 @@ public:
 
     Vector<T, size>& operator+=(const Vector<T, size>& rhs);
 
+    alloc::Vector<T, size> operator-(const Vector<T, size>& rhs) const;
+
+    Vector<T, size>& operator-=(const Vector<T, size>& rhs);
+
     alloc::Vector<T, size> operator*(T multiplier) const;
 
     Vector<T, size>& operator*=(T multiplier);
@@ -41,6 +53,11 @@ public:
     template <uint16_t subSize>
     Vector<T, subSize> subvec(uint16_t from) const;
 
+    // View of the index-th of the consecutive blocks of blockSize elements,
+    // the offset is known at compile time so nothing is set up at runtime
+    template <uint16_t index, uint16_t blockSize>
+    Vector<T, blockSize> block() const;
+
     template <uint16_t subSize>
     alloc::Vector<Vector<T, subSize>, size / subSize> partition();
 
@@ -48,7 +65,12 @@ public:
     const alloc::Vector<Vector<T, subSize>, size / subSize> partition() const;
 
 private:
+    T& at(uint16_t i) { return d_[i * stride_]; }
+
+    T at(uint16_t i) const { return d_[i * stride_]; }
+
     T* d_{nullptr};
+    uint16_t stride_{1};
 };
 
 namespace alloc
@@ -67,11 +89,28 @@ public:
 
     Vector(const Vector<T, size>& other) : Vector(other.data_) {}
 
+    Vector(const ::mart::Vector<T, size>& other) : Vector() { *this = other; }
+
     Vector(std::initializer_list<T> il) : Vector()
     {
         std::copy(il.begin(), il.end(), data_);
     }
 
+    // Assignment copies the elements, the view must keep pointing to data_
+    Vector<T, size>& operator=(const Vector<T, size>& other)
+    {
+        std::copy(other.data_, other.data_ + size, data_);
+        return *this;
+    }
+
+    Vector<T, size>& operator=(const ::mart::Vector<T, size>& other)
+    {
+        for (uint16_t i = 0; i < size; ++i) {
+            data_[i] = other[i];
+        }
+        return *this;
+    }
+
 private:
     T data_[size]{};
 };
@@ -79,20 +118,20 @@ private:
 }  // namespace alloc
 
 template <typename T, uint16_t size>
-Vector<T, size>::Vector(T* data) : d_(data)
+Vector<T, size>::Vector(T* data, uint16_t stride) : d_(data), stride_(stride)
 {
 }
 
 template <typename T, uint16_t size>
 T& Vector<T, size>::operator[](uint16_t i)
 {
-    return d_[i];
+    return at(i);
 }
 
 template <typename T, uint16_t size>
 T Vector<T, size>::operator[](uint16_t i) const
 {
-    return d_[i];
+    return at(i);
 }
 
 template <typename T, uint16_t size>
@@ -101,7 +140,7 @@ alloc::Vector<T, size> Vector<T, size>::operator+(
 {
     alloc::Vector<T, size> result;
     for (uint16_t i = 0; i < size; ++i) {
-        result[i] = d_[i] + rhs[i];
+        result[i] = at(i) + rhs[i];
     }
     return result;
 }
@@ -110,7 +149,27 @@ template <typename T, uint16_t size>
 Vector<T, size>& Vector<T, size>::operator+=(const Vector<T, size>& rhs)
 {
     for (uint16_t i = 0; i < size; ++i) {
-        d_[i] += rhs[i];
+        at(i) += rhs[i];
+    }
+    return *this;
+}
+
+template <typename T, uint16_t size>
+alloc::Vector<T, size> Vector<T, size>::operator-(
+    const Vector<T, size>& rhs) const
+{
+    alloc::Vector<T, size> result;
+    for (uint16_t i = 0; i < size; ++i) {
+        result[i] = at(i) - rhs[i];
+    }
+    return result;
+}
+
+template <typename T, uint16_t size>
+Vector<T, size>& Vector<T, size>::operator-=(const Vector<T, size>& rhs)
+{
+    for (uint16_t i = 0; i < size; ++i) {
+        at(i) -= rhs[i];
     }
     return *this;
 }
@@ -120,7 +179,7 @@ alloc::Vector<T, size> Vector<T, size>::operator*(T multiplier) const
 {
     alloc::Vector<T, size> result;
     for (uint16_t i = 0; i < size; ++i) {
-        result[i] = d_[i] * multiplier;
+        result[i] = at(i) * multiplier;
     }
     return result;
 }
@@ -129,7 +188,7 @@ template <typename T, uint16_t size>
 Vector<T, size>& Vector<T, size>::operator*=(T multiplier)
 {
     for (uint16_t i = 0; i < size; ++i) {
-        d_[i] *= multiplier;
+        at(i) *= multiplier;
     }
     return *this;
 }
@@ -138,7 +197,15 @@ template <typename T, uint16_t size>
 template <uint16_t subSize>
 Vector<T, subSize> Vector<T, size>::subvec(uint16_t from) const
 {
-    return Vector<T, subSize>(d_ + from);
+    return Vector<T, subSize>(d_ + from * stride_, stride_);
+}
+
+template <typename T, uint16_t size>
+template <uint16_t index, uint16_t blockSize>
+Vector<T, blockSize> Vector<T, size>::block() const
+{
+    static_assert((index + 1) * blockSize <= size, "block out of range");
+    return Vector<T, blockSize>(d_ + index * blockSize * stride_, stride_);
 }
 
 template <typename T, uint16_t size>
@@ -163,6 +230,95 @@ const alloc::Vector<Vector<T, subSize>, size / subSize> Vector<T, size>::partiti
     return p;
 }
 
+
+/*
+3D vector algebra used by the orientation model. A rotation by a small angle
+w acts on a vector as the skew-symmetric matrix
+
+    [w]x = |  0   -w_z  w_y |
+           |  w_z  0   -w_x |
+           | -w_y  w_x  0   |
+
+and [w]x * v = w x v, so the matrix never has to be stored: Skew keeps a
+copy of the three elements of w (and a scale) and computes its products or
+elements on demand. The copy makes skew(cross(a, b)) or Skew(a - b) safe,
+a view would point into the destroyed temporary.
+*/
+
+template <typename T, uint16_t size>
+T dot(const Vector<T, size>& a, const Vector<T, size>& b)
+{
+    T result = 0;
+    for (uint16_t i = 0; i < size; ++i) {
+        result += a[i] * b[i];
+    }
+    return result;
+}
+
+template <typename T, uint16_t size>
+T norm(const Vector<T, size>& a)
+{
+    return std::sqrt(dot(a, a));
+}
+
+// out may alias a or b
+template <typename T>
+void cross(const Vector<T, 3>& a, const Vector<T, 3>& b, Vector<T, 3>& out)
+{
+    const T x = a[1] * b[2] - a[2] * b[1];
+    const T y = a[2] * b[0] - a[0] * b[2];
+    const T z = a[0] * b[1] - a[1] * b[0];
+    out[0] = x;
+    out[1] = y;
+    out[2] = z;
+}
+
+template <typename T>
+alloc::Vector<T, 3> cross(const Vector<T, 3>& a, const Vector<T, 3>& b)
+{
+    alloc::Vector<T, 3> result;
+    cross(a, b, result);
+    return result;
+}
+
+template <typename T>
+class Skew
+{
+public:
+    explicit Skew(const Vector<T, 3>& w, T scale = 1) : w_(w), scale_(scale) {}
+
+    T operator()(uint16_t row, uint16_t col) const
+    {
+        // Off-diagonal (row, col) holds +-w_k with k the remaining axis,
+        // the sign is - when col follows row cyclically
+        if (row == col) {
+            return 0;
+        }
+        const uint16_t k = 3 - row - col;
+        return (col == (row + 1) % 3 ? -w_[k] : w_[k]) * scale_;
+    }
+
+    Skew<T> operator*(T mul) const { return Skew<T>(w_, scale_ * mul); }
+
+    alloc::Vector<T, 3> operator*(const Vector<T, 3>& v) const
+    {
+        alloc::Vector<T, 3> result;
+        cross(w_, v, result);
+        result *= scale_;
+        return result;
+    }
+
+private:
+    const alloc::Vector<T, 3> w_;
+    const T scale_;
+};
+
+template <typename T>
+Skew<T> skew(const Vector<T, 3>& w)
+{
+    return Skew<T>(w);
+}
+
 }  // namespace mart
 
 #endif /* VECTOR_H */
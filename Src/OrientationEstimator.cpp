@@ -12,95 +12,189 @@ using State             = typename OrientationEstimator::EKF::State;
 using ProcessMatrix     = typename OrientationEstimator::EKF::ProcessMatrix;
 using Measurement       = typename OrientationEstimator::EKF::Measurement;
 using MeasurementMatrix = typename OrientationEstimator::EKF::MeasurementMatrix;
-
-const auto I = alloc::Matrix<float, VEC_SIZE, VEC_SIZE>::eye();
-const alloc::Matrix<float, VEC_SIZE, VEC_SIZE> O;
+using InnovationMatrix  = typename OrientationEstimator::EKF::InnovationMatrix;
 
 enum StateIndex { Omega, OmegaDot, G, M };
 enum VecIndex { X, Y, Z };
 
+// Variances per 3-vector, in rad/s, rad/s^2, g and gauss. The accelerometer
+// also sees linear acceleration, so g is trusted less than the other sensors.
+constexpr float PROCESS_NOISE[] = {1e-4f, 1e-2f, 1e-5f, 1e-5f};
+constexpr float MEASUREMENT_NOISE[] = {1e-4f, 1e-3f, 1e-4f};
+constexpr float INITIAL_VARIANCE[] = {1.0f, 1.0f, 1.0f, 1.0f};
+
+template <class Alloc, uint16_t count>
+Alloc blockDiagonal(const float (&variances)[count])
+{
+    static_assert(Alloc::NumRows == count * VEC_SIZE, "one variance per 3-vector");
+    Alloc mat;
+    for (uint16_t i = 0; i < count * VEC_SIZE; ++i) {
+        mat(i, i) = variances[i / VEC_SIZE];
+    }
+    return mat;
+}
+
+// Views of the 3-vectors and 3x3 blocks at offsets fixed at compile time
+template <uint16_t index, class T, uint16_t size>
+Vector<T, VEC_SIZE> block(const Vector<T, size>& vec)
+{
+    return vec.template block<index, VEC_SIZE>();
+}
+
+template <uint16_t row, uint16_t col, class T, uint16_t nrows, uint16_t ncols>
+Matrix<T, VEC_SIZE, VEC_SIZE> block(Matrix<T, nrows, ncols>& mat)
+{
+    return mat.template block<row, col, VEC_SIZE, VEC_SIZE>();
+}
+
+// Writes the 3x3 block c * I + rot, rot being a (scaled) skew matrix
+template <class T>
+void setRotationBlock(Matrix<T, VEC_SIZE, VEC_SIZE> block,
+                      T c,
+                      const Skew<T>& rot)
+{
+    for (uint16_t row = 0; row < VEC_SIZE; ++row) {
+        for (uint16_t col = 0; col < VEC_SIZE; ++col) {
+            block(row, col) = (row == col ? c : 0) + rot(row, col);
+        }
+    }
+}
+
 template <class T>
-::mart::alloc::Matrix<T, VEC_SIZE, VEC_SIZE> rotationMatrix(
-    const Vector<T, VEC_SIZE>& w)
-{
-    // clang-format off
-    return {
-        0, -w[Z], w[Y],
-        w[Z], 0, -w[X],
-        -w[Y], w[X], 0
-    };
-    // clang-format on
+void setDiagonalBlock(Matrix<T, VEC_SIZE, VEC_SIZE> block, T c)
+{
+    for (uint16_t row = 0; row < VEC_SIZE; ++row) {
+        for (uint16_t col = 0; col < VEC_SIZE; ++col) {
+            block(row, col) = row == col ? c : 0;
+        }
+    }
 }
 
 void process(State& nextState, const State& currentState, float dt)
 {
-    auto current = currentState.partition<VEC_SIZE>();
-    auto next    = nextState.partition<VEC_SIZE>();
+    const auto w    = block<Omega>(currentState);
+    const auto wDot = block<OmegaDot>(currentState);
+    const auto g    = block<G>(currentState);
+    const auto m    = block<M>(currentState);
+
+    auto nextW    = block<Omega>(nextState);
+    auto nextWDot = block<OmegaDot>(nextState);
+    auto nextG    = block<G>(nextState);
+    auto nextM    = block<M>(nextState);
+
+    // g and m rotate with the body: v' = v + (w x v) * dt
+    cross(w, g, nextG);
+    cross(w, m, nextM);
+    for (uint16_t i = 0; i < VEC_SIZE; ++i) {
+        nextW[i]    = w[i] + wDot[i] * dt;
+        nextWDot[i] = wDot[i];
+        nextG[i]    = g[i] + nextG[i] * dt;
+        nextM[i]    = m[i] + nextM[i] * dt;
+    }
+}
+
+// Blocks of the process Jacobian that depend on dt only, the filter calls
+// this when dt changes
+void getConstantJacobian(ProcessMatrix& J, float dt)
+{
+    setDiagonalBlock(block<Omega, Omega>(J), 1.0f);
+    setDiagonalBlock(block<Omega, OmegaDot>(J), dt);
+    setDiagonalBlock(block<Omega, G>(J), 0.0f);
+    setDiagonalBlock(block<Omega, M>(J), 0.0f);
 
-    next[Omega]    = current[Omega] + current[OmegaDot] * dt;
-    next[OmegaDot] = current[OmegaDot];
+    setDiagonalBlock(block<OmegaDot, Omega>(J), 0.0f);
+    setDiagonalBlock(block<OmegaDot, OmegaDot>(J), 1.0f);
+    setDiagonalBlock(block<OmegaDot, G>(J), 0.0f);
+    setDiagonalBlock(block<OmegaDot, M>(J), 0.0f);
 
-    const auto rotM = rotationMatrix(current[Omega]);
-    next[G]         = current[G] + rotM * current[G] * dt;
-    next[M]         = current[M] + rotM * current[M] * dt;
+    setDiagonalBlock(block<G, OmegaDot>(J), 0.0f);
+    setDiagonalBlock(block<G, M>(J), 0.0f);
+
+    setDiagonalBlock(block<M, OmegaDot>(J), 0.0f);
+    setDiagonalBlock(block<M, G>(J), 0.0f);
 }
 
+// The rotation blocks, refreshed every step
 void getProcessJacobian(const State& currentState,
-                        ProcessMatrix& jacobian,
+                        ProcessMatrix& J,
                         float dt)
 {
-    auto J       = jacobian.partition<VEC_SIZE, VEC_SIZE>();
-    auto current = currentState.partition<VEC_SIZE>();
-
-    const auto rotG = rotationMatrix(current[G]) * (-dt);
-    const auto rotM = rotationMatrix(current[M]) * (-dt);
-    const auto rotW = I + rotationMatrix(current[Omega]) * dt;
-
-    // clang-format off
-    J = std::initializer_list<Matrix<float, VEC_SIZE, VEC_SIZE>>{
-        I,    I * dt, O,    O,
-        O,    I,      O,    O,
-        rotG, 0,      rotW, 0,
-        rotM, 0,      0,    rotW
-    };
-    // clang-format on
+    // d(w x v)/dw = -[v]x, d(w x v)/dv = [w]x
+    const auto rotG = skew(block<G>(currentState)) * (-dt);
+    const auto rotM = skew(block<M>(currentState)) * (-dt);
+    const auto rotW = skew(block<Omega>(currentState)) * dt;
+
+    setRotationBlock(block<G, Omega>(J), 0.0f, rotG);
+    setRotationBlock(block<G, G>(J), 1.0f, rotW);
+    setRotationBlock(block<M, Omega>(J), 0.0f, rotM);
+    setRotationBlock(block<M, M>(J), 1.0f, rotW);
 }
 
-Measurement measurement(const State& state, float dt)
-{
-    typename Measurement::Alloc meas;
-    auto z = meas.partition<VEC_SIZE>();
-    auto x = state.partition<VEC_SIZE>();
+// z = (w, g, m) picks three of the four state vectors
+enum MeasIndex { MeasOmega, MeasG, MeasM };
 
-    z = {x[0], x[2], x[3]};
+void measurement(const State& state, Measurement& meas, float dt)
+{
+    const auto w = block<Omega>(state);
+    const auto g = block<G>(state);
+    const auto m = block<M>(state);
+
+    auto zW = block<MeasOmega>(meas);
+    auto zG = block<MeasG>(meas);
+    auto zM = block<MeasM>(meas);
+
+    for (uint16_t i = 0; i < VEC_SIZE; ++i) {
+        zW[i] = w[i];
+        zG[i] = g[i];
+        zM[i] = m[i];
+    }
+}
 
-    return meas;
+template <uint16_t row, uint16_t measured>
+void setMeasurementRow(MeasurementMatrix& J)
+{
+    setDiagonalBlock(block<row, Omega>(J), measured == Omega ? 1.0f : 0.0f);
+    setDiagonalBlock(block<row, OmegaDot>(J), measured == OmegaDot ? 1.0f : 0.0f);
+    setDiagonalBlock(block<row, G>(J), measured == G ? 1.0f : 0.0f);
+    setDiagonalBlock(block<row, M>(J), measured == M ? 1.0f : 0.0f);
 }
 
 void getMeasurementJacobian(const State& state,
-                            MeasurementMatrix& jacobian,
+                            MeasurementMatrix& J,
                             float dt)
 {
-    auto J       = jacobian.partition<VEC_SIZE, VEC_SIZE>();
-    // clang-format off
-    J = std::initializer_list<Matrix<float, VEC_SIZE, VEC_SIZE>>{
-        I, O, O, O,
-        O, O, I, O,
-        O, 0, O, I,
-    };
-    // clang-format on
+    setMeasurementRow<MeasOmega, Omega>(J);
+    setMeasurementRow<MeasG, G>(J);
+    setMeasurementRow<MeasM, M>(J);
 }
 
 }  // namespace
 
-OrientationEstimator::OrientationEstimator()
+OrientationEstimator::OrientationEstimator(uint32_t counterFrequency)
     : ekf_(&process,
+           &getConstantJacobian,
            &getProcessJacobian,
-           ProcessMatrix::Alloc(),
+           blockDiagonal<ProcessMatrix::Alloc>(PROCESS_NOISE),
            &measurement,
            &getMeasurementJacobian,
-           MeasurementMatrix::Alloc())
+           blockDiagonal<InnovationMatrix::Alloc>(MEASUREMENT_NOISE)),
+      time_(counterFrequency)
+{
+    reset();
+}
+
+void OrientationEstimator::reset()
+{
+    ekf_.reset(State::Alloc(), blockDiagonal<ProcessMatrix::Alloc>(INITIAL_VARIANCE));
+    started_ = false;
+}
+
+void OrientationEstimator::update(const EKF::Measurement& z, uint32_t timestamp)
 {
+    const float dt = started_ ? time_.secondsBetween<float>(lastTimestamp_, timestamp) : 0.0f;
+    ekf_.update(z, dt, workspace_);
+    started_ = true;
+    lastTimestamp_ = timestamp;
 }
 
 }  // namespace orient
@@ -21,7 +21,9 @@ CONSOLE_COMMAND_DEF(led, "Sets a LED No",
 
 CONSOLE_COMMAND_DEF(spi, "Read whoami of L3GD20");
 
-CONSOLE_COMMAND_DEF(i2c, "Read CTRL_REG_1_A of LSM303DLHC");
+CONSOLE_COMMAND_DEF(i2c, "Show CTRL_REG1_A and CRA_REG_M of LSM303DLHC");
+
+CONSOLE_COMMAND_DEF(bus, "Show error and latency counters of the sensor buses");
 
 
 static void Console_Write(const char* str)
@@ -42,6 +44,7 @@ void Console_Init()
     console_command_register(led);
     console_command_register(spi);
     console_command_register(i2c);
+    console_command_register(bus);
 }
 
 void Console_Printf(const char* format, ...)
@@ -94,11 +97,25 @@ static void spi_command_handler(const spi_args_t* args)
 
 static void i2c_command_handler(const i2c_args_t* args)
 {
-    lsm303dlhc.write(mart::Lsm303dlhc::AccRegister::CTRL_REG1_A, 0x57);
+    // Served from the register shadow filled by configure(), so the bus
+    // stays free for the DMA acquisition
     const uint8_t ctrl_reg1_a = lsm303dlhc.read(mart::Lsm303dlhc::AccRegister::CTRL_REG1_A);
     Console_Printf("ctrl_reg1_a=0x%X\n", ctrl_reg1_a);
 
-    lsm303dlhc.write(mart::Lsm303dlhc::MagRegister::CRA_REG_M, 0x18);
     const uint8_t cra_reg_m = lsm303dlhc.read(mart::Lsm303dlhc::MagRegister::CRA_REG_M);
     Console_Printf("cra_reg_m=0x%X\n", cra_reg_m);
 }
+
+static void printBusStats(const char* name, const mart::BusStats& stats)
+{
+    Console_Printf("%s: transfers=%lu, errors=%lu, timeouts=%lu, recoveries=%lu\n", name,
+                   stats.transfers, stats.errors, stats.timeouts, stats.recoveries);
+    Console_Printf("%s: latency=%lu, max=%lu cycles\n", name, stats.lastLatency,
+                   stats.maxLatency);
+}
+
+static void bus_command_handler(const bus_args_t* args)
+{
+    printBusStats("spi1", gyroscope.busStats());
+    printBusStats("i2c1", lsm303dlhc.busStats());
+}
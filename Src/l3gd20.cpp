@@ -1,68 +1,346 @@
 #include "l3gd20.h"
+#include <cstring>
 
 namespace mart
 {
 namespace
 {
-constexpr uint32_t defaultTimeout = 10;
+// HAL ticks are 1 ms, 2 waits at least one full tick
+constexpr uint32_t defaultTimeout = 2;
 constexpr uint8_t READ_MASK       = 0x80;
 constexpr uint8_t MULTI_MASK = 0x40;
+
+constexpr uint8_t FIFO_EN           = 0x40;  // CTRL_REG5
+constexpr uint8_t I2_WTM            = 0x04;  // CTRL_REG3
+constexpr uint8_t FIFO_MODE_SHIFT   = 5;     // FIFO_CTRL_REG
+constexpr uint8_t FIFO_WTM_MASK     = 0x1F;
+constexpr uint8_t FIFO_SRC_OVRN     = 0x40;  // FIFO_SRC_REG
+constexpr uint8_t FIFO_SRC_FSS_MASK = 0x1F;
+
+// CTRL_REG1..REFERENCE, FIFO_CTRL_REG, INT1_CFG and INT1_TSH_XH..INT1_DURATION
+constexpr uint32_t CACHEABLE_REGISTERS = 0x3Fu | 1u << 0xE | 1u << 0x10 | 0x7Fu << 0x12;
 }
 
+static_assert(IsSensor<L3GD20>::value, "L3GD20 must implement the Sensor concept");
+
 L3GD20::L3GD20(GPIO_TypeDef* csPort, uint16_t csPin, SPI_HandleTypeDef& hspi)
-    : csPort_(csPort), csPin_(csPin), hspi_(hspi)
+    : csPort_(csPort), csPin_(csPin), hspi_(hspi), shadow_(CACHEABLE_REGISTERS)
 {
 }
 
+bool L3GD20::configure(const Config& config)
+{
+    disableAsync();
+    guard_.configure(config.timeoutTicks, config.retryTicks, config.recoverBus);
+
+    const uint8_t fifoCtrl =
+        static_cast<uint8_t>(static_cast<uint8_t>(FifoMode::STREAM) << FIFO_MODE_SHIFT) |
+        (config.samplesPerBurst & FIFO_WTM_MASK);
+
+    // CTRL_REG1..CTRL_REG5: data rate, default high-pass filter, watermark
+    // on DRDY/INT2, 250 dps, FIFO enabled
+    const uint8_t profile[] = {config.ctrlReg1, 0x00, I2_WTM, 0x00, FIFO_EN};
+    uint8_t offset;
+    uint8_t spanCount;
+    const bool changes = shadow_.changedSpan(static_cast<uint8_t>(Register::CTRL_REG1), profile,
+                                             sizeof(profile), offset, spanCount);
+    if (!write(Register::FIFO_CTRL_REG, fifoCtrl) ||
+        !applyProfile(Register::CTRL_REG1, profile, sizeof(profile))) {
+        return false;
+    }
+    if (changes) {
+        uint8_t readBack[sizeof(profile)];
+        if (!multiRead(Register::CTRL_REG1, readBack, sizeof(readBack)) ||
+            std::memcmp(readBack, profile, sizeof(profile)) != 0) {
+            shadow_.forget();
+            return false;
+        }
+    }
+
+    enableAsync(config.drdyPort, config.drdyPin, config.samplesPerBurst, config.clock);
+    return true;
+}
+
 uint8_t L3GD20::read(Register reg)
 {
+    if (shadow_.known(static_cast<uint8_t>(reg))) {
+        return shadow_.value(static_cast<uint8_t>(reg));
+    }
     uint8_t data = static_cast<uint8_t>(reg) | READ_MASK;
 
     csLow();
-    // TODO: handle error codes
-    HAL_SPI_Transmit(&hspi_, &data, sizeof(data), defaultTimeout);
-    HAL_SPI_Receive(&hspi_, &data, sizeof(data), defaultTimeout);
+    const bool ok = checked(HAL_SPI_Transmit(&hspi_, &data, sizeof(data), defaultTimeout)) &&
+                    checked(HAL_SPI_Receive(&hspi_, &data, sizeof(data), defaultTimeout));
     csHigh();
+    if (!ok) {
+        return 0;
+    }
+    shadow_.store(static_cast<uint8_t>(reg), data);
     return data;
 }
 
-void L3GD20::write(Register reg, uint8_t value)
+bool L3GD20::write(Register reg, uint8_t value)
 {
+    if (!shadow_.needsWrite(static_cast<uint8_t>(reg), value)) {
+        return true;
+    }
     uint8_t data[2] = {static_cast<uint8_t>(reg), value};
 
     csLow();
-    HAL_SPI_Transmit(&hspi_, data, sizeof(data), defaultTimeout);
+    const bool ok = checked(HAL_SPI_Transmit(&hspi_, data, sizeof(data), defaultTimeout));
     csHigh();
+    if (!ok) {
+        shadow_.forget();
+        return false;
+    }
+    shadow_.store(static_cast<uint8_t>(reg), value);
+    return true;
 }
 
-void L3GD20::multiRead(Register startReg, uint8_t* data, uint8_t count)
+bool L3GD20::multiRead(Register startReg, uint8_t* data, uint8_t count)
 {
     uint8_t reg = static_cast<uint8_t>(startReg) | READ_MASK | MULTI_MASK;
 
     csLow();
-    HAL_SPI_Transmit(&hspi_, &reg, sizeof(reg), defaultTimeout);
-    HAL_SPI_Receive(&hspi_, data, count, defaultTimeout);
+    const bool ok = checked(HAL_SPI_Transmit(&hspi_, &reg, sizeof(reg), defaultTimeout)) &&
+                    checked(HAL_SPI_Receive(&hspi_, data, count, defaultTimeout));
     csHigh();
+    return ok;
 }
 
-void L3GD20::multiWrite(Register startReg, uint8_t* data, uint8_t count)
+bool L3GD20::multiWrite(Register startReg, uint8_t* data, uint8_t count)
 {
     uint8_t reg = static_cast<uint8_t>(startReg) | MULTI_MASK;
 
     csLow();
-    HAL_SPI_Transmit(&hspi_, &reg, sizeof(reg), defaultTimeout);
-    HAL_SPI_Transmit(&hspi_, data, sizeof(data), defaultTimeout);
+    const bool ok = checked(HAL_SPI_Transmit(&hspi_, &reg, sizeof(reg), defaultTimeout)) &&
+                    checked(HAL_SPI_Transmit(&hspi_, data, count, defaultTimeout));
     csHigh();
+    if (!ok) {
+        shadow_.forget();
+        return false;
+    }
+    shadow_.store(static_cast<uint8_t>(startReg), data, count);
+    return true;
 }
 
-void L3GD20::read(Vector3& angularRates)
+bool L3GD20::applyProfile(Register startReg, const uint8_t* values, uint8_t count)
+{
+    uint8_t offset;
+    uint8_t spanCount;
+    if (!shadow_.changedSpan(static_cast<uint8_t>(startReg), values, count, offset, spanCount)) {
+        return true;
+    }
+    // The HAL takes a non-const buffer but only reads it
+    return multiWrite(static_cast<Register>(static_cast<uint8_t>(startReg) + offset),
+                      const_cast<uint8_t*>(values + offset), spanCount);
+}
+
+bool L3GD20::read(Vector3& angularRates)
 {
     uint8_t data[6];
-    multiRead(mart::L3GD20::Register::OUT_X_L, data, sizeof(data));
+    if (!multiRead(mart::L3GD20::Register::OUT_X_L, data, sizeof(data))) {
+        return false;
+    }
 
     angularRates.x = static_cast<int16_t>(data[0]) | static_cast<int16_t>(data[1]) << 8;
     angularRates.y = static_cast<int16_t>(data[2]) | static_cast<int16_t>(data[3]) << 8;
     angularRates.z = static_cast<int16_t>(data[4]) | static_cast<int16_t>(data[5]) << 8;
+    return true;
+}
+
+void L3GD20::enableFifo(FifoMode mode, uint8_t watermark, bool interruptOnWatermark)
+{
+    write(Register::FIFO_CTRL_REG,
+          static_cast<uint8_t>(static_cast<uint8_t>(mode) << FIFO_MODE_SHIFT) |
+              (watermark & FIFO_WTM_MASK));
+
+    uint8_t ctrl3 = read(Register::CTRL_REG3);
+    ctrl3 = interruptOnWatermark ? (ctrl3 | I2_WTM) : (ctrl3 & ~I2_WTM);
+    write(Register::CTRL_REG3, ctrl3);
+
+    write(Register::CTRL_REG5, read(Register::CTRL_REG5) | FIFO_EN);
+}
+
+void L3GD20::disableFifo()
+{
+    write(Register::CTRL_REG5, read(Register::CTRL_REG5) & ~FIFO_EN);
+    write(Register::CTRL_REG3, read(Register::CTRL_REG3) & ~I2_WTM);
+    write(Register::FIFO_CTRL_REG, static_cast<uint8_t>(FifoMode::BYPASS) << FIFO_MODE_SHIFT);
+}
+
+uint8_t L3GD20::fifoLevel()
+{
+    const uint8_t src = read(Register::FIFO_SRC_REG);
+    // FSS only counts to 31, a full FIFO is reported as an overrun
+    return (src & FIFO_SRC_OVRN) ? FIFO_DEPTH : (src & FIFO_SRC_FSS_MASK);
+}
+
+uint8_t L3GD20::readFifo(Vector3* angularRates, uint8_t maxCount)
+{
+    static_assert(sizeof(Vector3) == 6, "Vector3 must match the OUT_X_L..OUT_Z_H layout");
+
+    uint8_t count = fifoLevel();
+    if (count > maxCount) {
+        count = maxCount;
+    }
+    if (count == 0) {
+        return 0;
+    }
+
+    // With the FIFO enabled the address pointer wraps from OUT_Z_H back to
+    // OUT_X_L, so one burst pops count samples. The output is little-endian
+    // (BLE = 0) like the Cortex-M4, so the bytes land in place.
+    if (!multiRead(Register::OUT_X_L, reinterpret_cast<uint8_t*>(angularRates),
+                   static_cast<uint8_t>(count * sizeof(Vector3)))) {
+        return 0;
+    }
+    return count;
+}
+
+void L3GD20::enableAsync(GPIO_TypeDef* drdyPort, uint16_t drdyPin, uint8_t samplesPerBurst,
+                         Clock clock)
+{
+    clock_ = clock;
+    lastBurstValid_ = false;
+    drdyPort_ = drdyPort;
+    drdyPin_ = drdyPin;
+    burstSamples_ = samplesPerBurst < FIFO_DEPTH ? samplesPerBurst : FIFO_DEPTH;
+    txBuffer_[0] = static_cast<uint8_t>(Register::OUT_X_L) | READ_MASK | MULTI_MASK;
+    fillIndex_ = 0;
+    readyCount_ = 0;
+
+    // The line may have gone up before the EXTI was armed
+    const uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (drdyHigh()) {
+        onDataReady();
+    }
+    __set_PRIMASK(primask);
+}
+
+void L3GD20::disableAsync()
+{
+    burstSamples_ = 0;
+    // A burst in flight may still complete within its timeout, after it or
+    // without one the DMA is stopped so the next transfer finds SPI1 idle
+    while (busy_ && guard_.withinTimeout(clock_())) {
+    }
+
+    const uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (busy_) {
+        HAL_SPI_Abort(&hspi_);
+        csHigh();
+        busy_ = false;
+    }
+    __set_PRIMASK(primask);
+}
+
+void L3GD20::onDataReady()
+{
+    // A burst in flight checks the line again when it completes
+    if (burstSamples_ == 0 || busy_ || guard_.failed()) {
+        return;
+    }
+    busy_ = true;
+    burstTime_ = clock_();
+    guard_.start(burstTime_);
+    csLow();
+    const uint16_t bytes = static_cast<uint16_t>(1 + burstSamples_ * sizeof(Vector3));
+    if (HAL_SPI_TransmitReceive_DMA(&hspi_, txBuffer_, rxBuffers_[fillIndex_], bytes) != HAL_OK) {
+        csHigh();
+        busy_ = false;
+        guard_.fail(burstTime_);
+    }
+}
+
+bool L3GD20::onTransferComplete()
+{
+    if (!busy_) {
+        return false;
+    }
+    csHigh();
+    guard_.complete(clock_());
+
+    // Without a previous burst only a single sample can be stamped
+    if (lastBurstValid_ || burstSamples_ == 1) {
+        if (readyCount_ != 0) {
+            ++overruns_;
+        }
+        readyCount_ = burstSamples_;
+        readyFrom_ = lastBurstTime_;
+        readyTo_ = burstTime_;
+        fillIndex_ ^= 1;
+    }
+    lastBurstTime_ = burstTime_;
+    lastBurstValid_ = true;
+    busy_ = false;
+
+    // The watermark flag is a level, no new edge comes while it stays up
+    if (drdyHigh()) {
+        onDataReady();
+    }
+    return true;
+}
+
+void L3GD20::onTransferError()
+{
+    if (!busy_) {
+        return;
+    }
+    csHigh();
+    busy_ = false;
+    guard_.fail(clock_());
+}
+
+void L3GD20::service()
+{
+    if (burstSamples_ == 0) {
+        return;
+    }
+
+    const uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (guard_.expire(clock_(), busy_)) {
+        csHigh();
+        busy_ = false;
+    }
+    __set_PRIMASK(primask);
+
+    if (guard_.service(clock_())) {
+        // DRDY/INT2 is a level, its edge may have passed meanwhile
+        __disable_irq();
+        if (drdyHigh()) {
+            onDataReady();
+        }
+        __set_PRIMASK(primask);
+    }
+}
+
+uint8_t L3GD20::readBurst(RawSample* samples, uint8_t maxCount)
+{
+    // Keep the completion interrupt from swapping the buffers mid-copy
+    const uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    uint8_t count = readyCount_;
+    if (count > maxCount) {
+        count = maxCount;
+    }
+    // Skip the byte clocked in during the address phase
+    const uint8_t* data = rxBuffers_[fillIndex_ ^ 1] + 1;
+    for (uint8_t i = 0; i < count; ++i, data += 6) {
+        samples[i].value.x = static_cast<int16_t>(data[0]) | static_cast<int16_t>(data[1]) << 8;
+        samples[i].value.y = static_cast<int16_t>(data[2]) | static_cast<int16_t>(data[3]) << 8;
+        samples[i].value.z = static_cast<int16_t>(data[4]) | static_cast<int16_t>(data[5]) << 8;
+        samples[i].timestamp = CounterTime::interpolate(readyFrom_, readyTo_, i, readyCount_);
+        samples[i].sensor = SensorId::GYROSCOPE;
+    }
+    readyCount_ = 0;
+
+    __set_PRIMASK(primask);
+    return count;
 }
 
 void L3GD20::csLow()
@@ -75,4 +353,18 @@ void L3GD20::csHigh()
     HAL_GPIO_WritePin(csPort_, csPin_, GPIO_PIN_SET);
 }
 
+bool L3GD20::checked(HAL_StatusTypeDef status)
+{
+    if (status != HAL_OK) {
+        guard_.countError();
+        return false;
+    }
+    return true;
+}
+
+bool L3GD20::drdyHigh() const
+{
+    return drdyPort_ != nullptr && HAL_GPIO_ReadPin(drdyPort_, drdyPin_) == GPIO_PIN_SET;
+}
+
 }
@@ -1,123 +1,520 @@
 #include "lsm303dlhc.h"
+#include <cstring>
 
 namespace mart
 {
 
 namespace
 {
-constexpr uint32_t DEFAULT_TIMEOUT_MS =
-    10;  // TODO: make sure it's measured in ms
+// HAL ticks are 1 ms, 2 waits at least one full tick. A slave holding
+// the bus fails fast and is recovered instead of waited for.
+constexpr uint32_t DEFAULT_TIMEOUT_MS = 2;
 constexpr uint8_t ACCELEROMETER_I2C_ADDRESS = 0x32;
 constexpr uint8_t MAGNETOMETER_I2C_ADDRESS  = 0x3C;
 constexpr uint8_t READ_MASK                 = 0x1;
+constexpr uint8_t AUTO_INCREMENT_MASK       = 0x80;  // accelerometer only
+
+constexpr uint8_t FIFO_EN           = 0x40;  // CTRL_REG5_A
+constexpr uint8_t I1_WTM            = 0x04;  // CTRL_REG3_A
+constexpr uint8_t BLE               = 0x40;  // CTRL_REG4_A, MSB at the lower address
+constexpr uint8_t FIFO_MODE_SHIFT   = 6;     // FIFO_CTRL_REG_A
+constexpr uint8_t FIFO_WTM_MASK     = 0x1F;
+constexpr uint8_t FIFO_SRC_OVRN     = 0x40;  // FIFO_SRC_REG_A
+constexpr uint8_t FIFO_SRC_FSS_MASK = 0x1F;
+
+// CTRL_REG1_A..REFERENCE_A, FIFO_CTRL_REG_A, INT1_CFG_A, INT1_THS_A,
+// INT1_DURATION, INT2_CFG_A, INT2_THS_A, INT2_DURATION, CLICK_CFG_A and
+// CLICK_THS_A..TIME_WINDOW_A
+constexpr uint32_t ACCELEROMETER_CACHEABLE =
+    0x7Fu | 1u << 0xE | 1u << 0x10 | 0x7u << 0x12 | 0x7u << 0x16 | 0xFu << 0x1A;
+// CRA_REG_M..MR_REG_M
+constexpr uint32_t MAGNETOMETER_CACHEABLE = 0x7u;
+
+uint8_t accelerometerSubAddress(Lsm303dlhc::AccRegister startReg, uint8_t count)
+{
+    const uint8_t reg = static_cast<uint8_t>(startReg);
+    return count > 1 ? static_cast<uint8_t>(reg | AUTO_INCREMENT_MASK) : reg;
+}
+
+// OUT_X_L_A..OUT_Z_H_A, little-endian with BLE = 0 in CTRL_REG4_A: the
+// reset value, and configure() keeps it
+void decodeAcceleration(const uint8_t* data, Vector3& accelerations)
+{
+    accelerations.x = static_cast<int16_t>(data[0]) | static_cast<int16_t>(data[1]) << 8;
+    accelerations.y = static_cast<int16_t>(data[2]) | static_cast<int16_t>(data[3]) << 8;
+    accelerations.z = static_cast<int16_t>(data[4]) | static_cast<int16_t>(data[5]) << 8;
+}
+
+// OUT_X_H_M..OUT_Y_L_M, big-endian in X, Z, Y order
+void decodeMagneticField(const uint8_t* data, Vector3& magneticField)
+{
+    magneticField.x = static_cast<int16_t>(data[1]) | static_cast<int16_t>(data[0]) << 8;
+    magneticField.z = static_cast<int16_t>(data[3]) | static_cast<int16_t>(data[2]) << 8;
+    magneticField.y = static_cast<int16_t>(data[5]) | static_cast<int16_t>(data[4]) << 8;
+}
 }  // namespace
 
-Lsm303dlhc::Lsm303dlhc(I2C_HandleTypeDef& hi2c) : hi2c_(hi2c) {}
+static_assert(IsSensor<Lsm303dlhc>::value, "Lsm303dlhc must implement the Sensor concept");
+
+Lsm303dlhc::Lsm303dlhc(I2C_HandleTypeDef& hi2c)
+    : hi2c_(hi2c),
+      accelerometerShadow_(ACCELEROMETER_CACHEABLE),
+      magnetometerShadow_(MAGNETOMETER_CACHEABLE)
+{
+}
+
+bool Lsm303dlhc::configure(const Config& config)
+{
+    disableAsync();
+    guard_.configure(config.timeoutTicks, config.retryTicks, config.recoverBus);
+
+    const uint8_t fifoCtrl =
+        static_cast<uint8_t>(static_cast<uint8_t>(FifoMode::STREAM) << FIFO_MODE_SHIFT) |
+        (config.samplesPerBurst & FIFO_WTM_MASK);
+
+    const uint8_t ctrlReg4A = static_cast<uint8_t>(config.ctrlReg4A & ~BLE);
+    // CTRL_REG1_A..CTRL_REG5_A: data rate, no high-pass filter, watermark
+    // on INT1, scale, FIFO enabled
+    const uint8_t accelerometer[] = {config.ctrlReg1A, 0x00, I1_WTM, ctrlReg4A, FIFO_EN};
+    uint8_t offset;
+    uint8_t spanCount;
+    const bool changes = accelerometerShadow_.changedSpan(
+        static_cast<uint8_t>(AccRegister::CTRL_REG1_A), accelerometer, sizeof(accelerometer),
+        offset, spanCount);
+    if (!write(AccRegister::FIFO_CTRL_REG_A, fifoCtrl) ||
+        !applyProfile(AccRegister::CTRL_REG1_A, accelerometer, sizeof(accelerometer))) {
+        return false;
+    }
+    if (changes) {
+        uint8_t readBack[sizeof(accelerometer)];
+        if (!read(AccRegister::CTRL_REG1_A, readBack, sizeof(readBack)) ||
+            std::memcmp(readBack, accelerometer, sizeof(accelerometer)) != 0) {
+            forgetConfiguration();
+            return false;
+        }
+    }
+
+    // CRA_REG_M..MR_REG_M: data rate, +-1.3 gauss, continuous conversion
+    const uint8_t magnetometer[] = {config.craRegM, 0x20, 0x00};
+    if (!applyProfile(MagRegister::CRA_REG_M, magnetometer, sizeof(magnetometer))) {
+        return false;
+    }
+
+    enableAsync(config.int1Port, config.int1Pin, config.samplesPerBurst, config.clock);
+    return true;
+}
 
-void Lsm303dlhc::read(uint8_t devAddr,
+bool Lsm303dlhc::read(uint8_t devAddr,
                       uint8_t regAddr,
                       uint8_t* data,
                       uint8_t count)
 {
-    // TODO: handle error codes
-    HAL_I2C_Mem_Read(&hi2c_, static_cast<uint16_t>(devAddr | READ_MASK),
-                     static_cast<uint16_t>(regAddr), sizeof(regAddr), data,
-                     count, DEFAULT_TIMEOUT_MS);
+    if (HAL_I2C_Mem_Read(&hi2c_, static_cast<uint16_t>(devAddr | READ_MASK),
+                         static_cast<uint16_t>(regAddr), sizeof(regAddr), data,
+                         count, DEFAULT_TIMEOUT_MS) != HAL_OK) {
+        return blockingFailed();
+    }
+    return true;
 }
 
-void Lsm303dlhc::write(uint8_t devAddr,
+bool Lsm303dlhc::write(uint8_t devAddr,
                        uint8_t regAddr,
                        uint8_t* data,
                        uint8_t count)
 {
-    HAL_I2C_Mem_Write(&hi2c_, static_cast<uint16_t>(devAddr),
-                      static_cast<uint16_t>(regAddr), sizeof(regAddr), data,
-                      count, DEFAULT_TIMEOUT_MS);
+    if (HAL_I2C_Mem_Write(&hi2c_, static_cast<uint16_t>(devAddr),
+                          static_cast<uint16_t>(regAddr), sizeof(regAddr), data,
+                          count, DEFAULT_TIMEOUT_MS) != HAL_OK) {
+        return blockingFailed();
+    }
+    return true;
 }
 
 uint8_t Lsm303dlhc::read(AccRegister reg)
 {
+    if (accelerometerShadow_.known(static_cast<uint8_t>(reg))) {
+        return accelerometerShadow_.value(static_cast<uint8_t>(reg));
+    }
     uint8_t value;
-    read(ACCELEROMETER_I2C_ADDRESS, static_cast<uint8_t>(reg), &value,
-         sizeof(value));
+    if (!read(ACCELEROMETER_I2C_ADDRESS, static_cast<uint8_t>(reg), &value,
+              sizeof(value))) {
+        return 0;
+    }
+    accelerometerShadow_.store(static_cast<uint8_t>(reg), value);
     return value;
 }
 
-void Lsm303dlhc::write(AccRegister reg, uint8_t value)
+bool Lsm303dlhc::write(AccRegister reg, uint8_t value)
 {
-    write(ACCELEROMETER_I2C_ADDRESS, static_cast<uint8_t>(reg), &value,
-          sizeof(value));
+    if (!accelerometerShadow_.needsWrite(static_cast<uint8_t>(reg), value)) {
+        return true;
+    }
+    if (!write(ACCELEROMETER_I2C_ADDRESS, static_cast<uint8_t>(reg), &value,
+               sizeof(value))) {
+        accelerometerShadow_.forget();
+        return false;
+    }
+    accelerometerShadow_.store(static_cast<uint8_t>(reg), value);
+    return true;
 }
 
-void Lsm303dlhc::read(AccRegister startReg, uint8_t* data, uint8_t count)
+bool Lsm303dlhc::read(AccRegister startReg, uint8_t* data, uint8_t count)
 {
-    read(ACCELEROMETER_I2C_ADDRESS, static_cast<uint8_t>(startReg), data,
-         count);
+    return read(ACCELEROMETER_I2C_ADDRESS, accelerometerSubAddress(startReg, count),
+                data, count);
 }
 
-void Lsm303dlhc::write(AccRegister startReg, uint8_t* data, uint8_t count)
+bool Lsm303dlhc::write(AccRegister startReg, uint8_t* data, uint8_t count)
 {
-    write(ACCELEROMETER_I2C_ADDRESS, static_cast<uint8_t>(startReg), data,
-          count);
+    if (!write(ACCELEROMETER_I2C_ADDRESS, accelerometerSubAddress(startReg, count),
+               data, count)) {
+        accelerometerShadow_.forget();
+        return false;
+    }
+    accelerometerShadow_.store(static_cast<uint8_t>(startReg), data, count);
+    return true;
 }
 
 uint8_t Lsm303dlhc::read(MagRegister reg)
 {
+    if (magnetometerShadow_.known(static_cast<uint8_t>(reg))) {
+        return magnetometerShadow_.value(static_cast<uint8_t>(reg));
+    }
     uint8_t value;
-    read(MAGNETOMETER_I2C_ADDRESS, static_cast<uint8_t>(reg), &value,
-         sizeof(value));
+    if (!read(MAGNETOMETER_I2C_ADDRESS, static_cast<uint8_t>(reg), &value,
+              sizeof(value))) {
+        return 0;
+    }
+    magnetometerShadow_.store(static_cast<uint8_t>(reg), value);
     return value;
 }
 
-void Lsm303dlhc::write(MagRegister reg, uint8_t value)
+bool Lsm303dlhc::write(MagRegister reg, uint8_t value)
 {
-    write(MAGNETOMETER_I2C_ADDRESS, static_cast<uint8_t>(reg), &value,
-          sizeof(value));
+    if (!magnetometerShadow_.needsWrite(static_cast<uint8_t>(reg), value)) {
+        return true;
+    }
+    if (!write(MAGNETOMETER_I2C_ADDRESS, static_cast<uint8_t>(reg), &value,
+               sizeof(value))) {
+        magnetometerShadow_.forget();
+        return false;
+    }
+    magnetometerShadow_.store(static_cast<uint8_t>(reg), value);
+    return true;
 }
 
-void Lsm303dlhc::read(MagRegister startReg, uint8_t* data, uint8_t count)
+bool Lsm303dlhc::read(MagRegister startReg, uint8_t* data, uint8_t count)
 {
-    read(MAGNETOMETER_I2C_ADDRESS, static_cast<uint8_t>(startReg), data, count);
+    return read(MAGNETOMETER_I2C_ADDRESS, static_cast<uint8_t>(startReg), data, count);
 }
 
-void Lsm303dlhc::write(MagRegister startReg, uint8_t* data, uint8_t count)
+bool Lsm303dlhc::write(MagRegister startReg, uint8_t* data, uint8_t count)
 {
-    write(MAGNETOMETER_I2C_ADDRESS, static_cast<uint8_t>(startReg), data,
-          count);
+    if (!write(MAGNETOMETER_I2C_ADDRESS, static_cast<uint8_t>(startReg), data,
+               count)) {
+        magnetometerShadow_.forget();
+        return false;
+    }
+    magnetometerShadow_.store(static_cast<uint8_t>(startReg), data, count);
+    return true;
 }
 
-void Lsm303dlhc::readAcceleration(Vector3& accelerations)
+// The HAL takes a non-const buffer but only reads it
+bool Lsm303dlhc::applyProfile(AccRegister startReg, const uint8_t* values, uint8_t count)
 {
-    uint8_t data[6];
-    data[0] = read(AccRegister::OUT_X_L_A);
-    data[1] = read(AccRegister::OUT_X_H_A);
-    data[2] = read(AccRegister::OUT_Y_L_A);
-    data[3] = read(AccRegister::OUT_Y_H_A);
-    data[4] = read(AccRegister::OUT_Z_L_A);
-    data[5] = read(AccRegister::OUT_Z_H_A);
-    // TODO: might be way faster
-    // also, think about MSB first configuration
-    // read(AccRegister::OUT_X_L_A, data, sizeof(data));
+    uint8_t offset;
+    uint8_t spanCount;
+    if (!accelerometerShadow_.changedSpan(static_cast<uint8_t>(startReg), values, count, offset,
+                                          spanCount)) {
+        return true;
+    }
+    return write(static_cast<AccRegister>(static_cast<uint8_t>(startReg) + offset),
+                 const_cast<uint8_t*>(values + offset), spanCount);
+}
 
-    accelerations.x = static_cast<int16_t>(data[0]) | static_cast<int16_t>(data[1]) << 8;
-    accelerations.y = static_cast<int16_t>(data[2]) | static_cast<int16_t>(data[3]) << 8;
-    accelerations.z = static_cast<int16_t>(data[4]) | static_cast<int16_t>(data[5]) << 8;
+bool Lsm303dlhc::applyProfile(MagRegister startReg, const uint8_t* values, uint8_t count)
+{
+    uint8_t offset;
+    uint8_t spanCount;
+    if (!magnetometerShadow_.changedSpan(static_cast<uint8_t>(startReg), values, count, offset,
+                                         spanCount)) {
+        return true;
+    }
+    return write(static_cast<MagRegister>(static_cast<uint8_t>(startReg) + offset),
+                 const_cast<uint8_t*>(values + offset), spanCount);
 }
 
-void Lsm303dlhc::readMagneticField(Vector3& magneticField)
+void Lsm303dlhc::forgetConfiguration()
+{
+    accelerometerShadow_.forget();
+    magnetometerShadow_.forget();
+}
+
+bool Lsm303dlhc::readAcceleration(Vector3& accelerations)
 {
     uint8_t data[6];
-    data[0] = read(MagRegister::OUT_X_H_M);
-    data[1] = read(MagRegister::OUT_X_L_M);
-    data[2] = read(MagRegister::OUT_Y_H_M);
-    data[3] = read(MagRegister::OUT_Y_L_M);
-    data[4] = read(MagRegister::OUT_Z_H_M);
-    data[5] = read(MagRegister::OUT_Z_L_M);
-    // read(MagRegister::OUT_X_H_M, data, sizeof(data));
+    if (!read(AccRegister::OUT_X_L_A, data, sizeof(data))) {
+        return false;
+    }
+    decodeAcceleration(data, accelerations);
+    return true;
+}
 
-    magneticField.x = static_cast<int16_t>(data[1]) | static_cast<int16_t>(data[0]) << 8;
-    magneticField.y = static_cast<int16_t>(data[3]) | static_cast<int16_t>(data[2]) << 8;
-    magneticField.z = static_cast<int16_t>(data[5]) | static_cast<int16_t>(data[4]) << 8;
+bool Lsm303dlhc::readMagneticField(Vector3& magneticField)
+{
+    uint8_t data[6];
+    if (!read(MagRegister::OUT_X_H_M, data, sizeof(data))) {
+        return false;
+    }
+    decodeMagneticField(data, magneticField);
+    return true;
+}
+
+void Lsm303dlhc::enableFifo(FifoMode mode, uint8_t watermark, bool interruptOnWatermark)
+{
+    write(AccRegister::FIFO_CTRL_REG_A,
+          static_cast<uint8_t>(static_cast<uint8_t>(mode) << FIFO_MODE_SHIFT) |
+              (watermark & FIFO_WTM_MASK));
+
+    uint8_t ctrl3 = read(AccRegister::CTRL_REG3_A);
+    ctrl3 = interruptOnWatermark ? (ctrl3 | I1_WTM) : (ctrl3 & ~I1_WTM);
+    write(AccRegister::CTRL_REG3_A, ctrl3);
+
+    write(AccRegister::CTRL_REG5_A, read(AccRegister::CTRL_REG5_A) | FIFO_EN);
+}
+
+void Lsm303dlhc::disableFifo()
+{
+    write(AccRegister::CTRL_REG5_A, read(AccRegister::CTRL_REG5_A) & ~FIFO_EN);
+    write(AccRegister::CTRL_REG3_A, read(AccRegister::CTRL_REG3_A) & ~I1_WTM);
+    write(AccRegister::FIFO_CTRL_REG_A,
+          static_cast<uint8_t>(FifoMode::BYPASS) << FIFO_MODE_SHIFT);
+}
+
+uint8_t Lsm303dlhc::fifoLevel()
+{
+    const uint8_t src = read(AccRegister::FIFO_SRC_REG_A);
+    // FSS only counts to 31, a full FIFO is reported as an overrun
+    return (src & FIFO_SRC_OVRN) ? FIFO_DEPTH : (src & FIFO_SRC_FSS_MASK);
+}
+
+uint8_t Lsm303dlhc::readFifo(Vector3* accelerations, uint8_t maxCount)
+{
+    uint8_t count = fifoLevel();
+    if (count > maxCount) {
+        count = maxCount;
+    }
+    if (count == 0) {
+        return 0;
+    }
+
+    // With the FIFO enabled the auto-incremented pointer wraps from
+    // OUT_Z_H_A back to OUT_X_L_A, so one read pops count samples
+    if (!read(AccRegister::OUT_X_L_A, accelerationData_, static_cast<uint8_t>(count * 6))) {
+        return 0;
+    }
+    for (uint8_t i = 0; i < count; ++i) {
+        decodeAcceleration(accelerationData_ + i * 6, accelerations[i]);
+    }
+    return count;
+}
+
+void Lsm303dlhc::enableAsync(GPIO_TypeDef* int1Port, uint16_t int1Pin, uint8_t samplesPerBurst,
+                             Clock clock)
+{
+    clock_ = clock;
+    lastBatchValid_ = false;
+    int1Port_ = int1Port;
+    int1Pin_ = int1Pin;
+    burstSamples_ = samplesPerBurst == 0 ? 1
+                    : samplesPerBurst < FIFO_DEPTH ? samplesPerBurst : FIFO_DEPTH;
+    fresh_ = false;
+
+    // The line may have gone up before the EXTI was armed
+    const uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (int1High()) {
+        onDataReady();
+    }
+    __set_PRIMASK(primask);
+}
+
+void Lsm303dlhc::disableAsync()
+{
+    int1Port_ = nullptr;
+    // A read in flight may still complete within its timeout, after it or
+    // without one it is aborted so the next transfer finds I2C1 idle
+    while (state_ != State::IDLE && guard_.withinTimeout(clock_())) {
+    }
+
+    const uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    bool aborted = true;
+    if (state_ != State::IDLE) {
+        const uint8_t devAddr = state_ == State::ACCELERATION ? ACCELEROMETER_I2C_ADDRESS
+                                                              : MAGNETOMETER_I2C_ADDRESS;
+        aborted = HAL_I2C_Master_Abort_IT(&hi2c_, devAddr) == HAL_OK;
+        state_ = State::IDLE;
+    }
+    __set_PRIMASK(primask);
+
+    // The HAL refuses to abort memory-mode transfers, the recovery then
+    // re-initialises the peripheral and its DMA channel
+    if (!aborted) {
+        guard_.recover();
+    }
+}
+
+void Lsm303dlhc::onDataReady()
+{
+    // A read in flight checks the line again when it completes
+    if (int1Port_ == nullptr || state_ != State::IDLE || guard_.failed()) {
+        return;
+    }
+    state_ = State::ACCELERATION;
+    batchTime_ = clock_();
+    guard_.start(batchTime_);
+    const uint8_t reg = static_cast<uint8_t>(AccRegister::OUT_X_L_A) | AUTO_INCREMENT_MASK;
+    if (!startRead(ACCELEROMETER_I2C_ADDRESS, reg, accelerationData_, burstSamples_ * 6)) {
+        fail();
+    }
+}
+
+bool Lsm303dlhc::onTransferComplete()
+{
+    if (state_ == State::ACCELERATION) {
+        // Without a previous batch only a single sample can be stamped
+        const uint8_t count = lastBatchValid_ || burstSamples_ == 1 ? burstSamples_ : 0;
+        for (uint8_t i = 0; i < count; ++i) {
+            decodeAcceleration(accelerationData_ + i * 6, pending_.acceleration[i]);
+            pending_.accelerationTime[i] =
+                CounterTime::interpolate(lastBatchTime_, batchTime_, i, burstSamples_);
+        }
+        pending_.accelerationCount = count;
+        lastBatchTime_ = batchTime_;
+        lastBatchValid_ = true;
+
+        state_ = State::MAGNETIC_FIELD;
+        pending_.magneticFieldTime = clock_();
+        const uint8_t reg = static_cast<uint8_t>(MagRegister::OUT_X_H_M);
+        if (!startRead(MAGNETOMETER_I2C_ADDRESS, reg, magneticFieldData_, 6)) {
+            fail();
+        }
+        return false;
+    }
+    if (state_ != State::MAGNETIC_FIELD) {
+        return false;
+    }
+
+    decodeMagneticField(magneticFieldData_, pending_.magneticField);
+    guard_.complete(clock_());
+    if (fresh_) {
+        ++overruns_;
+    }
+    ready_ = pending_;
+    fresh_ = true;
+    state_ = State::IDLE;
+
+    // DRDY1 is a level, no new edge comes while it stays up
+    if (int1High()) {
+        onDataReady();
+    }
+    return true;
+}
+
+void Lsm303dlhc::onTransferError()
+{
+    if (state_ != State::IDLE) {
+        fail();
+    }
+}
+
+void Lsm303dlhc::service()
+{
+    if (int1Port_ == nullptr) {
+        return;
+    }
+
+    const uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (guard_.expire(clock_(), state_ != State::IDLE)) {
+        state_ = State::IDLE;
+    }
+    __set_PRIMASK(primask);
+
+    if (guard_.service(clock_())) {
+        // INT1 is a level, its edge may have passed meanwhile
+        __disable_irq();
+        if (int1High()) {
+            onDataReady();
+        }
+        __set_PRIMASK(primask);
+    }
+}
+
+bool Lsm303dlhc::takeSample(Sample& sample)
+{
+    // Keep the completion interrupt from publishing mid-copy
+    const uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    const bool fresh = fresh_;
+    if (fresh) {
+        sample = ready_;
+        fresh_ = false;
+    }
+    __set_PRIMASK(primask);
+    return fresh;
+}
+
+uint8_t Lsm303dlhc::readBurst(RawSample* samples, uint8_t maxCount)
+{
+    const uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint8_t count = 0;
+    if (fresh_) {
+        for (uint8_t i = 0; i < ready_.accelerationCount && count < maxCount; ++i, ++count) {
+            samples[count].timestamp = ready_.accelerationTime[i];
+            samples[count].value = ready_.acceleration[i];
+            samples[count].sensor = SensorId::ACCELEROMETER;
+        }
+        if (count < maxCount) {
+            samples[count].timestamp = ready_.magneticFieldTime;
+            samples[count].value = ready_.magneticField;
+            samples[count].sensor = SensorId::MAGNETOMETER;
+            ++count;
+        }
+        fresh_ = false;
+    }
+    __set_PRIMASK(primask);
+    return count;
+}
+
+// A slave holding SDA low fails every further transfer, so the bus is
+// recovered right away. Always false, for the callers to return.
+bool Lsm303dlhc::blockingFailed()
+{
+    guard_.countError();
+    guard_.recover();
+    return false;
+}
+
+bool Lsm303dlhc::startRead(uint8_t devAddr, uint8_t regAddr, uint8_t* data, uint8_t count)
+{
+    return HAL_I2C_Mem_Read_DMA(&hi2c_, static_cast<uint16_t>(devAddr | READ_MASK),
+                                static_cast<uint16_t>(regAddr), sizeof(regAddr), data,
+                                count) == HAL_OK;
+}
+
+// Interrupt context or interrupts disabled
+void Lsm303dlhc::fail()
+{
+    guard_.fail(clock_());
+    state_ = State::IDLE;
+}
+
+bool Lsm303dlhc::int1High() const
+{
+    return int1Port_ != nullptr && HAL_GPIO_ReadPin(int1Port_, int1Pin_) == GPIO_PIN_SET;
 }
 
 }  // namespace mart
@@ -27,6 +27,8 @@
 #include "l3gd20.h"
 #include "lsm303dlhc.h"
 #include "OrientationEstimator.h"
+#include "pipeline.h"
+#include "ringbuffer.h"
 #include <stdio.h>
 /* USER CODE END Includes */
 
@@ -37,6 +39,19 @@
 
 /* Private define ------------------------------------------------------------*/
 /* USER CODE BEGIN PD */
+#define GYRO_BURST_SAMPLES 8
+#define ACC_BURST_SAMPLES 16
+#define SAMPLE_QUEUE_SIZE 128
+#define CYCLE_COUNTER_HZ 72000000U // HCLK, the DWT cycle counter stamps the samples
+// sensorsTask checks the buses at least this often
+#define SENSORS_SERVICE_MS 10
+// One filter update needs ~2 KB of stack for the 12x12 temporaries
+#define SENSORS_STACK_WORDS 1024
+// A burst takes ~30 us on SPI1 and ~10 ms on I2C1 at 100 kHz
+#define GYRO_TIMEOUT_TICKS (CYCLE_COUNTER_HZ / 1000U)
+#define ACC_TIMEOUT_TICKS (CYCLE_COUNTER_HZ / 50U)
+#define BUS_RETRY_TICKS (CYCLE_COUNTER_HZ / 1000U)
+#define I2C_RECOVERY_HALF_PERIOD (CYCLE_COUNTER_HZ / 200000U) // 100 kHz SCL
 
 /* USER CODE END PD */
 
@@ -47,8 +62,11 @@
 
 /* Private variables ---------------------------------------------------------*/
 I2C_HandleTypeDef hi2c1;
+DMA_HandleTypeDef hdma_i2c1_rx;
 
 SPI_HandleTypeDef hspi1;
+DMA_HandleTypeDef hdma_spi1_rx;
+DMA_HandleTypeDef hdma_spi1_tx;
 
 UART_HandleTypeDef huart2;
 
@@ -61,12 +79,26 @@ osThreadId sensorsTaskHandle;
 mart::L3GD20 gyroscope(GYRO_CS_GPIO_Port, GYRO_CS_Pin, hspi1);
 mart::Lsm303dlhc lsm303dlhc(hi2c1);
 
-mart::orient::OrientationEstimator orientationEstimator;
+// Filled by the SPI and I2C completion interrupts. Both run at the same
+// priority and cannot preempt each other, so together they are the single
+// producer; sensorsTask is the consumer.
+mart::RingBuffer<RawSample, SAMPLE_QUEUE_SIZE> sampleQueue;
+
+mart::orient::OrientationEstimator orientationEstimator(CYCLE_COUNTER_HZ);
+
+// L3GD20 at 250 dps, LSM303DLHC at +-16 g high resolution and 1.3 gauss
+const mart::SampleFusion<mart::orient::OrientationEstimator>::Scales sensorScales = {{
+    {1.527e-4f, 1.527e-4f, 1.527e-4f},           // rad/s
+    {7.5e-4f, 7.5e-4f, 7.5e-4f},                 // g
+    {1 / 1100.0f, 1 / 1100.0f, 1 / 980.0f},      // gauss
+}};
+mart::SampleFusion<mart::orient::OrientationEstimator> sampleFusion(orientationEstimator, sensorScales);
 /* USER CODE END PV */
 
 /* Private function prototypes -----------------------------------------------*/
 void SystemClock_Config(void);
 static void MX_GPIO_Init(void);
+static void MX_DMA_Init(void);
 static void MX_USART2_UART_Init(void);
 static void MX_SPI1_Init(void);
 static void MX_I2C1_Init(void);
@@ -77,6 +109,9 @@ void StartDefaultTask(void const * argument);
 void blinkyTask(void const* argument);
 void consoleTask(void const* argument);
 void sensorsTask(void const* argument);
+static uint32_t cycleCounter(void);
+static void recoverSpi1(void);
+static void recoverI2c1(void);
 
 /* USER CODE END PFP */
 
@@ -114,6 +149,7 @@ int main(void)
 
   /* Initialize all configured peripherals */
   MX_GPIO_Init();
+  MX_DMA_Init();
   MX_USART2_UART_Init();
   MX_SPI1_Init();
   MX_I2C1_Init();
@@ -121,13 +157,28 @@ int main(void)
 
   Console_Init();
 
-  gyroscope.write(mart::L3GD20::Register::CTRL_REG1, 0x1F);
-
-  lsm303dlhc.write(mart::Lsm303dlhc::AccRegister::CTRL_REG4_A, 0x38); // +-16G, highres
-  lsm303dlhc.write(mart::Lsm303dlhc::AccRegister::CTRL_REG1_A, 0x57); // 3-axis, 100 Hz, normal mode
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+  // A DMA burst of samplesPerBurst on every FIFO watermark interrupt
+  const mart::L3GD20::Config gyroscopeConfig = {
+      0x1F, // 3-axis, 95 Hz, normal mode
+      GYRO_BURST_SAMPLES, GYRO_INT2_GPIO_Port, GYRO_INT2_Pin, &cycleCounter,
+      &recoverSpi1, GYRO_TIMEOUT_TICKS, BUS_RETRY_TICKS};
+  if (!gyroscope.configure(gyroscopeConfig)) {
+      Console_Printf("Gyroscope does not respond\n");
+  }
 
-  lsm303dlhc.write(mart::Lsm303dlhc::MagRegister::CRA_REG_M, 0x18); // 3-axis, 75 Hz, normal mode
-  lsm303dlhc.write(mart::Lsm303dlhc::MagRegister::MR_REG_M, 0x00); // continuos mode
+  const mart::Lsm303dlhc::Config lsm303dlhcConfig = {
+      0x77, // 3-axis, 400 Hz, normal mode
+      0x38, // +-16G, highres
+      0x18, // magnetometer 75 Hz
+      ACC_BURST_SAMPLES, ACC_INT1_GPIO_Port, ACC_INT1_Pin, &cycleCounter,
+      &recoverI2c1, ACC_TIMEOUT_TICKS, BUS_RETRY_TICKS};
+  if (!lsm303dlhc.configure(lsm303dlhcConfig)) {
+      Console_Printf("LSM303DLHC does not respond\n");
+  }
   /* USER CODE END 2 */
 
   /* USER CODE BEGIN RTOS_MUTEX */
@@ -159,7 +210,7 @@ int main(void)
   osThreadDef(console, consoleTask, osPriorityNormal, 0, 128);
   consoleTaskHandle = osThreadCreate(osThread(console), NULL);
 
-  osThreadDef(sensors, sensorsTask, osPriorityNormal, 0, 128);
+  osThreadDef(sensors, sensorsTask, osPriorityNormal, 0, SENSORS_STACK_WORDS);
   sensorsTaskHandle = osThreadCreate(osThread(sensors), NULL);
   /* USER CODE END RTOS_THREADS */
 
@@ -348,6 +399,28 @@ static void MX_USART2_UART_Init(void)
 
 }
 
+/**
+  * Enable DMA controller clock
+  */
+static void MX_DMA_Init(void)
+{
+
+  /* DMA controller clock enable */
+  __HAL_RCC_DMA1_CLK_ENABLE();
+
+  /* DMA interrupt init */
+  /* DMA1_Channel2_IRQn interrupt configuration */
+  HAL_NVIC_SetPriority(DMA1_Channel2_IRQn, 5, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Channel2_IRQn);
+  /* DMA1_Channel3_IRQn interrupt configuration */
+  HAL_NVIC_SetPriority(DMA1_Channel3_IRQn, 5, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Channel3_IRQn);
+  /* DMA1_Channel7_IRQn interrupt configuration */
+  HAL_NVIC_SetPriority(DMA1_Channel7_IRQn, 5, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Channel7_IRQn);
+
+}
+
 /**
   * @brief GPIO Initialization Function
   * @param None
@@ -381,6 +454,19 @@ static void MX_GPIO_Init(void)
   GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
   HAL_GPIO_Init(GPIOE, &GPIO_InitStruct);
 
+  /*Configure GPIO pins : GYRO_INT2_Pin ACC_INT1_Pin */
+  GPIO_InitStruct.Pin = GYRO_INT2_Pin|ACC_INT1_Pin;
+  GPIO_InitStruct.Mode = GPIO_MODE_IT_RISING;
+  GPIO_InitStruct.Pull = GPIO_NOPULL;
+  HAL_GPIO_Init(GPIOE, &GPIO_InitStruct);
+
+  /* EXTI interrupt init*/
+  HAL_NVIC_SetPriority(EXTI1_IRQn, 5, 0);
+  HAL_NVIC_EnableIRQ(EXTI1_IRQn);
+
+  HAL_NVIC_SetPriority(EXTI4_IRQn, 5, 0);
+  HAL_NVIC_EnableIRQ(EXTI4_IRQn);
+
 /* USER CODE BEGIN MX_GPIO_Init_2 */
 /* USER CODE END MX_GPIO_Init_2 */
 }
@@ -414,19 +500,148 @@ void consoleTask(void const* argument)
 
 void sensorsTask(void const* argument)
 {
-    Vector3 vec;
+    static RawSample samples[SAMPLE_QUEUE_SIZE];
+    static const char* const names[] = {"gyr", "acc", "mag"};
 
     for (;;) {
-        gyroscope.read(vec);
-        Console_Printf("gyr: x=%d, y=%d, z=%d\n", vec.x, vec.y, vec.z);
+        // Woken by the SPI and I2C completions and errors, neither bus is
+        // waited on here
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(SENSORS_SERVICE_MS));
+
+        // Timeouts, bus recovery and retries of failed transfers
+        gyroscope.service();
+        lsm303dlhc.service();
+
+        // Everything that arrived since the last wake-up goes to the filter
+        const uint32_t count = sampleQueue.pop(samples, SAMPLE_QUEUE_SIZE);
+        const uint32_t updates = sampleFusion.consume(samples, count);
+
+        // Diagnostics only: the newest sample of each sensor
+        const RawSample* latest[3] = {NULL, NULL, NULL};
+        uint32_t perSensor[3] = {0, 0, 0};
+        for (uint32_t i = 0; i < count; ++i) {
+            const uint8_t sensor = static_cast<uint8_t>(samples[i].sensor);
+            latest[sensor] = &samples[i];
+            ++perSensor[sensor];
+        }
+        for (uint8_t sensor = 0; sensor < 3; ++sensor) {
+            if (latest[sensor] != NULL) {
+                const RawSample& s = *latest[sensor];
+                Console_Printf("%s: t=%lu, n=%lu, x=%d, y=%d, z=%d\n", names[sensor],
+                               s.timestamp, perSensor[sensor], s.value.x, s.value.y, s.value.z);
+            }
+        }
+        if (updates != 0) {
+            Console_Printf("ekf: updates=%lu\n", updates);
+        }
+    }
+}
+
+static uint32_t cycleCounter(void)
+{
+    return DWT->CYCCNT;
+}
+
+static void delayCycles(uint32_t cycles)
+{
+    const uint32_t start = cycleCounter();
+    while (cycleCounter() - start < cycles) {
+    }
+}
 
-        lsm303dlhc.readAcceleration(vec);
-        Console_Printf("acc: x=%d, y=%d, z=%d\n", vec.x, vec.y, vec.z);
+// Cancels a hung DMA transfer, an SPI slave cannot hold the bus
+static void recoverSpi1(void)
+{
+    HAL_SPI_Abort(&hspi1);
+    HAL_SPI_DeInit(&hspi1);
+    MX_SPI1_Init();
+}
+
+// A slave stopped mid-byte holds SDA low until it has clocked out the
+// rest: up to nine SCL pulses free it, and a STOP resets every slave on
+// the bus. Takes about 100 us, then the peripheral starts afresh.
+static void recoverI2c1(void)
+{
+    HAL_I2C_DeInit(&hi2c1);
+
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+    GPIO_InitStruct.Pin = GPIO_PIN_6|GPIO_PIN_7;
+    GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_OD;
+    GPIO_InitStruct.Pull = GPIO_NOPULL;
+    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_HIGH;
+    HAL_GPIO_WritePin(GPIOB, GPIO_PIN_6|GPIO_PIN_7, GPIO_PIN_SET);
+    HAL_GPIO_Init(GPIOB, &GPIO_InitStruct);
+
+    for (uint8_t i = 0; i < 9 && HAL_GPIO_ReadPin(GPIOB, GPIO_PIN_7) == GPIO_PIN_RESET; ++i) {
+        HAL_GPIO_WritePin(GPIOB, GPIO_PIN_6, GPIO_PIN_RESET);
+        delayCycles(I2C_RECOVERY_HALF_PERIOD);
+        HAL_GPIO_WritePin(GPIOB, GPIO_PIN_6, GPIO_PIN_SET);
+        delayCycles(I2C_RECOVERY_HALF_PERIOD);
+    }
+
+    // STOP: SDA rises while SCL is high
+    HAL_GPIO_WritePin(GPIOB, GPIO_PIN_6, GPIO_PIN_RESET);
+    delayCycles(I2C_RECOVERY_HALF_PERIOD);
+    HAL_GPIO_WritePin(GPIOB, GPIO_PIN_7, GPIO_PIN_RESET);
+    delayCycles(I2C_RECOVERY_HALF_PERIOD);
+    HAL_GPIO_WritePin(GPIOB, GPIO_PIN_6, GPIO_PIN_SET);
+    delayCycles(I2C_RECOVERY_HALF_PERIOD);
+    HAL_GPIO_WritePin(GPIOB, GPIO_PIN_7, GPIO_PIN_SET);
+    delayCycles(I2C_RECOVERY_HALF_PERIOD);
+
+    HAL_GPIO_DeInit(GPIOB, GPIO_PIN_6|GPIO_PIN_7);
+    MX_I2C1_Init();
+}
 
-        lsm303dlhc.readMagneticField(vec);
-        Console_Printf("mag: x=%d, y=%d, z=%d\n", vec.x, vec.y, vec.z);
+static void notifySensorsTaskFromISR(void)
+{
+    if (sensorsTaskHandle != NULL) {
+        BaseType_t higherPriorityTaskWoken = pdFALSE;
+        vTaskNotifyGiveFromISR(sensorsTaskHandle, &higherPriorityTaskWoken);
+        portYIELD_FROM_ISR(higherPriorityTaskWoken);
+    }
+}
+
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
+{
+    if (GPIO_Pin == GYRO_INT2_Pin) {
+        gyroscope.onDataReady();
+    } else if (GPIO_Pin == ACC_INT1_Pin) {
+        lsm303dlhc.onDataReady();
+    }
+}
 
-        osDelay(100);
+void HAL_SPI_TxRxCpltCallback(SPI_HandleTypeDef* hspi)
+{
+    if (hspi == &hspi1 && gyroscope.onTransferComplete()) {
+        static RawSample burst[mart::L3GD20::MAX_BURST];
+        sampleQueue.push(burst, gyroscope.readBurst(burst, mart::L3GD20::MAX_BURST));
+        notifySensorsTaskFromISR();
+    }
+}
+
+void HAL_SPI_ErrorCallback(SPI_HandleTypeDef* hspi)
+{
+    if (hspi == &hspi1) {
+        gyroscope.onTransferError();
+        notifySensorsTaskFromISR();
+    }
+}
+
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef* hi2c)
+{
+    if (hi2c == &hi2c1 && lsm303dlhc.onTransferComplete()) {
+        static RawSample burst[mart::Lsm303dlhc::MAX_BURST];
+        sampleQueue.push(burst, lsm303dlhc.readBurst(burst, mart::Lsm303dlhc::MAX_BURST));
+        notifySensorsTaskFromISR();
+    }
+}
+
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef* hi2c)
+{
+    if (hi2c == &hi2c1) {
+        lsm303dlhc.onTransferError();
+        notifySensorsTaskFromISR();
     }
 }
 
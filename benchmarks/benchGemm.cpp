@@ -0,0 +1,71 @@
+#include <gemm.h>
+#include <benchmark/benchmark.h>
+#include <vector>
+
+namespace
+{
+
+// Storage for the four size x size matrices of F * P * F^T
+struct Propagation {
+    explicit Propagation(uint16_t size)
+        : buffer(4 * static_cast<std::size_t>(size) * size * sizeof(double) + 64),
+          arena(buffer.data(), buffer.size()),
+          F(mart::DynMatrix<double>::allocate(arena, size, size)),
+          P(mart::DynMatrix<double>::allocate(arena, size, size)),
+          FP(mart::DynMatrix<double>::allocate(arena, size, size)),
+          FPFT(mart::DynMatrix<double>::allocate(arena, size, size))
+    {
+        for (uint16_t row = 0; row < size; ++row) {
+            for (uint16_t col = 0; col < size; ++col) {
+                F(row, col) = row == col ? 1 : 1e-3 * (row - col);
+                P(row, col) = row == col ? 2 : 1e-4;
+            }
+        }
+    }
+
+    std::vector<unsigned char> buffer;
+    mart::Arena arena;
+    mart::DynMatrix<double> F, P, FP, FPFT;
+};
+
+void setFlops(benchmark::State& state, uint16_t size)
+{
+    // Two products of 2 * size^3 operations each
+    const double gigaFlops = 4e-9 * size * size * size;
+    state.counters["GFLOPS"] =
+        benchmark::Counter(gigaFlops, benchmark::Counter::kIsIterationInvariantRate);
+}
+
+void BM_PropagationPlain(benchmark::State& state)
+{
+    const auto size = static_cast<uint16_t>(state.range(0));
+    Propagation p(size);
+    for (auto _ : state) {
+        mart::multiply(p.F, p.P, p.FP);
+        mart::multiply(p.FP, mart::transposed(p.F), p.FPFT);
+        benchmark::ClobberMemory();
+    }
+    setFlops(state, size);
+}
+
+// range(1) is the number of threads, the caller included
+void BM_PropagationBlocked(benchmark::State& state)
+{
+    const auto size = static_cast<uint16_t>(state.range(0));
+    Propagation p(size);
+    mart::ThreadPool pool(static_cast<unsigned>(state.range(1) - 1));
+    for (auto _ : state) {
+        mart::multiply(p.F, p.P, p.FP, pool);
+        mart::multiply(p.FP, mart::transposed(p.F), p.FPFT, pool);
+        benchmark::ClobberMemory();
+    }
+    setFlops(state, size);
+}
+
+BENCHMARK(BM_PropagationPlain)->RangeMultiplier(2)->Range(32, 512)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_PropagationBlocked)
+    ->ArgsProduct({{32, 64, 128, 256, 512, 1024}, {1, 2, 4}})
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime();
+
+}  // namespace
@@ -0,0 +1,109 @@
+#include <kernels.h>
+#include <matrix.h>
+#include <benchmark/benchmark.h>
+
+namespace
+{
+
+template <uint16_t size, class Layout = mart::alloc::Dense>
+mart::alloc::Matrix<float, size, size, Layout> filled(float seed)
+{
+    mart::alloc::Matrix<float, size, size, Layout> m;
+    for (uint16_t row = 0; row < size; ++row) {
+        for (uint16_t col = 0; col < size; ++col) {
+            m(row, col) = seed + row - 0.5f * col;
+        }
+    }
+    return m;
+}
+
+template <uint16_t size>
+void BM_MultiplyGeneric(benchmark::State& state)
+{
+    auto a = filled<size>(1);
+    auto b = filled<size>(2);
+    mart::alloc::Matrix<float, size, size> c;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(a.raw());
+        benchmark::DoNotOptimize(b.raw());
+        mart::kernel::multiplyGeneric<float, size, size, size>(
+            a.raw(), a.stride(), b.raw(), b.stride(), c.raw(), size);
+        benchmark::ClobberMemory();
+    }
+}
+
+template <uint16_t size>
+void BM_MultiplyUnrolled(benchmark::State& state)
+{
+    auto a = filled<size>(1);
+    auto b = filled<size>(2);
+    mart::alloc::Matrix<float, size, size> c;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(a.raw());
+        benchmark::DoNotOptimize(b.raw());
+        mart::kernel::multiplyUnrolled<float, size, size, size>(
+            a.raw(), a.stride(), b.raw(), b.stride(), c.raw(), size);
+        benchmark::ClobberMemory();
+    }
+}
+
+template <uint16_t size>
+void BM_MultiplyVectorGeneric(benchmark::State& state)
+{
+    auto a = filled<size>(1);
+    mart::alloc::Vector<float, size> x, y;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(a.raw());
+        benchmark::DoNotOptimize(x.raw());
+        mart::kernel::multiplyVectorGeneric<float, size, size>(
+            a.raw(), a.stride(), x.raw(), x.stride(), y.raw());
+        benchmark::ClobberMemory();
+    }
+}
+
+template <uint16_t size>
+void BM_MultiplyVectorUnrolled(benchmark::State& state)
+{
+    auto a = filled<size>(1);
+    mart::alloc::Vector<float, size> x, y;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(a.raw());
+        benchmark::DoNotOptimize(x.raw());
+        mart::kernel::multiplyVectorUnrolled<float, size, size>(
+            a.raw(), a.stride(), x.raw(), x.stride(), y.raw());
+        benchmark::ClobberMemory();
+    }
+}
+
+// Same product on dense rows and on rows padded to 32 bytes
+template <uint16_t size, class Layout>
+void BM_MultiplyLayout(benchmark::State& state)
+{
+    auto a = filled<size, Layout>(1);
+    auto b = filled<size, Layout>(2);
+    mart::alloc::Matrix<float, size, size, Layout> c;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(a.raw());
+        benchmark::DoNotOptimize(b.raw());
+        mart::kernel::multiplyGeneric<float, size, size, size>(
+            a.raw(), a.stride(), b.raw(), b.stride(), c.raw(), c.stride());
+        benchmark::ClobberMemory();
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_MultiplyGeneric, 2);
+BENCHMARK_TEMPLATE(BM_MultiplyUnrolled, 2);
+BENCHMARK_TEMPLATE(BM_MultiplyGeneric, 3);
+BENCHMARK_TEMPLATE(BM_MultiplyUnrolled, 3);
+BENCHMARK_TEMPLATE(BM_MultiplyGeneric, 4);
+BENCHMARK_TEMPLATE(BM_MultiplyUnrolled, 4);
+BENCHMARK_TEMPLATE(BM_MultiplyVectorGeneric, 3);
+BENCHMARK_TEMPLATE(BM_MultiplyVectorUnrolled, 3);
+BENCHMARK_TEMPLATE(BM_MultiplyVectorGeneric, 4);
+BENCHMARK_TEMPLATE(BM_MultiplyVectorUnrolled, 4);
+BENCHMARK_TEMPLATE(BM_MultiplyLayout, 12, mart::alloc::Dense);
+BENCHMARK_TEMPLATE(BM_MultiplyLayout, 12, mart::alloc::Aligned<32>);
+
+}  // namespace
+
+BENCHMARK_MAIN();
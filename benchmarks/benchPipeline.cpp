@@ -0,0 +1,62 @@
+#include <OrientationEstimator.h>
+#include <pipeline.h>
+#include <replay.h>
+#include <benchmark/benchmark.h>
+#include <cstdio>
+
+namespace
+{
+
+constexpr uint32_t CYCLE_COUNTER_HZ = 72000000;
+const char* const LOG_PATH = "benchPipeline.log";
+
+// One second of the board's streams: gyroscope at 760 Hz, accelerometer at
+// 400 Hz and magnetometer at 75 Hz, a slow turn around z
+void writeLog()
+{
+    std::FILE* file = std::fopen(LOG_PATH, "wb");
+    const uint32_t rates[3] = {760, 400, 75};
+    uint32_t next[3] = {0, 0, 0};
+    for (uint32_t tick = 0; tick < CYCLE_COUNTER_HZ; tick += 1000) {
+        for (uint8_t sensor = 0; sensor < 3; ++sensor) {
+            if (tick < next[sensor]) {
+                continue;
+            }
+            next[sensor] += CYCLE_COUNTER_HZ / rates[sensor];
+            const Vector3 values[3] = {{0, 0, 1000}, {0, 0, 1333}, {300, 0, -400}};
+            mart::ReplaySensor::writeRecord(
+                file, {tick, values[sensor], static_cast<SensorId>(sensor)});
+        }
+    }
+    std::fclose(file);
+}
+
+// L3GD20 at 250 dps, LSM303DLHC at +-16 g high resolution and 1.3 gauss
+const mart::SampleFusion<mart::orient::OrientationEstimator>::Scales SCALES = {
+    {{1.527e-4f, 1.527e-4f, 1.527e-4f},
+     {7.5e-4f, 7.5e-4f, 7.5e-4f},
+     {1 / 1100.0f, 1 / 1100.0f, 1 / 980.0f}}};
+
+// Replays the log at full speed through the fusion into the filter
+void BM_ReplayPipeline(benchmark::State& state)
+{
+    writeLog();
+    uint32_t samples = 0;
+    for (auto _ : state) {
+        mart::ReplaySensor replay;
+        replay.configure({LOG_PATH, CYCLE_COUNTER_HZ, false});
+        mart::orient::OrientationEstimator estimator(CYCLE_COUNTER_HZ);
+        mart::SampleFusion<mart::orient::OrientationEstimator> fusion(estimator, SCALES);
+        samples = mart::drain(replay, [&](const RawSample* burst, uint32_t count) {
+            fusion.consume(burst, count);
+        });
+        benchmark::DoNotOptimize(estimator.state()[0]);
+    }
+    state.counters["samples/s"] = benchmark::Counter(
+        samples, benchmark::Counter::kIsIterationInvariantRate);
+    std::remove(LOG_PATH);
+}
+
+BENCHMARK(BM_ReplayPipeline)->Unit(benchmark::kMillisecond);
+
+}  // namespace
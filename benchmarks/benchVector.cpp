@@ -0,0 +1,90 @@
+#include <matrix.h>
+#include <vector.h>
+#include <benchmark/benchmark.h>
+
+namespace
+{
+
+using Vec3 = mart::alloc::Vector<float, 3>;
+
+// Rotation part of one OrientationEstimator process step: g and m are
+// both moved by w x v * dt
+
+mart::alloc::Matrix<float, 3, 3> skewMatrix(const mart::Vector<float, 3>& w)
+{
+    // clang-format off
+    return {
+        0, -w[2], w[1],
+        w[2], 0, -w[0],
+        -w[1], w[0], 0
+    };
+    // clang-format on
+}
+
+void BM_RotateSkewMatrix(benchmark::State& state)
+{
+    Vec3 w{0.1f, -0.2f, 0.3f}, g{0, 0, 9.81f}, m{0.2f, 0.4f, -0.1f};
+    const float dt = 0.01f;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(w.raw());
+        const auto rotM = skewMatrix(w);
+        const auto gNext = g + rotM * g * dt;
+        const auto mNext = m + rotM * m * dt;
+        benchmark::DoNotOptimize(gNext.raw());
+        benchmark::DoNotOptimize(mNext.raw());
+    }
+}
+
+void BM_RotateCross(benchmark::State& state)
+{
+    Vec3 w{0.1f, -0.2f, 0.3f}, g{0, 0, 9.81f}, m{0.2f, 0.4f, -0.1f};
+    const float dt = 0.01f;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(w.raw());
+        Vec3 gNext, mNext;
+        mart::cross(w, g, gNext);
+        mart::cross(w, m, mNext);
+        for (uint16_t i = 0; i < 3; ++i) {
+            gNext[i] = g[i] + gNext[i] * dt;
+            mNext[i] = m[i] + mNext[i] * dt;
+        }
+        benchmark::DoNotOptimize(gNext.raw());
+        benchmark::DoNotOptimize(mNext.raw());
+    }
+}
+
+void BM_JacobianBlockSkewMatrix(benchmark::State& state)
+{
+    Vec3 g{0, 0, 9.81f};
+    mart::alloc::Matrix<float, 3, 3> block;
+    const float dt = 0.01f;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(g.raw());
+        block = skewMatrix(g) * (-dt);
+        benchmark::DoNotOptimize(block.raw());
+    }
+}
+
+void BM_JacobianBlockSkewView(benchmark::State& state)
+{
+    Vec3 g{0, 0, 9.81f};
+    mart::alloc::Matrix<float, 3, 3> block;
+    const float dt = 0.01f;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(g.raw());
+        const auto rot = mart::skew(g) * (-dt);
+        for (uint16_t row = 0; row < 3; ++row) {
+            for (uint16_t col = 0; col < 3; ++col) {
+                block(row, col) = rot(row, col);
+            }
+        }
+        benchmark::DoNotOptimize(block.raw());
+    }
+}
+
+BENCHMARK(BM_RotateSkewMatrix);
+BENCHMARK(BM_RotateCross);
+BENCHMARK(BM_JacobianBlockSkewMatrix);
+BENCHMARK(BM_JacobianBlockSkewView);
+
+}  // namespace
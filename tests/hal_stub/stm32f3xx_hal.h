@@ -0,0 +1,246 @@
+#ifndef STM32F3XX_HAL_H
+#define STM32F3XX_HAL_H
+
+/*
+Host stand-in for the parts of the STM32F3 HAL the sensor drivers use, so
+they can be tested without the board. The I2C handle carries a register
+file per 7-bit device address and counts the bus transactions, each of
+which costs a start condition, the device and register addresses and the
+data on the real bus. The SPI handle carries the register file of the one
+device on its chip select. The DMA variants complete immediately; the test
+plays the part of the completion interrupt. Setting failures makes that
+many of the following transfers fail, as on a NACK or a stuck bus. The
+tick, which doubles as the drivers' sample clock, and the GPIO input
+levels are plain variables the test sets.
+*/
+
+#include <cstdint>
+
+typedef enum {
+    HAL_OK      = 0x00U,
+    HAL_ERROR   = 0x01U,
+    HAL_BUSY    = 0x02U,
+    HAL_TIMEOUT = 0x03U
+} HAL_StatusTypeDef;
+
+typedef enum {
+    GPIO_PIN_RESET = 0U,
+    GPIO_PIN_SET
+} GPIO_PinState;
+
+struct GPIO_TypeDef {
+    uint16_t levels;
+    uint32_t writes;
+};
+
+inline GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin)
+{
+    return (GPIOx->levels & GPIO_Pin) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
+
+inline void HAL_GPIO_WritePin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState)
+{
+    GPIOx->levels = PinState == GPIO_PIN_SET ? (GPIOx->levels | GPIO_Pin)
+                                             : (GPIOx->levels & ~GPIO_Pin);
+    ++GPIOx->writes;
+}
+
+inline uint32_t& halStubTick()
+{
+    static uint32_t tick = 0;
+    return tick;
+}
+
+inline uint32_t HAL_GetTick(void)
+{
+    return halStubTick();
+}
+
+// No interrupts on the host, the critical sections are no-ops
+inline uint32_t __get_PRIMASK(void) { return 0; }
+inline void __set_PRIMASK(uint32_t) {}
+inline void __disable_irq(void) {}
+
+struct HalStubI2cDevice {
+    uint8_t registers[128];
+    // The LSM303DLHC accelerometer only moves its register pointer when
+    // the MSB of the sub-address is set, the magnetometer always does
+    bool incrementOnMsb;
+    // Sensors with a FIFO move the pointer from wrapAt back to wrapTo
+    // during a burst, unused while both are 0
+    uint8_t wrapAt;
+    uint8_t wrapTo;
+};
+
+struct I2C_HandleTypeDef {
+    HalStubI2cDevice devices[128];
+    uint32_t transactions;
+    uint32_t bytes;
+    uint32_t failures;
+    uint32_t aborts;
+    // Returned by HAL_I2C_Master_Abort_IT, the HAL refuses to abort
+    // memory-mode transfers with HAL_ERROR
+    HAL_StatusTypeDef abortStatus;
+};
+
+inline HalStubI2cDevice& halStubDevice(I2C_HandleTypeDef* hi2c, uint16_t devAddress)
+{
+    return hi2c->devices[(devAddress >> 1) & 0x7F];
+}
+
+inline HAL_StatusTypeDef halStubTransfer(I2C_HandleTypeDef* hi2c, uint16_t devAddress,
+                                         uint16_t memAddress, uint8_t* pData,
+                                         uint16_t size, bool read)
+{
+    if (hi2c->failures > 0) {
+        --hi2c->failures;
+        return HAL_ERROR;
+    }
+
+    HalStubI2cDevice& device = halStubDevice(hi2c, devAddress);
+    bool increment = true;
+    if (device.incrementOnMsb) {
+        increment = (memAddress & 0x80) != 0;
+        memAddress &= 0x7F;
+    }
+
+    ++hi2c->transactions;
+    hi2c->bytes += size;
+    for (uint16_t i = 0; i < size; ++i) {
+        uint8_t& reg = device.registers[memAddress & 0x7F];
+        if (read) {
+            pData[i] = reg;
+        } else {
+            reg = pData[i];
+        }
+        if (increment) {
+            const bool wrap = device.wrapAt != 0 && memAddress == device.wrapAt;
+            memAddress = wrap ? device.wrapTo : memAddress + 1;
+        }
+    }
+    return HAL_OK;
+}
+
+inline HAL_StatusTypeDef HAL_I2C_Mem_Read(I2C_HandleTypeDef* hi2c, uint16_t DevAddress,
+                                          uint16_t MemAddress, uint16_t /*MemAddSize*/,
+                                          uint8_t* pData, uint16_t Size, uint32_t /*Timeout*/)
+{
+    return halStubTransfer(hi2c, DevAddress, MemAddress, pData, Size, true);
+}
+
+inline HAL_StatusTypeDef HAL_I2C_Mem_Write(I2C_HandleTypeDef* hi2c, uint16_t DevAddress,
+                                           uint16_t MemAddress, uint16_t /*MemAddSize*/,
+                                           uint8_t* pData, uint16_t Size, uint32_t /*Timeout*/)
+{
+    return halStubTransfer(hi2c, DevAddress, MemAddress, pData, Size, false);
+}
+
+inline HAL_StatusTypeDef HAL_I2C_Mem_Read_DMA(I2C_HandleTypeDef* hi2c, uint16_t DevAddress,
+                                              uint16_t MemAddress, uint16_t /*MemAddSize*/,
+                                              uint8_t* pData, uint16_t Size)
+{
+    return halStubTransfer(hi2c, DevAddress, MemAddress, pData, Size, true);
+}
+
+inline HAL_StatusTypeDef HAL_I2C_Master_Abort_IT(I2C_HandleTypeDef* hi2c, uint16_t /*DevAddress*/)
+{
+    ++hi2c->aborts;
+    return hi2c->abortStatus;
+}
+
+// An SPI device addressed like the L3GD20: the first byte of a transaction
+// holds the register address, the read bit (MSB) and the auto-increment
+// bit (0x40)
+struct HalStubSpiDevice {
+    uint8_t registers[64];
+    // See HalStubI2cDevice
+    uint8_t wrapAt;
+    uint8_t wrapTo;
+};
+
+// A transaction starts with the first transfer after a write to csPort,
+// i.e. after the driver has toggled its chip select
+struct SPI_HandleTypeDef {
+    HalStubSpiDevice device;
+    GPIO_TypeDef* csPort;
+    uint32_t transactions;
+    uint32_t bytes;
+    uint32_t failures;
+    uint32_t aborts;
+
+    // Address phase of the current transaction
+    uint32_t csWrites;
+    uint8_t address;
+    bool reading;
+    bool increment;
+};
+
+// tx or rx may be nullptr for one-way transfers
+inline HAL_StatusTypeDef halStubSpiTransfer(SPI_HandleTypeDef* hspi, const uint8_t* tx,
+                                            uint8_t* rx, uint16_t size)
+{
+    if (hspi->failures > 0) {
+        --hspi->failures;
+        return HAL_ERROR;
+    }
+
+    uint16_t i = 0;
+    if (hspi->transactions == 0 || hspi->csPort->writes != hspi->csWrites) {
+        if (tx == nullptr || size == 0) {
+            return HAL_ERROR;
+        }
+        ++hspi->transactions;
+        hspi->csWrites = hspi->csPort->writes;
+        hspi->address = tx[0] & 0x3F;
+        hspi->reading = (tx[0] & 0x80) != 0;
+        hspi->increment = (tx[0] & 0x40) != 0;
+        if (rx != nullptr) {
+            rx[0] = 0xFF;
+        }
+        i = 1;
+    }
+
+    HalStubSpiDevice& device = hspi->device;
+    hspi->bytes += size;
+    for (; i < size; ++i) {
+        uint8_t& reg = device.registers[hspi->address];
+        if (hspi->reading) {
+            if (rx != nullptr) {
+                rx[i] = reg;
+            }
+        } else if (tx != nullptr) {
+            reg = tx[i];
+        }
+        if (hspi->increment) {
+            const bool wrap = device.wrapAt != 0 && hspi->address == device.wrapAt;
+            hspi->address = wrap ? device.wrapTo : (hspi->address + 1) & 0x3F;
+        }
+    }
+    return HAL_OK;
+}
+
+inline HAL_StatusTypeDef HAL_SPI_Transmit(SPI_HandleTypeDef* hspi, uint8_t* pData,
+                                          uint16_t Size, uint32_t /*Timeout*/)
+{
+    return halStubSpiTransfer(hspi, pData, nullptr, Size);
+}
+
+inline HAL_StatusTypeDef HAL_SPI_Receive(SPI_HandleTypeDef* hspi, uint8_t* pData,
+                                         uint16_t Size, uint32_t /*Timeout*/)
+{
+    return halStubSpiTransfer(hspi, nullptr, pData, Size);
+}
+
+inline HAL_StatusTypeDef HAL_SPI_TransmitReceive_DMA(SPI_HandleTypeDef* hspi, uint8_t* pTxData,
+                                                     uint8_t* pRxData, uint16_t Size)
+{
+    return halStubSpiTransfer(hspi, pTxData, pRxData, Size);
+}
+
+inline HAL_StatusTypeDef HAL_SPI_Abort(SPI_HandleTypeDef* hspi)
+{
+    ++hspi->aborts;
+    return HAL_OK;
+}
+
+#endif /* STM32F3XX_HAL_H */
@@ -0,0 +1,44 @@
+#include <clock.h>
+#include <gtest/gtest.h>
+
+namespace
+{
+
+using mart::CounterTime;
+
+TEST(CounterTimeTest, intervals_across_wrap)
+{
+    const CounterTime time(72000000);
+    EXPECT_EQ(CounterTime::ticksBetween(0xFFFFFF00u, 0x100u), 0x200u);
+    EXPECT_DOUBLE_EQ(time.secondsBetween<double>(0xFFFFFFFFu - 35999999u, 36000000u), 1.0);
+    EXPECT_FLOAT_EQ(time.secondsBetween<float>(1000, 1000 + 720000), 0.01f);
+}
+
+TEST(CounterTimeTest, order_across_wrap)
+{
+    EXPECT_TRUE(CounterTime::isBefore(0xFFFFFF00u, 0x100u));
+    EXPECT_FALSE(CounterTime::isBefore(0x100u, 0xFFFFFF00u));
+    EXPECT_TRUE(CounterTime::isBefore(10, 20));
+    EXPECT_FALSE(CounterTime::isBefore(20, 20));
+}
+
+TEST(CounterTimeTest, extend_counts_wraps)
+{
+    CounterTime time(1000);
+    EXPECT_EQ(time.extend(0xFFFFFFF0u), 0xFFFFFFF0u);
+    EXPECT_EQ(time.extend(0x10u), 0x100000010u);
+    EXPECT_EQ(time.extend(0x20u), 0x100000020u);
+    EXPECT_DOUBLE_EQ(time.seconds<double>(time.extend(0x30u)) * 1000, 0x100000030u);
+}
+
+TEST(CounterTimeTest, interpolate_batch)
+{
+    // Four samples between watermarks 1024 ticks apart, across the wrap
+    const uint32_t from = 0xFFFFFE00u;
+    const uint32_t to = from + 1024;
+    EXPECT_EQ(CounterTime::interpolate(from, to, 0, 4), from + 256);
+    EXPECT_EQ(CounterTime::interpolate(from, to, 1, 4), 0x0u);
+    EXPECT_EQ(CounterTime::interpolate(from, to, 3, 4), to);
+}
+
+}  // namespace
@@ -0,0 +1,151 @@
+#include <dynkalman.h>
+#include <extkalman.h>
+#include <gtest/gtest.h>
+#include <vector>
+
+namespace
+{
+
+// Position and velocity with a position measurement, run through the fixed
+// and the runtime-sized filter
+using EKF = mart::ExtendedKalmanFilter<double, 2, 1>;
+using DynEKF = mart::DynamicExtendedKalmanFilter<double>;
+
+template <class State>
+void constantVelocity(State& next, const State& x, double dt)
+{
+    next[0] = x[0] + x[1] * dt;
+    next[1] = x[1];
+}
+
+template <class State, class Jacobian>
+void constantVelocityJacobian(const State&, Jacobian& F, double dt)
+{
+    F(0, 0) = 1;
+    F(0, 1) = dt;
+    F(1, 0) = 0;
+    F(1, 1) = 1;
+}
+
+template <class State, class Measurement>
+void position(const State& x, Measurement& z, double)
+{
+    z[0] = x[0];
+}
+
+template <class State, class Jacobian>
+void positionJacobian(const State&, Jacobian& H, double)
+{
+    H(0, 0) = 1;
+    H(0, 1) = 0;
+}
+
+TEST(DynamicExtendedKalmanFilterTest, matches_fixed_size_filter)
+{
+    const mart::alloc::Matrix<double, 2, 2> R{0.01, 0, 0, 0.1};
+    const mart::alloc::Matrix<double, 1, 1> Q{0.5};
+    const mart::alloc::Vector<double, 2> mu{0, 1};
+    const mart::alloc::Matrix<double, 2, 2> Sigma{1, 0, 0, 1};
+
+    EKF fixed(&constantVelocity<EKF::State>,
+              &constantVelocityJacobian<EKF::State, EKF::ProcessMatrix>,
+              R,
+              &position<EKF::State, EKF::Measurement>,
+              &positionJacobian<EKF::State, EKF::MeasurementMatrix>,
+              Q);
+    EKF::Workspace fixedWs;
+    fixed.reset(mu, Sigma);
+
+    const std::size_t bytes = DynEKF::requiredBytes(2, 1) +
+                              DynEKF::Workspace::requiredBytes(2, 1);
+    std::vector<unsigned char> buffer(bytes);
+    mart::Arena arena(buffer.data(), buffer.size());
+    DynEKF dynamic(arena, 2, 1,
+                   &constantVelocity<DynEKF::State>,
+                   &constantVelocityJacobian<DynEKF::State, DynEKF::ProcessMatrix>,
+                   mart::DynMatrix<double>(R),
+                   &position<DynEKF::State, DynEKF::Measurement>,
+                   &positionJacobian<DynEKF::State, DynEKF::MeasurementMatrix>,
+                   mart::DynMatrix<double>(Q));
+    DynEKF::Workspace dynamicWs(arena, 2, 1);
+    ASSERT_TRUE(dynamic.valid());
+    ASSERT_TRUE(dynamicWs.valid());
+    ASSERT_TRUE(dynamic.reset(mart::DynVector<double>(mu), mart::DynMatrix<double>(Sigma)));
+
+    const double measurements[] = {0.12, 0.19, 0.33, 0.38, 0.52};
+    for (double z : measurements) {
+        const mart::alloc::Vector<double, 1> zFixed{z};
+        fixed.update(zFixed, 0.1, fixedWs);
+        dynamic.update(mart::DynVector<double>(zFixed), 0.1, dynamicWs);
+
+        for (uint16_t i = 0; i < 2; ++i) {
+            EXPECT_NEAR(dynamic.state()[i], fixed.state()[i], 1e-12);
+            for (uint16_t j = 0; j < 2; ++j) {
+                EXPECT_NEAR(dynamic.covariance()(i, j), fixed.covariance()(i, j), 1e-12);
+            }
+        }
+        EXPECT_NEAR(dynamic.logLikelihood(), fixed.logLikelihood(), 1e-12);
+    }
+}
+
+TEST(DynamicExtendedKalmanFilterTest, sparse_correction_matches_dense)
+{
+    const mart::alloc::Matrix<double, 2, 2> R{0.01, 0, 0, 0.1};
+    const mart::alloc::Matrix<double, 1, 1> Q{0.5};
+    const mart::alloc::Vector<double, 2> mu{0, 1};
+    const mart::alloc::Matrix<double, 2, 2> Sigma{1, 0.2, 0.2, 1};
+
+    mart::StaticArena<4096> arena;
+    auto makeFilter = [&] {
+        return DynEKF(arena, 2, 1,
+                      &constantVelocity<DynEKF::State>,
+                      &constantVelocityJacobian<DynEKF::State, DynEKF::ProcessMatrix>,
+                      mart::DynMatrix<double>(R),
+                      &position<DynEKF::State, DynEKF::Measurement>,
+                      &positionJacobian<DynEKF::State, DynEKF::MeasurementMatrix>,
+                      mart::DynMatrix<double>(Q));
+    };
+    DynEKF dense = makeFilter();
+    DynEKF sparse = makeFilter();
+    DynEKF::Workspace ws(arena, 2, 1);
+    ASSERT_TRUE(dense.valid() && sparse.valid() && ws.valid());
+    dense.reset(mart::DynVector<double>(mu), mart::DynMatrix<double>(Sigma));
+    sparse.reset(mart::DynVector<double>(mu), mart::DynMatrix<double>(Sigma));
+
+    auto coo = mart::CooMatrix<double>::allocate(arena, 1, 2, 1);
+    coo.insert(0, 0, 1);
+    const auto H = mart::CsrMatrix<double>::fromCoo(arena, coo);
+
+    const double measurements[] = {0.12, 0.19, 0.33};
+    for (double z : measurements) {
+        const mart::alloc::Vector<double, 1> zFixed{z};
+        dense.update(mart::DynVector<double>(zFixed), 0.1, ws);
+        sparse.predict(0.1, ws);
+        sparse.correct(mart::DynVector<double>(zFixed), 0.1, H, ws);
+
+        for (uint16_t i = 0; i < 2; ++i) {
+            EXPECT_NEAR(sparse.state()[i], dense.state()[i], 1e-12);
+            for (uint16_t j = 0; j < 2; ++j) {
+                EXPECT_NEAR(sparse.covariance()(i, j), dense.covariance()(i, j), 1e-12);
+            }
+        }
+        EXPECT_NEAR(sparse.logLikelihood(), dense.logLikelihood(), 1e-12);
+    }
+}
+
+TEST(DynamicExtendedKalmanFilterTest, arena_too_small)
+{
+    mart::StaticArena<64> arena;
+    const mart::alloc::Matrix<double, 4, 4> R;
+    const mart::alloc::Matrix<double, 2, 2> Q;
+    DynEKF filter(arena, 4, 2,
+                  &constantVelocity<DynEKF::State>,
+                  &constantVelocityJacobian<DynEKF::State, DynEKF::ProcessMatrix>,
+                  mart::DynMatrix<double>(R),
+                  &position<DynEKF::State, DynEKF::Measurement>,
+                  &positionJacobian<DynEKF::State, DynEKF::MeasurementMatrix>,
+                  mart::DynMatrix<double>(Q));
+    EXPECT_FALSE(filter.valid());
+}
+
+}  // namespace
@@ -0,0 +1,124 @@
+#include <dynmatrix.h>
+#include <gtest/gtest.h>
+
+namespace
+{
+
+using mart::DynMatrix;
+using mart::DynVector;
+
+TEST(ArenaTest, allocate_until_exhausted)
+{
+    mart::StaticArena<64> arena;
+    double* a = arena.allocate<double>(4);
+    ASSERT_NE(a, nullptr);
+    EXPECT_EQ(a[3], 0);
+    EXPECT_EQ(arena.used(), 32u);
+
+    char* c = arena.allocate<char>(1);
+    ASSERT_NE(c, nullptr);
+    float* f = arena.allocate<float>(2);
+    ASSERT_NE(f, nullptr);
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(f) % alignof(float), 0u);
+
+    EXPECT_EQ(arena.allocate<double>(4), nullptr);
+    arena.reset();
+    EXPECT_NE(arena.allocate<double>(8), nullptr);
+}
+
+TEST(DynMatrixTest, allocate_and_access)
+{
+    mart::StaticArena<256> arena;
+    auto A = DynMatrix<int>::allocate(arena, 2, 3);
+    ASSERT_TRUE(A.valid());
+    EXPECT_EQ(A.rows(), 2);
+    EXPECT_EQ(A.cols(), 3);
+    EXPECT_EQ(A(1, 2), 0);
+
+    A(1, 2) = 5;
+    EXPECT_EQ(A.col(2)[1], 5);
+    EXPECT_EQ(A.row(1)[2], 5);
+
+    const auto tooLarge = DynMatrix<int>::allocate(arena, 100, 100);
+    EXPECT_FALSE(tooLarge.valid());
+}
+
+TEST(DynMatrixTest, multiply)
+{
+    mart::StaticArena<512> arena;
+    const mart::alloc::Matrix<int, 2, 3> fixedA = {
+        1, 2, 3,
+        4, 5, 6
+    };
+    const mart::alloc::Matrix<int, 2, 3> fixedB = {
+        1, 0, -1,
+        2, 1, 0
+    };
+    const DynMatrix<int> A(fixedA);
+    const DynMatrix<int> B(fixedB);
+
+    auto C = DynMatrix<int>::allocate(arena, 2, 2);
+    ASSERT_TRUE(mart::multiply(A, mart::transposed(B), C));
+    const auto expected = fixedA * mart::transposed(fixedB);
+    for (uint16_t row = 0; row < 2; ++row) {
+        for (uint16_t col = 0; col < 2; ++col) {
+            EXPECT_EQ(C(row, col), expected(row, col));
+        }
+    }
+
+    auto wrong = DynMatrix<int>::allocate(arena, 3, 3);
+    EXPECT_FALSE(mart::multiply(A, B, wrong));
+
+    auto y = DynVector<int>::allocate(arena, 2);
+    ASSERT_TRUE(mart::multiply(A, B.row(1), y));
+    EXPECT_EQ(y[0], 4);
+    EXPECT_EQ(y[1], 13);
+}
+
+TEST(DynMatrixTest, add_subtract_inverse)
+{
+    mart::StaticArena<512> arena;
+    const mart::alloc::Matrix<double, 3, 3> fixedA = {
+        4, 3, 0,
+        6, 3, 1,
+        0, 2, 5
+    };
+    const DynMatrix<double> A(fixedA);
+
+    auto L = DynMatrix<double>::allocate(arena, 3, 3);
+    auto U = DynMatrix<double>::allocate(arena, 3, 3);
+    auto inv = DynMatrix<double>::allocate(arena, 3, 3);
+    ASSERT_TRUE(mart::luDecompose(A, L, U));
+    ASSERT_TRUE(mart::luInverse(L, U, inv));
+    const auto expected = fixedA.inverse();
+    for (uint16_t row = 0; row < 3; ++row) {
+        for (uint16_t col = 0; col < 3; ++col) {
+            EXPECT_NEAR(inv(row, col), expected(row, col), 1e-12);
+        }
+    }
+
+    auto sum = DynMatrix<double>::allocate(arena, 3, 3);
+    ASSERT_TRUE(mart::add(A, A, sum));
+    ASSERT_TRUE(mart::subtract(sum, A, sum));
+    EXPECT_EQ(sum(2, 2), 5);
+}
+
+TEST(DynMatrixTest, fixed_views)
+{
+    mart::StaticArena<256> arena;
+    auto D = DynMatrix<float>::allocate(arena, 3, 3);
+    D.setIdentity();
+
+    auto block = D.submat(1, 1, 2, 2).fixed<2, 2>();
+    ASSERT_NE(block.raw(), nullptr);
+    block(0, 1) = 7;
+    EXPECT_EQ(D(1, 2), 7);
+    EXPECT_EQ(block(1, 1), 1);
+
+    EXPECT_EQ((D.fixed<2, 3>().raw()), nullptr);
+
+    const auto diag = D.diag().fixed<3>();
+    EXPECT_EQ(diag[2], 1);
+}
+
+}  // namespace
@@ -0,0 +1,145 @@
+#include <extkalman.h>
+#include <gtest/gtest.h>
+#include <cmath>
+
+namespace
+{
+
+using EKF = mart::ExtendedKalmanFilter<float, 1, 1>;
+
+EKF randomWalk(float processNoise, float measurementNoise)
+{
+    return EKF(
+        [](EKF::State& next, const EKF::State& current, float) {
+            next[0] = current[0];
+        },
+        [](const EKF::State&, EKF::ProcessMatrix& F, float) { F(0, 0) = 1; },
+        mart::alloc::Matrix<float, 1, 1>{processNoise},
+        [](const EKF::State& x, EKF::Measurement& z, float) { z[0] = x[0]; },
+        [](const EKF::State&, EKF::MeasurementMatrix& H, float) {
+            H(0, 0) = 1;
+        },
+        mart::alloc::Matrix<float, 1, 1>{measurementNoise});
+}
+
+TEST(ExtendedKalmanFilterTest, update_random_walk)
+{
+    auto ekf = randomWalk(1, 2);
+    EKF::Workspace ws;
+    ekf.reset(mart::alloc::Vector<float, 1>{0},
+              mart::alloc::Matrix<float, 1, 1>{1});
+
+    ekf.update(mart::alloc::Vector<float, 1>{4}, 0.1f, ws);
+
+    EXPECT_FLOAT_EQ(ekf.priorCovariance()(0, 0), 2);
+    EXPECT_FLOAT_EQ(ekf.state()[0], 2);
+    EXPECT_FLOAT_EQ(ekf.covariance()(0, 0), 1);
+    EXPECT_FLOAT_EQ(ekf.innovation()[0], 4);
+    EXPECT_NEAR(ekf.logLikelihood(),
+                -0.5f * (std::log(2 * M_PI) + std::log(4.0f) + 4.0f), 1e-5f);
+}
+
+TEST(ExtendedKalmanFilterTest, workspace_keeps_process_jacobian)
+{
+    auto ekf = randomWalk(1, 2);
+    EKF::Workspace ws;
+    ekf.update(mart::alloc::Vector<float, 1>{1}, 0.1f, ws);
+    EXPECT_FLOAT_EQ(ws.F(0, 0), 1);
+}
+
+// x = (position, velocity) with a velocity-dependent drag, so that
+// F = | 1  dt   | has dt-only as well as state-dependent elements
+//     | 0  d(v) |
+struct SplitModel {
+    using Filter = mart::ExtendedKalmanFilter<float, 2, 1>;
+
+    static float damping(const Filter::State& x) { return 1 - 0.1f * x[1] * x[1]; }
+
+    Filter filter(bool split)
+    {
+        auto f = [](Filter::State& next, const Filter::State& x, float dt) {
+            next[0] = x[0] + x[1] * dt;
+            next[1] = x[1] - 0.1f * x[1] * x[1] * x[1] / 3;
+        };
+        auto full = [this](const Filter::State& x, Filter::ProcessMatrix& F, float dt) {
+            ++stateCalls;
+            F(0, 0) = 1;
+            F(0, 1) = dt;
+            F(1, 0) = 0;
+            F(1, 1) = damping(x);
+        };
+        auto stateOnly = [this](const Filter::State& x, Filter::ProcessMatrix& F, float) {
+            ++stateCalls;
+            F(1, 1) = damping(x);
+        };
+        auto constant = [this](Filter::ProcessMatrix& F, float dt) {
+            ++constantCalls;
+            F(0, 0) = 1;
+            F(0, 1) = dt;
+            F(1, 0) = 0;
+        };
+        auto h = [](const Filter::State& x, Filter::Measurement& z, float) { z[0] = x[0]; };
+        auto H = [](const Filter::State&, Filter::MeasurementMatrix& H, float) {
+            H(0, 0) = 1;
+            H(0, 1) = 0;
+        };
+        const mart::alloc::Matrix<float, 2, 2> R{0.01f, 0, 0, 0.1f};
+        const mart::alloc::Matrix<float, 1, 1> Q{0.5f};
+        if (split) {
+            return Filter(f, constant, stateOnly, R, h, H, Q);
+        }
+        return Filter(f, full, R, h, H, Q);
+    }
+
+    int constantCalls = 0;
+    int stateCalls = 0;
+};
+
+TEST(ExtendedKalmanFilterTest, constant_jacobian_blocks_cached_per_dt)
+{
+    SplitModel cachedModel, fullModel;
+    auto cached = cachedModel.filter(true);
+    auto full = fullModel.filter(false);
+    SplitModel::Filter::Workspace cachedWs, fullWs;
+    const mart::alloc::Vector<float, 2> mu{0, 1};
+    const mart::alloc::Matrix<float, 2, 2> Sigma{1, 0, 0, 1};
+    cached.reset(mu, Sigma);
+    full.reset(mu, Sigma);
+
+    const float dts[] = {0.1f, 0.1f, 0.1f, 0.2f, 0.2f};
+    float z = 0;
+    for (float dt : dts) {
+        z += dt;
+        cached.update(mart::alloc::Vector<float, 1>{z}, dt, cachedWs);
+        full.update(mart::alloc::Vector<float, 1>{z}, dt, fullWs);
+        for (uint16_t i = 0; i < 2; ++i) {
+            EXPECT_FLOAT_EQ(cached.state()[i], full.state()[i]);
+        }
+        EXPECT_FLOAT_EQ(cachedWs.F(0, 1), dt);
+    }
+    EXPECT_EQ(cachedModel.constantCalls, 2);
+    EXPECT_EQ(cachedModel.stateCalls, 5);
+}
+
+TEST(ExtendedKalmanFilterTest, constant_jacobian_blocks_survive_shared_workspace)
+{
+    SplitModel firstModel, secondModel;
+    auto first = firstModel.filter(true);
+    auto second = secondModel.filter(true);
+    SplitModel::Filter::Workspace ws;
+
+    // Stepped in turn as the models of an IMM, each filter computes its
+    // blocks once
+    for (int step = 0; step < 3; ++step) {
+        first.update(mart::alloc::Vector<float, 1>{0}, 0.1f, ws);
+        ws.F(0, 1) = 42;
+        second.update(mart::alloc::Vector<float, 1>{0}, 0.2f, ws);
+        EXPECT_FLOAT_EQ(ws.F(0, 1), 0.2f);
+    }
+    first.update(mart::alloc::Vector<float, 1>{0}, 0.1f, ws);
+    EXPECT_FLOAT_EQ(ws.F(0, 1), 0.1f);
+    EXPECT_EQ(firstModel.constantCalls, 1);
+    EXPECT_EQ(secondModel.constantCalls, 1);
+}
+
+}  // namespace
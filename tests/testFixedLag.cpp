@@ -0,0 +1,111 @@
+#include <extkalman.h>
+#include <fixedlag.h>
+#include <kalman.h>
+#include <rts.h>
+#include <gtest/gtest.h>
+#include <vector>
+
+namespace
+{
+
+using EKF = mart::ExtendedKalmanFilter<float, 2, 1>;
+using KF  = mart::KalmanFilter<float, 2, 1>;
+enum { Pos, Vel };
+
+const float dt = 0.1f;
+const mart::alloc::Matrix<float, 2, 2> A = {
+    1, dt,
+    0, 1
+};
+const mart::alloc::Matrix<float, 2, 2> R = {
+    1e-3f, 0,
+    0, 1e-2f
+};
+const mart::alloc::Matrix<float, 1, 2> C = {1, 0};
+const mart::alloc::Matrix<float, 1, 1> Q = {0.25f};
+const mart::alloc::Vector<float, 2> mu0{0, 0};
+const mart::alloc::Matrix<float, 2, 2> Sigma0 = {
+    1, 0,
+    0, 1
+};
+
+EKF constantVelocity()
+{
+    EKF ekf(
+        [](EKF::State& next, const EKF::State& current, float) {
+            const auto x = A * current;
+            next[Pos] = x[Pos];
+            next[Vel] = x[Vel];
+        },
+        [](const EKF::State&, EKF::ProcessMatrix& F, float) {
+            F = {1, dt, 0, 1};
+        },
+        R,
+        [](const EKF::State& x, EKF::Measurement& z, float) { z[0] = x[Pos]; },
+        [](const EKF::State&, EKF::MeasurementMatrix& H, float) { H = {1, 0}; },
+        Q);
+    ekf.reset(mu0, Sigma0);
+    return ekf;
+}
+
+float measurement(uint16_t k)
+{
+    return k * dt + (k % 3 ? 0.2f : -0.4f);
+}
+
+TEST(FixedLagSmootherTest, matches_rts_at_window_start)
+{
+    constexpr uint16_t lag   = 5;
+    constexpr uint16_t steps = 30;
+
+    mart::FixedLagSmoother<EKF, lag> fixedLag(constantVelocity());
+    mart::RtsSmoother<EKF> rts(steps, testing::TempDir() + "fixedlag.bin");
+    auto ekf = constantVelocity();
+    EKF::Workspace ws;
+
+    for (uint16_t k = 1; k <= steps; ++k) {
+        const mart::alloc::Vector<float, 1> z{measurement(k)};
+        fixedLag.update(z, dt);
+        ekf.update(z, dt, ws);
+        rts.record(ekf, ws);
+        EXPECT_EQ(fixedLag.ready(), k > lag);
+    }
+
+    mart::alloc::Vector<float, 2> mu;
+    mart::alloc::Matrix<float, 2, 2> Sigma;
+    rts.smooth([&](std::size_t t, const EKF::State& m,
+                   const EKF::ProcessMatrix& S) {
+        if (t == steps - 1 - lag) {
+            mu    = m;
+            Sigma = S;
+        }
+    });
+
+    mart::alloc::Matrix<float, 2, 2> fixedLagSigma;
+    fixedLag.covariance(fixedLagSigma);
+    EXPECT_NEAR(fixedLag.state()[Pos], mu[Pos], 1e-5f);
+    EXPECT_NEAR(fixedLag.state()[Vel], mu[Vel], 1e-5f);
+    for (uint16_t row = 0; row < 2; ++row) {
+        for (uint16_t col = 0; col < 2; ++col) {
+            EXPECT_NEAR(fixedLagSigma(row, col), Sigma(row, col), 1e-6f);
+        }
+    }
+}
+
+TEST(FixedLagSmootherTest, kalman_filter_matches_extended)
+{
+    KF kf(A, R, C, Q);
+    kf.reset(mu0, Sigma0);
+    mart::FixedLagSmoother<KF, 4> linear(kf);
+    mart::FixedLagSmoother<EKF, 4> extended(constantVelocity());
+
+    for (uint16_t k = 1; k <= 20; ++k) {
+        const mart::alloc::Vector<float, 1> z{measurement(k)};
+        linear.update(z);
+        extended.update(z, dt);
+        EXPECT_NEAR(linear.state()[Pos], extended.state()[Pos], 1e-5f);
+        EXPECT_NEAR(linear.state()[Vel], extended.state()[Vel], 1e-5f);
+    }
+}
+
+}  // namespace
@@ -0,0 +1,72 @@
+#include <gemm.h>
+#include <gtest/gtest.h>
+#include <vector>
+
+namespace
+{
+
+using mart::DynMatrix;
+
+void fill(DynMatrix<double>& m, double seed)
+{
+    for (uint16_t row = 0; row < m.rows(); ++row) {
+        for (uint16_t col = 0; col < m.cols(); ++col) {
+            m(row, col) = seed + 0.01 * row - 0.02 * col + ((row * 7 + col) % 5) * 0.1;
+        }
+    }
+}
+
+void expectNear(const DynMatrix<double>& a, const DynMatrix<double>& b)
+{
+    for (uint16_t row = 0; row < a.rows(); ++row) {
+        for (uint16_t col = 0; col < a.cols(); ++col) {
+            ASSERT_NEAR(a(row, col), b(row, col), 1e-9) << row << ", " << col;
+        }
+    }
+}
+
+TEST(GemmTest, matches_plain_product_on_uneven_sizes)
+{
+    // Sizes that leave partial tiles in every direction
+    const uint16_t m = 150, k = 200, n = 131;
+    std::vector<unsigned char> buffer(4 * 200 * 200 * sizeof(double) + 64);
+    mart::Arena arena(buffer.data(), buffer.size());
+    auto A = DynMatrix<double>::allocate(arena, m, k);
+    auto B = DynMatrix<double>::allocate(arena, n, k);
+    auto expected = DynMatrix<double>::allocate(arena, m, n);
+    auto C = DynMatrix<double>::allocate(arena, m, n);
+    fill(A, 1);
+    fill(B, -2);
+
+    // B is used transposed to exercise the strided packing
+    ASSERT_TRUE(mart::multiply(A, mart::transposed(B), expected));
+
+    mart::kernel::gemm<double>(m, k, n, mart::dynOperand(A).op,
+                               mart::dynOperand(mart::transposed(B)).op,
+                               C.raw(), C.stride());
+    expectNear(C, expected);
+
+    mart::ThreadPool pool(3);
+    C.fill(42);
+    ASSERT_TRUE(mart::multiply(A, mart::transposed(B), C, pool));
+    expectNear(C, expected);
+}
+
+TEST(GemmTest, small_products_stay_on_plain_loops)
+{
+    mart::StaticArena<1024> arena;
+    auto A = DynMatrix<double>::allocate(arena, 3, 4);
+    auto B = DynMatrix<double>::allocate(arena, 4, 2);
+    auto C = DynMatrix<double>::allocate(arena, 3, 2);
+    auto expected = DynMatrix<double>::allocate(arena, 3, 2);
+    fill(A, 1);
+    fill(B, 2);
+
+    mart::ThreadPool pool(1);
+    ASSERT_TRUE(mart::multiply(A, B, C, pool));
+    ASSERT_TRUE(mart::multiply(A, B, expected));
+    expectNear(C, expected);
+    EXPECT_FALSE(mart::multiply(B, A, C, pool));
+}
+
+}  // namespace
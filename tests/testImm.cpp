@@ -0,0 +1,136 @@
+#include <imm.h>
+#include <threadpool.h>
+#include <gtest/gtest.h>
+#include <chrono>
+#include <thread>
+
+namespace
+{
+
+using EKF = mart::ExtendedKalmanFilter<float, 2, 1>;
+enum { Pos, Vel };
+
+EKF makeModel(bool moving)
+{
+    auto measure = [](const EKF::State& x, EKF::Measurement& z, float) {
+        z[0] = x[Pos];
+    };
+    auto measureJacobian = [](const EKF::State&, EKF::MeasurementMatrix& H,
+                              float) {
+        H(0, Pos) = 1;
+        H(0, Vel) = 0;
+    };
+    auto process = [moving](EKF::State& next, const EKF::State& current,
+                            float dt) {
+        next[Pos] = current[Pos] + (moving ? current[Vel] * dt : 0);
+        next[Vel] = moving ? current[Vel] : 0;
+    };
+    auto processJacobian = [moving](const EKF::State&, EKF::ProcessMatrix& F,
+                                    float dt) {
+        F(Pos, Pos) = 1;
+        F(Pos, Vel) = moving ? dt : 0;
+        F(Vel, Pos) = 0;
+        F(Vel, Vel) = moving ? 1 : 0;
+    };
+    return EKF(process, processJacobian,
+               mart::alloc::Matrix<float, 2, 2>{1e-4f, 0, 0, 1e-3f}, measure,
+               measureJacobian, mart::alloc::Matrix<float, 1, 1>{1e-2f});
+}
+
+const mart::alloc::Matrix<float, 2, 2> transitions = {
+    0.95f, 0.05f,
+    0.05f, 0.95f
+};
+const mart::alloc::Vector<float, 2> initial{0.5f, 0.5f};
+
+template <class Imm>
+void track(Imm& imm, uint16_t steps)
+{
+    const float dt = 0.1f;
+    for (uint16_t k = 1; k <= steps; ++k) {
+        imm.update(mart::alloc::Vector<float, 1>{k * dt}, dt);
+    }
+}
+
+TEST(ImmTest, selects_moving_model)
+{
+    mart::InteractingMultipleModel<EKF, 2> imm({makeModel(false),
+                                                makeModel(true)},
+                                               transitions, initial);
+    track(imm, 100);
+
+    EXPECT_GT(imm.probabilities()[1], 0.9f);
+    EXPECT_NEAR(imm.probabilities()[0] + imm.probabilities()[1], 1, 1e-5f);
+    EXPECT_NEAR(imm.state()[Pos], 10, 0.05f);
+    EXPECT_NEAR(imm.state()[Vel], 1, 0.1f);
+}
+
+TEST(ImmTest, selects_static_model)
+{
+    mart::InteractingMultipleModel<EKF, 2> imm({makeModel(false),
+                                                makeModel(true)},
+                                               transitions, initial);
+    const float dt = 0.1f;
+    for (uint16_t k = 0; k < 100; ++k) {
+        imm.update(mart::alloc::Vector<float, 1>{3}, dt);
+    }
+
+    EXPECT_GT(imm.probabilities()[0], 0.6f);
+    EXPECT_NEAR(imm.state()[Pos], 3, 0.01f);
+}
+
+TEST(ImmTest, parallel_matches_sequential)
+{
+    using Parallel = mart::ParallelExecution<EKF::Workspace, 2>;
+    mart::InteractingMultipleModel<EKF, 2> sequential(
+        {makeModel(false), makeModel(true)}, transitions, initial);
+    mart::InteractingMultipleModel<EKF, 2, Parallel> parallel(
+        {makeModel(false), makeModel(true)}, transitions, initial);
+
+    track(sequential, 50);
+    track(parallel, 50);
+
+    EXPECT_FLOAT_EQ(sequential.probabilities()[1],
+                    parallel.probabilities()[1]);
+    EXPECT_FLOAT_EQ(sequential.state()[Pos], parallel.state()[Pos]);
+    EXPECT_FLOAT_EQ(sequential.covariance()(Vel, Vel),
+                    parallel.covariance()(Vel, Vel));
+}
+
+TEST(ThreadPoolTest, parallel_for_visits_every_index)
+{
+    mart::ThreadPool pool(3);
+    std::atomic<uint32_t> visits[64] = {};
+    for (int round = 0; round < 20; ++round) {
+        pool.parallelFor(64, [&](uint32_t i) { ++visits[i]; });
+    }
+    for (const auto& v : visits) {
+        EXPECT_EQ(v, 20u);
+    }
+}
+
+TEST(ThreadPoolTest, idle_threads_steal_from_a_slow_range)
+{
+    // Everything in the caller's range is slow, the workers finish theirs
+    // at once and have to take over the rest
+    mart::ThreadPool pool(3);
+    const uint32_t count = 32;
+    std::atomic<uint32_t> visits[count] = {};
+    std::atomic<uint32_t> stolen{0};
+    const auto caller = std::this_thread::get_id();
+    pool.parallelFor(count, [&](uint32_t i) {
+        if (i >= count * 3 / 4) {
+            if (std::this_thread::get_id() != caller) {
+                ++stolen;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+        ++visits[i];
+    });
+    for (const auto& v : visits) {
+        EXPECT_EQ(v, 1u);
+    }
+    EXPECT_GT(stolen, 0u);
+}
+
+}  // namespace
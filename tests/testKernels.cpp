@@ -0,0 +1,100 @@
+#include <kernels.h>
+#include <matrix.h>
+#include <gtest/gtest.h>
+
+namespace
+{
+
+template <uint16_t nrows, uint16_t ncols, uint16_t size>
+void expectSameProduct()
+{
+    // Operands are views into larger matrices, so the row pitch differs
+    // from the number of columns
+    mart::alloc::Matrix<int, nrows + 1, ncols + 2> A;
+    mart::alloc::Matrix<int, ncols + 1, size + 3> B;
+    for (uint16_t row = 0; row < nrows + 1; ++row) {
+        for (uint16_t col = 0; col < ncols + 2; ++col) {
+            A(row, col) = 3 * row - 2 * col + 1;
+        }
+    }
+    for (uint16_t row = 0; row < ncols + 1; ++row) {
+        for (uint16_t col = 0; col < size + 3; ++col) {
+            B(row, col) = row * col - 4;
+        }
+    }
+    const auto a = A.template submat<nrows, ncols>(1, 1);
+    const auto b = B.template submat<ncols, size>(1, 2);
+
+    mart::alloc::Matrix<int, nrows, size> generic, unrolled;
+    mart::kernel::multiplyGeneric<int, nrows, ncols, size>(
+        a.raw(), a.stride(), b.raw(), b.stride(), generic.raw(), size);
+    mart::kernel::multiplyUnrolled<int, nrows, ncols, size>(
+        a.raw(), a.stride(), b.raw(), b.stride(), unrolled.raw(), size);
+
+    const auto product = a * b;
+    for (uint16_t row = 0; row < nrows; ++row) {
+        for (uint16_t col = 0; col < size; ++col) {
+            int expected = 0;
+            for (uint16_t i = 0; i < ncols; ++i) {
+                expected += a(row, i) * b(i, col);
+            }
+            EXPECT_EQ(generic(row, col), expected);
+            EXPECT_EQ(unrolled(row, col), expected);
+            EXPECT_EQ(product(row, col), expected);
+        }
+    }
+}
+
+TEST(KernelsTest, multiply_unrolled_matches_generic)
+{
+    expectSameProduct<1, 1, 1>();
+    expectSameProduct<2, 3, 4>();
+    expectSameProduct<3, 3, 3>();
+    expectSameProduct<4, 4, 4>();
+    expectSameProduct<3, 4, 1>();
+}
+
+TEST(KernelsTest, multiply_vector_unrolled_matches_generic)
+{
+    const mart::alloc::Matrix<float, 3, 3> A = {
+        3, 7, 5,
+        -4, 8, 1,
+        10, 0, 14
+    };
+    const mart::alloc::Vector<float, 3> x{0.5f, -2, 3};
+
+    mart::alloc::Vector<float, 3> generic, unrolled;
+    mart::kernel::multiplyVectorGeneric<float, 3, 3>(A.raw(), A.stride(),
+                                                     x.raw(), x.stride(), generic.raw());
+    mart::kernel::multiplyVectorUnrolled<float, 3, 3>(A.raw(), A.stride(),
+                                                      x.raw(), x.stride(), unrolled.raw());
+    for (uint16_t i = 0; i < 3; ++i) {
+        EXPECT_EQ(generic[i], unrolled[i]);
+    }
+    EXPECT_FLOAT_EQ(generic[0], 2.5f);
+    EXPECT_FLOAT_EQ(generic[1], -15);
+    EXPECT_FLOAT_EQ(generic[2], 47);
+}
+
+TEST(KernelsTest, add_view_in_place)
+{
+    mart::alloc::Matrix<int, 3, 3> X = {
+        1, 2, 3,
+        4, 5, 6,
+        7, 8, 9
+    };
+    const mart::alloc::Matrix<int, 2, 2> Y = {
+        10, 20,
+        30, 40
+    };
+    auto sub = X.submat<2, 2>(1, 1);
+    sub += Y;
+    EXPECT_EQ(X(0, 0), 1);
+    EXPECT_EQ(X(1, 0), 4);
+    EXPECT_EQ(X(1, 1), 15);
+    EXPECT_EQ(X(1, 2), 26);
+    EXPECT_EQ(X(2, 1), 38);
+    EXPECT_EQ(X(2, 2), 49);
+}
+
+}  // namespace
@@ -0,0 +1,396 @@
+#include <l3gd20.h>
+#include <gtest/gtest.h>
+
+namespace
+{
+
+using Reg = mart::L3GD20::Register;
+
+constexpr uint16_t CS = 0x08;
+constexpr uint16_t INT2 = 0x02;
+
+class L3gd20Test : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        csPort.levels = CS;
+        spi.csPort = &csPort;
+        setRates(0x0102, -2, 0x7FFF);
+        halStubTick() = 0;
+    }
+
+    uint8_t& reg(Reg r) { return spi.device.registers[static_cast<uint8_t>(r)]; }
+
+    // Little-endian in OUT_X_L..OUT_Z_H
+    void setRates(int16_t x, int16_t y, int16_t z)
+    {
+        const int16_t values[] = {x, y, z};
+        for (uint8_t axis = 0; axis < 3; ++axis) {
+            const uint16_t value = static_cast<uint16_t>(values[axis]);
+            spi.device.registers[0x28 + 2 * axis] = static_cast<uint8_t>(value);
+            spi.device.registers[0x29 + 2 * axis] = static_cast<uint8_t>(value >> 8);
+        }
+    }
+
+    // With the FIFO enabled a burst wraps from OUT_Z_H back to OUT_X_L
+    void enableWrap()
+    {
+        spi.device.wrapAt = static_cast<uint8_t>(Reg::OUT_Z_H);
+        spi.device.wrapTo = static_cast<uint8_t>(Reg::OUT_X_L);
+    }
+
+    bool selected() const { return (csPort.levels & CS) == 0; }
+
+    GPIO_TypeDef csPort{};
+    GPIO_TypeDef drdyPort{};
+    SPI_HandleTypeDef spi{};
+    mart::L3GD20 gyro{&csPort, CS, spi};
+};
+
+TEST_F(L3gd20Test, angular_rates_in_one_transaction)
+{
+    Vector3 rates;
+    ASSERT_TRUE(gyro.read(rates));
+    EXPECT_EQ(spi.transactions, 1u);
+    EXPECT_EQ(rates.x, 0x0102);
+    EXPECT_EQ(rates.y, -2);
+    EXPECT_EQ(rates.z, 0x7FFF);
+    EXPECT_FALSE(selected());
+}
+
+TEST_F(L3gd20Test, configuration_served_from_shadow)
+{
+    reg(Reg::CTRL_REG4) = 0x30;
+    EXPECT_EQ(gyro.read(Reg::CTRL_REG4), 0x30);
+    EXPECT_EQ(gyro.read(Reg::CTRL_REG4), 0x30);
+    EXPECT_EQ(spi.transactions, 1u);
+
+    ASSERT_TRUE(gyro.write(Reg::CTRL_REG1, 0x0F));
+    EXPECT_EQ(reg(Reg::CTRL_REG1), 0x0F);
+    EXPECT_EQ(reg(Reg::CTRL_REG2), 0);
+    ASSERT_TRUE(gyro.write(Reg::CTRL_REG1, 0x0F));
+    EXPECT_EQ(gyro.read(Reg::CTRL_REG1), 0x0F);
+    EXPECT_EQ(spi.transactions, 2u);
+
+    // Status registers always go to the bus
+    gyro.read(Reg::FIFO_SRC_REG);
+    gyro.read(Reg::FIFO_SRC_REG);
+    EXPECT_EQ(spi.transactions, 4u);
+
+    gyro.forgetConfiguration();
+    gyro.read(Reg::CTRL_REG1);
+    EXPECT_EQ(spi.transactions, 5u);
+}
+
+TEST_F(L3gd20Test, profile_in_one_burst)
+{
+    const uint8_t profile[] = {0x0F, 0x00, 0x04, 0x00, 0x40};
+    ASSERT_TRUE(gyro.applyProfile(Reg::CTRL_REG1, profile, sizeof(profile)));
+    EXPECT_EQ(spi.transactions, 1u);
+    EXPECT_EQ(reg(Reg::CTRL_REG3), 0x04);
+    EXPECT_EQ(reg(Reg::CTRL_REG5), 0x40);
+
+    // Nothing to write
+    ASSERT_TRUE(gyro.applyProfile(Reg::CTRL_REG1, profile, sizeof(profile)));
+    EXPECT_EQ(spi.transactions, 1u);
+
+    // Only CTRL_REG4 changes: the address byte and one value
+    const uint8_t scale[] = {0x0F, 0x00, 0x04, 0x30, 0x40};
+    spi.bytes = 0;
+    ASSERT_TRUE(gyro.applyProfile(Reg::CTRL_REG1, scale, sizeof(scale)));
+    EXPECT_EQ(spi.transactions, 2u);
+    EXPECT_EQ(spi.bytes, 2u);
+    EXPECT_EQ(reg(Reg::CTRL_REG4), 0x30);
+}
+
+TEST_F(L3gd20Test, fifo_drained_in_one_burst)
+{
+    enableWrap();
+    gyro.enableFifo(mart::L3GD20::FifoMode::STREAM, 16, true);
+    EXPECT_EQ(reg(Reg::FIFO_CTRL_REG), 0x50);
+    EXPECT_EQ(reg(Reg::CTRL_REG3), 0x04);
+    EXPECT_EQ(reg(Reg::CTRL_REG5), 0x40);
+
+    Vector3 rates[mart::L3GD20::FIFO_DEPTH];
+    reg(Reg::FIFO_SRC_REG) = 0x80 | 20;
+    spi.transactions = 0;
+    EXPECT_EQ(gyro.readFifo(rates, 16), 16);
+    EXPECT_EQ(spi.transactions, 2u);  // FIFO_SRC_REG and the burst
+    EXPECT_EQ(rates[15].x, 0x0102);
+    EXPECT_EQ(rates[15].y, -2);
+    EXPECT_EQ(rates[15].z, 0x7FFF);
+
+    // FSS only counts to 31, a full FIFO shows as an overrun
+    reg(Reg::FIFO_SRC_REG) = 0x40;
+    EXPECT_EQ(gyro.fifoLevel(), mart::L3GD20::FIFO_DEPTH);
+    reg(Reg::FIFO_SRC_REG) = 0x20;
+    EXPECT_EQ(gyro.readFifo(rates, 16), 0);
+
+    gyro.disableFifo();
+    EXPECT_EQ(reg(Reg::FIFO_CTRL_REG), 0x00);
+    EXPECT_EQ(reg(Reg::CTRL_REG5), 0x00);
+}
+
+TEST_F(L3gd20Test, configure_and_read_burst)
+{
+    enableWrap();
+    const mart::L3GD20::Config config = {0x0F, 4, &drdyPort, INT2, &HAL_GetTick};
+    ASSERT_TRUE(gyro.configure(config));
+    // FIFO mode, the profile and its read-back
+    EXPECT_EQ(spi.transactions, 3u);
+    EXPECT_EQ(reg(Reg::FIFO_CTRL_REG), 0x44);
+    EXPECT_EQ(reg(Reg::CTRL_REG1), 0x0F);
+    EXPECT_EQ(reg(Reg::CTRL_REG3), 0x04);
+    EXPECT_EQ(reg(Reg::CTRL_REG5), 0x40);
+
+    // The first burst only starts the time base
+    RawSample samples[mart::L3GD20::MAX_BURST];
+    halStubTick() = 100;
+    gyro.onDataReady();
+    EXPECT_EQ(spi.transactions, 4u);
+    EXPECT_TRUE(selected());
+    EXPECT_TRUE(gyro.onTransferComplete());
+    EXPECT_FALSE(selected());
+    EXPECT_EQ(gyro.readBurst(samples, mart::L3GD20::MAX_BURST), 0);
+
+    // Stamped evenly between two watermark interrupts
+    halStubTick() = 200;
+    gyro.onDataReady();
+    EXPECT_TRUE(gyro.onTransferComplete());
+    ASSERT_EQ(gyro.readBurst(samples, mart::L3GD20::MAX_BURST), 4);
+    EXPECT_EQ(samples[0].sensor, SensorId::GYROSCOPE);
+    EXPECT_EQ(samples[0].timestamp, 125u);
+    EXPECT_EQ(samples[1].timestamp, 150u);
+    EXPECT_EQ(samples[3].timestamp, 200u);
+    EXPECT_EQ(samples[3].value.x, 0x0102);
+    EXPECT_EQ(samples[3].value.z, 0x7FFF);
+    EXPECT_EQ(gyro.readBurst(samples, mart::L3GD20::MAX_BURST), 0);
+
+    // Applying the same configuration again costs no transaction
+    spi.transactions = 0;
+    ASSERT_TRUE(gyro.configure(config));
+    EXPECT_EQ(spi.transactions, 0u);
+
+    // A bus error fails the configuration
+    gyro.forgetConfiguration();
+    spi.failures = 1;
+    EXPECT_FALSE(gyro.configure(config));
+}
+
+TEST_F(L3gd20Test, bursts_double_buffered)
+{
+    enableWrap();
+    RawSample samples[mart::L3GD20::MAX_BURST];
+    gyro.enableAsync(&drdyPort, INT2, 2, &HAL_GetTick);
+    EXPECT_EQ(spi.transactions, 0u);
+
+    // The first burst only starts the time base
+    gyro.onDataReady();
+    EXPECT_TRUE(gyro.onTransferComplete());
+    EXPECT_EQ(gyro.readBurst(samples, mart::L3GD20::MAX_BURST), 0);
+
+    halStubTick() = 10;
+    gyro.onDataReady();
+    gyro.onDataReady();  // ignored while busy
+    EXPECT_EQ(spi.transactions, 2u);
+    EXPECT_TRUE(gyro.onTransferComplete());
+    EXPECT_FALSE(gyro.onTransferComplete());
+
+    // The next burst goes to the other half, the published one stays
+    setRates(7, 8, 9);
+    halStubTick() = 20;
+    gyro.onDataReady();
+    ASSERT_EQ(gyro.readBurst(samples, mart::L3GD20::MAX_BURST), 2);
+    EXPECT_EQ(samples[1].value.x, 0x0102);
+    EXPECT_EQ(samples[1].timestamp, 10u);
+
+    EXPECT_TRUE(gyro.onTransferComplete());
+    ASSERT_EQ(gyro.readBurst(samples, mart::L3GD20::MAX_BURST), 2);
+    EXPECT_EQ(samples[0].value.x, 7);
+    EXPECT_EQ(samples[0].timestamp, 15u);
+    EXPECT_EQ(samples[1].value.z, 9);
+    EXPECT_EQ(samples[1].timestamp, 20u);
+    EXPECT_EQ(gyro.overruns(), 0u);
+
+    // A line still high after completion starts the next burst right away,
+    // and a burst nobody read is counted
+    drdyPort.levels = INT2;
+    halStubTick() = 30;
+    gyro.onDataReady();
+    halStubTick() = 31;
+    EXPECT_TRUE(gyro.onTransferComplete());
+    EXPECT_EQ(spi.transactions, 5u);
+    drdyPort.levels = 0;
+    EXPECT_TRUE(gyro.onTransferComplete());
+    EXPECT_EQ(gyro.overruns(), 1u);
+    EXPECT_EQ(gyro.readBurst(samples, 1), 1);
+    EXPECT_EQ(samples[0].timestamp, 30u);
+    EXPECT_EQ(gyro.busStats().transfers, 5u);
+
+    gyro.disableAsync();
+    gyro.onDataReady();
+    EXPECT_EQ(spi.transactions, 5u);
+
+    // The line may be up already when acquisition is enabled
+    drdyPort.levels = INT2;
+    gyro.enableAsync(&drdyPort, INT2, 2, &HAL_GetTick);
+    EXPECT_EQ(spi.transactions, 6u);
+}
+
+uint32_t recoveries = 0;
+
+void countRecovery()
+{
+    ++recoveries;
+}
+
+TEST_F(L3gd20Test, blocking_error_reported)
+{
+    gyro.write(Reg::CTRL_REG1, 0x0F);
+    spi.failures = 1;
+    EXPECT_FALSE(gyro.write(Reg::CTRL_REG2, 0x01));
+    EXPECT_FALSE(selected());
+    EXPECT_EQ(gyro.busStats().errors, 1u);
+
+    // The shadow is forgotten after a failed write
+    const uint32_t transactions = spi.transactions;
+    EXPECT_EQ(gyro.read(Reg::CTRL_REG1), 0x0F);
+    EXPECT_EQ(spi.transactions, transactions + 1);
+
+    Vector3 rates;
+    spi.failures = 1;
+    EXPECT_FALSE(gyro.read(rates));
+    EXPECT_EQ(gyro.busStats().errors, 2u);
+}
+
+TEST_F(L3gd20Test, async_error_retried_after_recovery)
+{
+    recoveries = 0;
+    const mart::L3GD20::Config config = {0x0F, 2, &drdyPort, INT2, &HAL_GetTick,
+                                         &countRecovery, 5, 10};
+    ASSERT_TRUE(gyro.configure(config));
+    const uint32_t transactions = spi.transactions;
+
+    // The burst does not start
+    halStubTick() = 100;
+    spi.failures = 1;
+    gyro.onDataReady();
+    EXPECT_FALSE(selected());
+    EXPECT_EQ(gyro.busStats().errors, 1u);
+    gyro.onDataReady();  // ignored until service() has recovered
+    EXPECT_EQ(spi.transactions, transactions);
+
+    drdyPort.levels = INT2;
+    halStubTick() = 109;
+    gyro.service();
+    EXPECT_EQ(recoveries, 0u);
+
+    // Retried right away as the line is still high
+    halStubTick() = 110;
+    gyro.service();
+    EXPECT_EQ(recoveries, 1u);
+    EXPECT_EQ(gyro.busStats().recoveries, 1u);
+    EXPECT_EQ(spi.transactions, transactions + 1);
+    drdyPort.levels = 0;
+    halStubTick() = 112;
+    EXPECT_TRUE(gyro.onTransferComplete());
+    EXPECT_EQ(gyro.busStats().lastLatency, 2u);
+
+    // An error callback fails the burst
+    halStubTick() = 200;
+    gyro.onDataReady();
+    gyro.onTransferError();
+    EXPECT_FALSE(selected());
+    EXPECT_FALSE(gyro.onTransferComplete());
+    halStubTick() = 210;
+    gyro.service();
+    EXPECT_EQ(recoveries, 2u);
+
+    // The second failure in a row waits twice as long
+    halStubTick() = 220;
+    gyro.onDataReady();
+    gyro.onTransferError();
+    halStubTick() = 239;
+    gyro.service();
+    EXPECT_EQ(recoveries, 2u);
+    halStubTick() = 240;
+    gyro.service();
+    EXPECT_EQ(recoveries, 3u);
+    EXPECT_EQ(gyro.busStats().errors, 3u);
+}
+
+TEST_F(L3gd20Test, hung_burst_times_out)
+{
+    recoveries = 0;
+    const mart::L3GD20::Config config = {0x0F, 2, &drdyPort, INT2, &HAL_GetTick,
+                                         &countRecovery, 5, 10};
+    ASSERT_TRUE(gyro.configure(config));
+
+    // No completion interrupt ever comes
+    halStubTick() = 100;
+    gyro.onDataReady();
+    EXPECT_TRUE(selected());
+    halStubTick() = 105;
+    gyro.service();
+    EXPECT_EQ(gyro.busStats().timeouts, 0u);
+    EXPECT_TRUE(selected());
+
+    halStubTick() = 106;
+    gyro.service();
+    EXPECT_EQ(gyro.busStats().timeouts, 1u);
+    EXPECT_FALSE(selected());
+    EXPECT_EQ(recoveries, 0u);
+
+    // A late completion is ignored
+    EXPECT_FALSE(gyro.onTransferComplete());
+
+    halStubTick() = 116;
+    gyro.service();
+    EXPECT_EQ(recoveries, 1u);
+
+    // The acquisition runs again
+    const uint32_t transactions = spi.transactions;
+    gyro.onDataReady();
+    EXPECT_EQ(spi.transactions, transactions + 1);
+    EXPECT_TRUE(gyro.onTransferComplete());
+}
+
+// Time passes with every look at the clock, as while disableAsync() waits
+uint32_t advancingTick()
+{
+    return halStubTick()++;
+}
+
+TEST_F(L3gd20Test, disable_aborts_burst_in_flight)
+{
+    // Without a timeout the burst is aborted right away
+    gyro.enableAsync(&drdyPort, INT2, 2, &HAL_GetTick);
+    gyro.onDataReady();
+    EXPECT_TRUE(selected());
+    gyro.disableAsync();
+    EXPECT_EQ(spi.aborts, 1u);
+    EXPECT_FALSE(selected());
+    EXPECT_FALSE(gyro.onTransferComplete());
+
+    // With one, once it has passed
+    const mart::L3GD20::Config config = {0x0F, 2, &drdyPort, INT2, &advancingTick,
+                                         nullptr, 5, 10};
+    ASSERT_TRUE(gyro.configure(config));
+    gyro.onDataReady();
+    const uint32_t started = halStubTick();
+    gyro.disableAsync();
+    EXPECT_EQ(spi.aborts, 2u);
+    EXPECT_GT(halStubTick(), started + 5);
+    EXPECT_FALSE(selected());
+    EXPECT_FALSE(gyro.onTransferComplete());
+
+    // A completed burst leaves nothing to abort
+    gyro.enableAsync(&drdyPort, INT2, 2, &advancingTick);
+    gyro.onDataReady();
+    EXPECT_TRUE(gyro.onTransferComplete());
+    gyro.disableAsync();
+    EXPECT_EQ(spi.aborts, 2u);
+}
+
+}  // namespace
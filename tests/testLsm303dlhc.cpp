@@ -0,0 +1,427 @@
+#include <lsm303dlhc.h>
+#include <gtest/gtest.h>
+
+namespace
+{
+
+using Acc = mart::Lsm303dlhc::AccRegister;
+using Mag = mart::Lsm303dlhc::MagRegister;
+
+class Lsm303dlhcTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        accelerometer().incrementOnMsb = true;
+
+        // x = 0x0102, y = -2, z = 0x7FFF, little-endian
+        const uint8_t acc[] = {0x02, 0x01, 0xFE, 0xFF, 0xFF, 0x7F};
+        for (uint8_t i = 0; i < sizeof(acc); ++i) {
+            accelerometer().registers[static_cast<uint8_t>(Acc::OUT_X_L_A) + i] = acc[i];
+        }
+        // x = 0x0304, z = -3, y = 0x0506, big-endian in X, Z, Y order
+        const uint8_t mag[] = {0x03, 0x04, 0xFF, 0xFD, 0x05, 0x06};
+        for (uint8_t i = 0; i < sizeof(mag); ++i) {
+            magnetometer().registers[static_cast<uint8_t>(Mag::OUT_X_H_M) + i] = mag[i];
+        }
+    }
+
+    HalStubI2cDevice& accelerometer() { return halStubDevice(&bus, 0x32); }
+    HalStubI2cDevice& magnetometer() { return halStubDevice(&bus, 0x3C); }
+
+    I2C_HandleTypeDef bus{};
+    mart::Lsm303dlhc lsm{bus};
+};
+
+TEST_F(Lsm303dlhcTest, acceleration_in_one_transaction)
+{
+    Vector3 acc;
+    lsm.readAcceleration(acc);
+    EXPECT_EQ(bus.transactions, 1u);
+    EXPECT_EQ(acc.x, 0x0102);
+    EXPECT_EQ(acc.y, -2);
+    EXPECT_EQ(acc.z, 0x7FFF);
+
+    // Register by register, as before
+    bus.transactions = 0;
+    for (uint8_t reg = 0x28; reg <= 0x2D; ++reg) {
+        lsm.read(static_cast<Acc>(reg));
+    }
+    EXPECT_EQ(bus.transactions, 6u);
+}
+
+TEST_F(Lsm303dlhcTest, magnetic_field_in_one_transaction)
+{
+    Vector3 mag;
+    lsm.readMagneticField(mag);
+    EXPECT_EQ(bus.transactions, 1u);
+    EXPECT_EQ(mag.x, 0x0304);
+    EXPECT_EQ(mag.y, 0x0506);
+    EXPECT_EQ(mag.z, -3);
+}
+
+TEST_F(Lsm303dlhcTest, single_register_access_does_not_increment)
+{
+    lsm.write(Acc::CTRL_REG1_A, 0x57);
+    EXPECT_EQ(accelerometer().registers[static_cast<uint8_t>(Acc::CTRL_REG1_A)], 0x57);
+    EXPECT_EQ(accelerometer().registers[static_cast<uint8_t>(Acc::CTRL_REG2_A)], 0);
+
+    uint8_t config[] = {0x57, 0x00, 0x00, 0x38};
+    lsm.write(Acc::CTRL_REG1_A, config, sizeof(config));
+    EXPECT_EQ(accelerometer().registers[static_cast<uint8_t>(Acc::CTRL_REG4_A)], 0x38);
+}
+
+TEST_F(Lsm303dlhcTest, configuration_served_from_shadow)
+{
+    // Unknown registers are read once, written ones not at all
+    EXPECT_EQ(lsm.read(Mag::CRB_REG_M), 0);
+    EXPECT_EQ(bus.transactions, 1u);
+    lsm.write(Acc::CTRL_REG1_A, 0x57);
+    EXPECT_EQ(bus.transactions, 2u);
+    EXPECT_EQ(lsm.read(Acc::CTRL_REG1_A), 0x57);
+    EXPECT_EQ(lsm.read(Mag::CRB_REG_M), 0);
+    lsm.write(Acc::CTRL_REG1_A, 0x57);
+    EXPECT_EQ(bus.transactions, 2u);
+
+    // Status registers always go to the bus
+    lsm.read(Acc::FIFO_SRC_REG_A);
+    lsm.read(Acc::FIFO_SRC_REG_A);
+    EXPECT_EQ(bus.transactions, 4u);
+
+    lsm.forgetConfiguration();
+    lsm.read(Acc::CTRL_REG1_A);
+    EXPECT_EQ(bus.transactions, 5u);
+}
+
+TEST_F(Lsm303dlhcTest, profile_in_one_burst)
+{
+    const uint8_t profile[] = {0x77, 0x00, 0x04, 0x38, 0x40};
+    EXPECT_TRUE(lsm.applyProfile(Acc::CTRL_REG1_A, profile, sizeof(profile)));
+    EXPECT_EQ(bus.transactions, 1u);
+    EXPECT_EQ(accelerometer().registers[static_cast<uint8_t>(Acc::CTRL_REG4_A)], 0x38);
+    EXPECT_EQ(accelerometer().registers[static_cast<uint8_t>(Acc::CTRL_REG5_A)], 0x40);
+
+    // Nothing to write
+    EXPECT_TRUE(lsm.applyProfile(Acc::CTRL_REG1_A, profile, sizeof(profile)));
+    EXPECT_EQ(bus.transactions, 1u);
+
+    // Only CTRL_REG4_A changes
+    const uint8_t scale[] = {0x77, 0x00, 0x04, 0x08, 0x40};
+    bus.bytes = 0;
+    EXPECT_TRUE(lsm.applyProfile(Acc::CTRL_REG1_A, scale, sizeof(scale)));
+    EXPECT_EQ(bus.transactions, 2u);
+    EXPECT_EQ(bus.bytes, 1u);
+    EXPECT_EQ(accelerometer().registers[static_cast<uint8_t>(Acc::CTRL_REG4_A)], 0x08);
+}
+
+TEST_F(Lsm303dlhcTest, async_reads_accelerometer_then_magnetometer)
+{
+    constexpr uint16_t INT1 = 0x10;
+    GPIO_TypeDef port{};
+    mart::Lsm303dlhc::Sample sample;
+
+    halStubTick() = 0;
+    lsm.enableAsync(&port, INT1, 1, &HAL_GetTick);
+    EXPECT_EQ(bus.transactions, 0u);
+    EXPECT_FALSE(lsm.takeSample(sample));
+
+    // DRDY1 edge: accelerometer read, its completion chains the magnetometer
+    halStubTick() = 10;
+    lsm.onDataReady();
+    EXPECT_EQ(bus.transactions, 1u);
+    lsm.onDataReady();  // ignored while busy
+    EXPECT_EQ(bus.transactions, 1u);
+
+    halStubTick() = 11;
+    EXPECT_FALSE(lsm.onTransferComplete());
+    EXPECT_EQ(bus.transactions, 2u);
+    EXPECT_TRUE(lsm.onTransferComplete());
+
+    ASSERT_TRUE(lsm.takeSample(sample));
+    ASSERT_EQ(sample.accelerationCount, 1);
+    EXPECT_EQ(sample.acceleration[0].x, 0x0102);
+    EXPECT_EQ(sample.acceleration[0].z, 0x7FFF);
+    EXPECT_EQ(sample.magneticField.y, 0x0506);
+    EXPECT_EQ(sample.accelerationTime[0], 10u);
+    EXPECT_EQ(sample.magneticFieldTime, 11u);
+    EXPECT_FALSE(lsm.takeSample(sample));
+
+    // A line still high after completion starts the next read right away
+    port.levels = INT1;
+    lsm.onDataReady();
+    lsm.onTransferComplete();
+    EXPECT_TRUE(lsm.onTransferComplete());
+    EXPECT_EQ(bus.transactions, 5u);
+    port.levels = 0;
+    lsm.onTransferComplete();
+    EXPECT_TRUE(lsm.onTransferComplete());
+    EXPECT_EQ(lsm.overruns(), 1u);
+
+    lsm.disableAsync();
+    lsm.onDataReady();
+    EXPECT_EQ(bus.transactions, 6u);
+}
+
+TEST_F(Lsm303dlhcTest, fifo_drained_in_one_transaction)
+{
+    accelerometer().wrapAt = static_cast<uint8_t>(Acc::OUT_Z_H_A);
+    accelerometer().wrapTo = static_cast<uint8_t>(Acc::OUT_X_L_A);
+
+    lsm.enableFifo(mart::Lsm303dlhc::FifoMode::STREAM, 16, true);
+    EXPECT_EQ(accelerometer().registers[static_cast<uint8_t>(Acc::FIFO_CTRL_REG_A)], 0x90);
+    EXPECT_EQ(accelerometer().registers[static_cast<uint8_t>(Acc::CTRL_REG3_A)], 0x04);
+    EXPECT_EQ(accelerometer().registers[static_cast<uint8_t>(Acc::CTRL_REG5_A)], 0x40);
+
+    Vector3 acc[mart::Lsm303dlhc::FIFO_DEPTH];
+    accelerometer().registers[static_cast<uint8_t>(Acc::FIFO_SRC_REG_A)] = 0x80 | 20;
+    bus.transactions = 0;
+    EXPECT_EQ(lsm.readFifo(acc, 16), 16);
+    EXPECT_EQ(bus.transactions, 2u);  // FIFO_SRC_REG_A and the burst
+    EXPECT_EQ(acc[15].x, 0x0102);
+    EXPECT_EQ(acc[15].y, -2);
+
+    accelerometer().registers[static_cast<uint8_t>(Acc::FIFO_SRC_REG_A)] = 0x40;
+    EXPECT_EQ(lsm.fifoLevel(), mart::Lsm303dlhc::FIFO_DEPTH);
+
+    // The asynchronous chain reads the whole watermark batch at once
+    GPIO_TypeDef port{};
+    mart::Lsm303dlhc::Sample sample;
+    halStubTick() = 100;
+    lsm.enableAsync(&port, 0x10, 16, &HAL_GetTick);
+
+    // The first batch only starts the time base, the magnetometer still
+    // comes through
+    lsm.onDataReady();
+    lsm.onTransferComplete();
+    EXPECT_TRUE(lsm.onTransferComplete());
+    ASSERT_TRUE(lsm.takeSample(sample));
+    EXPECT_EQ(sample.accelerationCount, 0);
+    EXPECT_EQ(sample.magneticField.y, 0x0506);
+
+    bus.transactions = 0;
+    halStubTick() = 260;
+    lsm.onDataReady();
+    lsm.onTransferComplete();
+    EXPECT_TRUE(lsm.onTransferComplete());
+    EXPECT_EQ(bus.transactions, 2u);
+    ASSERT_TRUE(lsm.takeSample(sample));
+    EXPECT_EQ(sample.accelerationCount, 16);
+    EXPECT_EQ(sample.acceleration[15].z, 0x7FFF);
+
+    // Stamped evenly between two watermark interrupts
+    EXPECT_EQ(sample.accelerationTime[0], 110u);
+    EXPECT_EQ(sample.accelerationTime[7], 180u);
+    EXPECT_EQ(sample.accelerationTime[15], 260u);
+}
+
+TEST_F(Lsm303dlhcTest, configure_and_read_burst)
+{
+    GPIO_TypeDef port{};
+    halStubTick() = 0;
+    const mart::Lsm303dlhc::Config config = {0x77, 0x38, 0x18, 2, &port, 0x10, &HAL_GetTick};
+    ASSERT_TRUE(lsm.configure(config));
+    // FIFO mode, both profiles and the read-back of the accelerometer one
+    EXPECT_EQ(bus.transactions, 4u);
+    EXPECT_EQ(accelerometer().registers[static_cast<uint8_t>(Acc::CTRL_REG1_A)], 0x77);
+    EXPECT_EQ(accelerometer().registers[static_cast<uint8_t>(Acc::CTRL_REG4_A)], 0x38);
+    EXPECT_EQ(accelerometer().registers[static_cast<uint8_t>(Acc::FIFO_CTRL_REG_A)], 0x82);
+    EXPECT_EQ(magnetometer().registers[static_cast<uint8_t>(Mag::CRA_REG_M)], 0x18);
+
+    RawSample samples[mart::Lsm303dlhc::MAX_BURST];
+    EXPECT_EQ(lsm.readBurst(samples, mart::Lsm303dlhc::MAX_BURST), 0);
+
+    // The first batch only starts the time base
+    halStubTick() = 10;
+    lsm.onDataReady();
+    lsm.onTransferComplete();
+    EXPECT_TRUE(lsm.onTransferComplete());
+    ASSERT_EQ(lsm.readBurst(samples, mart::Lsm303dlhc::MAX_BURST), 1);
+    EXPECT_EQ(samples[0].sensor, SensorId::MAGNETOMETER);
+
+    halStubTick() = 20;
+    lsm.onDataReady();
+    lsm.onTransferComplete();
+    halStubTick() = 21;
+    EXPECT_TRUE(lsm.onTransferComplete());
+
+    // Accelerometer samples first, then the magnetometer
+    ASSERT_EQ(lsm.readBurst(samples, mart::Lsm303dlhc::MAX_BURST), 3);
+    EXPECT_EQ(samples[0].sensor, SensorId::ACCELEROMETER);
+    EXPECT_EQ(samples[0].timestamp, 15u);
+    EXPECT_EQ(samples[1].timestamp, 20u);
+    EXPECT_EQ(samples[0].value.z, 0x7FFF);
+    EXPECT_EQ(samples[2].sensor, SensorId::MAGNETOMETER);
+    EXPECT_EQ(samples[2].value.y, 0x0506);
+    EXPECT_EQ(lsm.readBurst(samples, mart::Lsm303dlhc::MAX_BURST), 0);
+
+    // Applying the same configuration again costs no transaction
+    lsm.disableAsync();
+    bus.transactions = 0;
+    ASSERT_TRUE(lsm.configure(config));
+    EXPECT_EQ(bus.transactions, 0u);
+
+    // The samples are decoded little-endian, so BLE stays clear
+    mart::Lsm303dlhc::Config bigEndian = config;
+    bigEndian.ctrlReg4A = 0x78;
+    ASSERT_TRUE(lsm.configure(bigEndian));
+    EXPECT_EQ(bus.transactions, 0u);
+    EXPECT_EQ(accelerometer().registers[static_cast<uint8_t>(Acc::CTRL_REG4_A)], 0x38);
+}
+
+uint32_t recoveries = 0;
+
+void countRecovery()
+{
+    ++recoveries;
+}
+
+TEST_F(Lsm303dlhcTest, blocking_error_reported_and_bus_recovered)
+{
+    GPIO_TypeDef port{};
+    recoveries = 0;
+    const mart::Lsm303dlhc::Config config = {0x77, 0x38, 0x18, 1, &port, 0x10, &HAL_GetTick,
+                                             &countRecovery, 50, 10};
+    bus.failures = 1;
+    EXPECT_FALSE(lsm.configure(config));
+    EXPECT_EQ(lsm.busStats().errors, 1u);
+    EXPECT_EQ(lsm.busStats().recoveries, 1u);
+    EXPECT_EQ(recoveries, 1u);
+
+    // Nothing was stored for the failed write
+    EXPECT_TRUE(lsm.configure(config));
+    EXPECT_EQ(accelerometer().registers[static_cast<uint8_t>(Acc::FIFO_CTRL_REG_A)], 0x81);
+
+    Vector3 acc;
+    bus.failures = 1;
+    EXPECT_FALSE(lsm.readAcceleration(acc));
+    EXPECT_EQ(lsm.busStats().errors, 2u);
+}
+
+TEST_F(Lsm303dlhcTest, async_error_retried_after_recovery)
+{
+    constexpr uint16_t INT1 = 0x10;
+    GPIO_TypeDef port{};
+    recoveries = 0;
+    halStubTick() = 0;
+    const mart::Lsm303dlhc::Config config = {0x77, 0x38, 0x18, 1, &port, INT1, &HAL_GetTick,
+                                             &countRecovery, 50, 10};
+    ASSERT_TRUE(lsm.configure(config));
+
+    // The accelerometer read does not start
+    halStubTick() = 100;
+    bus.failures = 1;
+    lsm.onDataReady();
+    EXPECT_EQ(lsm.busStats().errors, 1u);
+    lsm.onDataReady();  // ignored until service() has recovered
+    EXPECT_EQ(bus.failures, 0u);
+
+    const uint32_t transactions = bus.transactions;
+    port.levels = INT1;
+    halStubTick() = 109;
+    lsm.service();
+    EXPECT_EQ(recoveries, 0u);
+    EXPECT_EQ(bus.transactions, transactions);
+
+    // Retried right away as the line is still high
+    halStubTick() = 110;
+    lsm.service();
+    EXPECT_EQ(recoveries, 1u);
+    EXPECT_EQ(bus.transactions, transactions + 1);
+    port.levels = 0;
+
+    halStubTick() = 112;
+    lsm.onTransferComplete();
+    halStubTick() = 115;
+    EXPECT_TRUE(lsm.onTransferComplete());
+    EXPECT_EQ(lsm.busStats().transfers, 1u);
+    EXPECT_EQ(lsm.busStats().lastLatency, 5u);
+
+    // An error callback midway fails the sample
+    halStubTick() = 200;
+    lsm.onDataReady();
+    lsm.onTransferError();
+    EXPECT_FALSE(lsm.onTransferComplete());
+    EXPECT_EQ(lsm.busStats().errors, 2u);
+    halStubTick() = 210;
+    lsm.service();
+    EXPECT_EQ(recoveries, 2u);
+}
+
+TEST_F(Lsm303dlhcTest, hung_read_times_out)
+{
+    GPIO_TypeDef port{};
+    recoveries = 0;
+    halStubTick() = 0;
+    const mart::Lsm303dlhc::Config config = {0x77, 0x38, 0x18, 1, &port, 0x10, &HAL_GetTick,
+                                             &countRecovery, 50, 10};
+    ASSERT_TRUE(lsm.configure(config));
+
+    // No completion interrupt ever comes
+    halStubTick() = 100;
+    lsm.onDataReady();
+    halStubTick() = 150;
+    lsm.service();
+    EXPECT_EQ(lsm.busStats().timeouts, 0u);
+    halStubTick() = 151;
+    lsm.service();
+    EXPECT_EQ(lsm.busStats().timeouts, 1u);
+    EXPECT_EQ(recoveries, 0u);
+
+    // A late completion is ignored
+    EXPECT_FALSE(lsm.onTransferComplete());
+
+    halStubTick() = 161;
+    lsm.service();
+    EXPECT_EQ(recoveries, 1u);
+
+    // The acquisition runs again
+    const uint32_t transactions = bus.transactions;
+    lsm.onDataReady();
+    EXPECT_EQ(bus.transactions, transactions + 1);
+}
+
+// Time passes with every look at the clock, as while disableAsync() waits
+uint32_t advancingTick()
+{
+    return halStubTick()++;
+}
+
+TEST_F(Lsm303dlhcTest, disable_aborts_read_in_flight)
+{
+    GPIO_TypeDef port{};
+    recoveries = 0;
+
+    // Without a timeout the accelerometer read is aborted right away
+    lsm.enableAsync(&port, 0x10, 1, &HAL_GetTick);
+    lsm.onDataReady();
+    lsm.disableAsync();
+    EXPECT_EQ(bus.aborts, 1u);
+    EXPECT_FALSE(lsm.onTransferComplete());
+
+    // With one, the magnetometer read once it has passed. The HAL refuses
+    // the abort, so the bus is recovered instead.
+    const mart::Lsm303dlhc::Config config = {0x77, 0x38, 0x18, 1, &port, 0x10, &advancingTick,
+                                             &countRecovery, 50, 10};
+    ASSERT_TRUE(lsm.configure(config));
+    const uint32_t started = halStubTick();
+    lsm.onDataReady();
+    EXPECT_FALSE(lsm.onTransferComplete());
+    bus.abortStatus = HAL_ERROR;
+    lsm.disableAsync();
+    EXPECT_EQ(bus.aborts, 2u);
+    EXPECT_GT(halStubTick(), started + 50);
+    EXPECT_EQ(recoveries, 1u);
+    EXPECT_EQ(lsm.busStats().recoveries, 1u);
+    EXPECT_FALSE(lsm.onTransferComplete());
+
+    // A completed read leaves nothing to abort
+    lsm.enableAsync(&port, 0x10, 1, &advancingTick);
+    lsm.onDataReady();
+    EXPECT_FALSE(lsm.onTransferComplete());
+    EXPECT_TRUE(lsm.onTransferComplete());
+    lsm.disableAsync();
+    EXPECT_EQ(bus.aborts, 2u);
+    EXPECT_EQ(recoveries, 1u);
+}
+
+}  // namespace
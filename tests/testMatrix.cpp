@@ -114,6 +114,21 @@ TEST(MatrixTest, transpose_ref)
     EXPECT_EQ(Z(1, 1), 40);
 }
 
+TEST(MatrixTest, transpose_non_square)
+{
+    const mart::alloc::Matrix<int, 2, 3> X = {
+        1, 2, 3,
+        4, 5, 6
+    };
+    const auto Z = X.transpose();
+    EXPECT_EQ(Z(0, 0), 1);
+    EXPECT_EQ(Z(0, 1), 4);
+    EXPECT_EQ(Z(1, 0), 2);
+    EXPECT_EQ(Z(1, 1), 5);
+    EXPECT_EQ(Z(2, 0), 3);
+    EXPECT_EQ(Z(2, 1), 6);
+}
+
 TEST(MatrixTest, lu_decomposition_2x2)
 {
     const mart::alloc::Matrix<float, 2, 2> X = {
@@ -165,9 +180,102 @@ TEST(MatrixTest, lu_decomposition_3x3)
     EXPECT_FLOAT_EQ(U(2, 2), 7.6538461538461515f);
 }
 
-TEST(MatrixTest, inverse_2x2) {}
+TEST(MatrixTest, subtract)
+{
+    const mart::alloc::Matrix<int, 2, 2> X = {
+        5, 21,
+        8, 40
+    };
+    const mart::alloc::Matrix<int, 2, 2> Y = {
+        10, 1,
+        7, 6
+    };
+    const auto Z = X - Y;
+    EXPECT_EQ(-5, Z(0, 0));
+    EXPECT_EQ(20, Z(0, 1));
+    EXPECT_EQ(1, Z(1, 0));
+    EXPECT_EQ(34, Z(1, 1));
+}
 
-TEST(MatrixTest, inverse_3x3) {}
+TEST(MatrixTest, assign_keeps_own_storage)
+{
+    mart::alloc::Matrix<int, 2, 2> X;
+    {
+        const mart::alloc::Matrix<int, 2, 2> Y = {
+            1, 2,
+            3, 4
+        };
+        X = Y;
+    }
+    X(0, 0) = 7;
+    EXPECT_EQ(7, X(0, 0));
+    EXPECT_EQ(2, X(0, 1));
+    EXPECT_NE(X.raw(), nullptr);
+}
+
+TEST(MatrixTest, inverse_2x2)
+{
+    const mart::alloc::Matrix<float, 2, 2> X = {
+        4, 7,
+        2, 6
+    };
+    const auto Y = X.inverse();
+    EXPECT_FLOAT_EQ(Y(0, 0), 0.6f);
+    EXPECT_FLOAT_EQ(Y(0, 1), -0.7f);
+    EXPECT_FLOAT_EQ(Y(1, 0), -0.2f);
+    EXPECT_FLOAT_EQ(Y(1, 1), 0.4f);
+}
+
+TEST(MatrixTest, inverse_3x3)
+{
+    const mart::alloc::Matrix<float, 3, 3> X = {
+        3, 7, 5,
+        -4, 8, 1,
+        10, 0, 14
+    };
+    mart::alloc::Matrix<float, 3, 3> Y;
+    X.inverse(Y);
+    const auto I = X * Y;
+    for (uint16_t row = 0; row < 3; ++row) {
+        for (uint16_t col = 0; col < 3; ++col) {
+            EXPECT_NEAR(I(row, col), row == col ? 1.0f : 0.0f, 1e-5f);
+        }
+    }
+}
+
+TEST(MatrixTest, determinant)
+{
+    const mart::alloc::Matrix<float, 3, 3> X = {
+        3, 7, 5,
+        -4, 8, 1,
+        10, 0, 14
+    };
+    EXPECT_FLOAT_EQ(X.determinant(), 398.0f);
+}
+
+TEST(MatrixTest, expm)
+{
+    const mart::alloc::Matrix<double, 2, 2> zero;
+    const auto I = zero.expm();
+    EXPECT_DOUBLE_EQ(I(0, 0), 1);
+    EXPECT_DOUBLE_EQ(I(0, 1), 0);
+    EXPECT_DOUBLE_EQ(I(1, 1), 1);
+
+    const mart::alloc::Matrix<double, 2, 2> D = {1, 0, 0, -2};
+    const auto E = D.expm();
+    EXPECT_NEAR(E(0, 0), std::exp(1.0), 1e-12);
+    EXPECT_NEAR(E(1, 1), std::exp(-2.0), 1e-12);
+    EXPECT_NEAR(E(0, 1), 0, 1e-12);
+
+    // Large enough that several squarings are needed
+    const double angle = 10;
+    const mart::alloc::Matrix<double, 2, 2> W = {0, -angle, angle, 0};
+    const auto R = W.expm();
+    EXPECT_NEAR(R(0, 0), std::cos(angle), 1e-10);
+    EXPECT_NEAR(R(0, 1), -std::sin(angle), 1e-10);
+    EXPECT_NEAR(R(1, 0), std::sin(angle), 1e-10);
+    EXPECT_NEAR(R(1, 1), std::cos(angle), 1e-10);
+}
 
 TEST(MatrixTest, submat)
 {
@@ -184,6 +292,171 @@ TEST(MatrixTest, submat)
     EXPECT_EQ(Y(1, 1), 14);
 }
 
+TEST(MatrixTest, block)
+{
+    mart::alloc::Matrix<int, 4, 4> X = {
+        3, 7, 5, 2,
+        -4, 8, 1, 0,
+        10, 0, 14, 4,
+        1, 3, 5, 7
+    };
+
+    auto B = X.block<0, 1, 2, 2>();
+    EXPECT_EQ(B(0, 0), 5);
+    EXPECT_EQ(B(0, 1), 2);
+    EXPECT_EQ(B(1, 0), 1);
+    EXPECT_EQ(B(1, 1), 0);
+
+    auto C = X.block<1, 0, 2, 2>();
+    EXPECT_EQ(C(0, 0), 10);
+    EXPECT_EQ(C(1, 1), 3);
+
+    C(1, 0) = 6;
+    EXPECT_EQ(X(3, 0), 6);
+}
+
+TEST(MatrixTest, row_col_diag)
+{
+    mart::alloc::Matrix<int, 3, 3> X = {
+        3, 7, 5,
+        -4, 8, 1,
+        10, 0, 14
+    };
+
+    const auto r = X.row(1);
+    EXPECT_EQ(r[0], -4);
+    EXPECT_EQ(r[2], 1);
+
+    const auto c = X.col(2);
+    EXPECT_EQ(c[0], 5);
+    EXPECT_EQ(c[1], 1);
+    EXPECT_EQ(c[2], 14);
+
+    auto d = X.diag();
+    d *= 2;
+    EXPECT_EQ(X(0, 0), 6);
+    EXPECT_EQ(X(1, 1), 16);
+    EXPECT_EQ(X(2, 2), 28);
+    EXPECT_EQ(X(0, 1), 7);
+
+    // A column of a submatrix keeps the parent's row pitch
+    const auto s = X.submat<2, 2>(1, 1).col(0);
+    EXPECT_EQ(s[0], 16);
+    EXPECT_EQ(s[1], 0);
+}
+
+TEST(MatrixTest, multiply_strided_vector)
+{
+    const mart::alloc::Matrix<int, 2, 3> A = {
+        1, 2, 3,
+        4, 5, 6
+    };
+    const mart::alloc::Matrix<int, 3, 2> B = {
+        1, 0,
+        2, 1,
+        -1, 3
+    };
+
+    const auto y = A * B.col(1);
+    EXPECT_EQ(y[0], 11);
+    EXPECT_EQ(y[1], 23);
+}
+
+TEST(MatrixTest, aligned_layout)
+{
+    using Padded = mart::alloc::Matrix<float, 3, 5, mart::alloc::Aligned<32>>;
+    static_assert(Padded::LeadingDim == 8, "rows padded to 32 bytes");
+    static_assert(mart::alloc::Matrix<float, 3, 5>::LeadingDim == 5,
+                  "dense by default");
+
+    Padded X = {
+        1, 2, 3, 4, 5,
+        6, 7, 8, 9, 10,
+        11, 12, 13, 14, 15
+    };
+    EXPECT_EQ(X.stride(), 8);
+    for (uint16_t row = 0; row < 3; ++row) {
+        const auto address = reinterpret_cast<std::uintptr_t>(X.row(row).raw());
+        EXPECT_EQ(address % 32, 0u);
+    }
+    EXPECT_EQ(X(2, 0), 11);
+    EXPECT_EQ(X.raw()[5], 0);
+
+    const mart::alloc::Matrix<float, 3, 5> dense(X);
+    const auto sum = X + dense;
+    EXPECT_EQ(sum(1, 4), 20);
+
+    Padded Y(dense);
+    Y += X;
+    EXPECT_EQ(Y(2, 4), 30);
+
+    const Padded Z = Y;
+    EXPECT_EQ(Z(0, 1), 4);
+    EXPECT_NE(Z.raw(), Y.raw());
+}
+
+TEST(MatrixTest, lazy_transpose_and_scale)
+{
+    const mart::alloc::Matrix<int, 2, 3> A = {
+        1, 2, 3,
+        4, 5, 6
+    };
+    const mart::alloc::Matrix<int, 2, 3> B = {
+        1, 0, -1,
+        2, 1, 0
+    };
+
+    const auto T = mart::transposed(A);
+    EXPECT_EQ(T(2, 1), 6);
+
+    // A * B^T, 2x2 goes through the unrolled kernel
+    const auto ABT = A * mart::transposed(B);
+    EXPECT_EQ(ABT(0, 0), -2);
+    EXPECT_EQ(ABT(0, 1), 4);
+    EXPECT_EQ(ABT(1, 0), -2);
+    EXPECT_EQ(ABT(1, 1), 13);
+
+    // 3 * A^T * B, 3x3
+    const auto ATB = mart::scaled(mart::transposed(A), 3) * B;
+    const auto expected = A.transpose() * B * 3;
+    for (uint16_t row = 0; row < 3; ++row) {
+        for (uint16_t col = 0; col < 3; ++col) {
+            EXPECT_EQ(ATB(row, col), expected(row, col));
+        }
+    }
+
+    // A transposed submatrix keeps the parent's row pitch
+    mart::alloc::Matrix<int, 3, 3> X = {
+        3, 7, 5,
+        -4, 8, 1,
+        10, 0, 14
+    };
+    const auto Y = mart::transposed(X.submat<2, 2>(1, 1)) *
+                   mart::alloc::Matrix<int, 2, 2>::eye();
+    EXPECT_EQ(Y(0, 1), 0);
+    EXPECT_EQ(Y(1, 0), 1);
+    EXPECT_EQ(Y(1, 1), 14);
+}
+
+TEST(MatrixTest, lazy_transpose_generic_kernel)
+{
+    mart::alloc::Matrix<int, 5, 5> A, B;
+    for (uint16_t row = 0; row < 5; ++row) {
+        for (uint16_t col = 0; col < 5; ++col) {
+            A(row, col) = row * 3 - col;
+            B(row, col) = (row + 2) * (col - 1);
+        }
+    }
+
+    const auto lazy = mart::scaled(A, 2) * mart::transposed(B);
+    const auto expected = A * B.transpose() * 2;
+    for (uint16_t row = 0; row < 5; ++row) {
+        for (uint16_t col = 0; col < 5; ++col) {
+            EXPECT_EQ(lazy(row, col), expected(row, col));
+        }
+    }
+}
+
 TEST(MatrixTest, partition)
 {
     mart::alloc::Matrix<int, 4, 4> X = {
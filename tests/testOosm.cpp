@@ -0,0 +1,115 @@
+#include <extkalman.h>
+#include <oosm.h>
+#include <gtest/gtest.h>
+
+namespace
+{
+
+using EKF = mart::ExtendedKalmanFilter<float, 2, 1>;
+using Status = mart::OutOfSequenceFilter<EKF, 8>::Status;
+enum { Pos, Vel };
+
+EKF constantVelocity()
+{
+    EKF ekf(
+        [](EKF::State& next, const EKF::State& current, float dt) {
+            next[Pos] = current[Pos] + current[Vel] * dt;
+            next[Vel] = current[Vel];
+        },
+        [](const EKF::State&, EKF::ProcessMatrix& F, float dt) {
+            F = {1, dt, 0, 1};
+        },
+        mart::alloc::Matrix<float, 2, 2>{1e-3f, 0, 0, 1e-2f},
+        [](const EKF::State& x, EKF::Measurement& z, float) { z[0] = x[Pos]; },
+        [](const EKF::State&, EKF::MeasurementMatrix& H, float) { H = {1, 0}; },
+        mart::alloc::Matrix<float, 1, 1>{0.25f});
+    ekf.reset(mart::alloc::Vector<float, 2>{0, 0},
+              mart::alloc::Matrix<float, 2, 2>{1, 0, 0, 1});
+    return ekf;
+}
+
+mart::alloc::Vector<float, 1> sample(float t)
+{
+    return {2 * t + 0.1f};
+}
+
+// Stamps in ms
+constexpr uint32_t MS = 1000;
+
+TEST(OutOfSequenceFilterTest, late_sample_matches_ordered_stream)
+{
+    mart::OutOfSequenceFilter<EKF, 8> oosm(constantVelocity(), MS, 0);
+    auto ordered = constantVelocity();
+    EKF::Workspace ws;
+
+    const uint32_t arrival[] = {10, 20, 40, 50, 30, 60};
+    for (uint32_t stamp : arrival) {
+        const auto status = oosm.update(sample(stamp * 1e-3f), stamp);
+        EXPECT_EQ(status, stamp == 30 ? Status::Replayed : Status::Applied);
+    }
+
+    uint32_t previous = 0;
+    for (uint32_t stamp : {10, 20, 30, 40, 50, 60}) {
+        ordered.update(sample(stamp * 1e-3f), (stamp - previous) * 1e-3f, ws);
+        previous = stamp;
+    }
+
+    EXPECT_EQ(oosm.size(), 6);
+    EXPECT_FLOAT_EQ(oosm.state()[Pos], ordered.state()[Pos]);
+    EXPECT_FLOAT_EQ(oosm.state()[Vel], ordered.state()[Vel]);
+    EXPECT_FLOAT_EQ(oosm.covariance()(Pos, Vel), ordered.covariance()(Pos, Vel));
+}
+
+TEST(OutOfSequenceFilterTest, rejects_samples_older_than_window)
+{
+    mart::OutOfSequenceFilter<EKF, 8> oosm(constantVelocity(), MS, 0);
+    for (uint32_t k = 1; k <= 12; ++k) {
+        EXPECT_EQ(oosm.update(sample(k * 0.01f), k * 10), Status::Applied);
+    }
+    EXPECT_EQ(oosm.size(), 8);
+    EXPECT_EQ(oosm.horizon(), 40u);
+
+    const float before = oosm.state()[Pos];
+    EXPECT_EQ(oosm.update(sample(0.035f), 35), Status::TooOld);
+    EXPECT_FLOAT_EQ(oosm.state()[Pos], before);
+
+    // Between the base and the oldest kept sample: the window is full, so
+    // making room would drop the posterior to restart from
+    EXPECT_EQ(oosm.update(sample(0.045f), 45), Status::TooOld);
+
+    EXPECT_EQ(oosm.update(sample(0.055f), 55), Status::Replayed);
+    EXPECT_EQ(oosm.size(), 8);
+    EXPECT_EQ(oosm.horizon(), 50u);
+}
+
+TEST(OutOfSequenceFilterTest, late_sample_placed_across_counter_wrap)
+{
+    // Cycle counter stamps 1 ms apart, the counter wraps after the second
+    // sample. In float seconds since boot, hours in, these would collapse
+    // into the same value.
+    constexpr uint32_t HZ = 72000000;
+    constexpr uint32_t TICK = HZ / 1000;
+    const uint32_t start = 0xFFFFFFFFu - 2 * TICK - TICK / 2;
+    mart::OutOfSequenceFilter<EKF, 8> oosm(constantVelocity(), HZ, start);
+    auto ordered = constantVelocity();
+    EKF::Workspace ws;
+
+    const uint32_t arrival[] = {1, 2, 4, 5, 3, 6};
+    for (uint32_t k : arrival) {
+        const auto status = oosm.update(sample(k * 1e-3f), start + k * TICK);
+        EXPECT_EQ(status, k == 3 ? Status::Replayed : Status::Applied);
+    }
+    for (uint32_t k = 1; k <= 6; ++k) {
+        ordered.update(sample(k * 1e-3f), 1e-3f, ws);
+    }
+
+    EXPECT_EQ(oosm.size(), 6);
+    EXPECT_FLOAT_EQ(oosm.state()[Pos], ordered.state()[Pos]);
+    EXPECT_FLOAT_EQ(oosm.state()[Vel], ordered.state()[Vel]);
+    EXPECT_FLOAT_EQ(oosm.covariance()(Pos, Vel), ordered.covariance()(Pos, Vel));
+
+    // Before the start, on the other side of the wrap from the newest
+    EXPECT_EQ(oosm.update(sample(0), start - TICK), Status::TooOld);
+}
+
+}  // namespace
@@ -0,0 +1,155 @@
+#include <OrientationEstimator.h>
+#include <pipeline.h>
+#include <replay.h>
+#include <cmath>
+#include <cstdio>
+#include <gtest/gtest.h>
+
+namespace
+{
+
+using mart::orient::OrientationEstimator;
+using Fusion = mart::SampleFusion<OrientationEstimator>;
+
+constexpr uint32_t CYCLE_COUNTER_HZ = 72000000;
+const char* const LOG_PATH = "testOrientationEstimator.log";
+
+// L3GD20 at 250 dps, LSM303DLHC at +-16 g high resolution and 1.3 gauss
+const Fusion::Scales SCALES = {{{1.527e-4f, 1.527e-4f, 1.527e-4f},
+                                {7.5e-4f, 7.5e-4f, 7.5e-4f},
+                                {1 / 1100.0f, 1 / 1100.0f, 1 / 980.0f}}};
+
+// The body turns around x at RATE, g and m follow v' = w x v
+constexpr float RATE = 0.5f;
+const float G0[3] = {0, 0, 1};
+const float M0[3] = {0.3f, 0, -0.4f};
+
+void rotated(const float (&v)[3], float t, float (&out)[3])
+{
+    const float c = std::cos(RATE * t);
+    const float s = std::sin(RATE * t);
+    out[0] = v[0];
+    out[1] = c * v[1] - s * v[2];
+    out[2] = s * v[1] + c * v[2];
+}
+
+Vector3 toRaw(const float (&v)[3], const float (&perLsb)[3])
+{
+    return {static_cast<int16_t>(std::lround(v[0] / perLsb[0])),
+            static_cast<int16_t>(std::lround(v[1] / perLsb[1])),
+            static_cast<int16_t>(std::lround(v[2] / perLsb[2]))};
+}
+
+// Two seconds of the board's streams, gyroscope at 760 Hz, accelerometer at
+// 400 Hz and magnetometer at 75 Hz. The stamps start just before the cycle
+// counter wraps.
+constexpr uint32_t START = 0xFFFFFFFFu - CYCLE_COUNTER_HZ / 2;
+
+void writeLog()
+{
+    std::FILE* file = std::fopen(LOG_PATH, "wb");
+    ASSERT_NE(file, nullptr);
+    const uint32_t rates[3] = {760, 400, 75};
+    uint32_t next[3] = {0, 0, 0};
+    for (uint32_t tick = 0; tick < 2 * CYCLE_COUNTER_HZ; tick += 1000) {
+        const float t = static_cast<float>(tick) / CYCLE_COUNTER_HZ;
+        for (uint8_t sensor = 0; sensor < 3; ++sensor) {
+            if (tick < next[sensor]) {
+                continue;
+            }
+            next[sensor] += CYCLE_COUNTER_HZ / rates[sensor];
+            float value[3] = {RATE, 0, 0};
+            if (sensor == 1) {
+                rotated(G0, t, value);
+            } else if (sensor == 2) {
+                rotated(M0, t, value);
+            }
+            ASSERT_TRUE(mart::ReplaySensor::writeRecord(
+                file, {START + tick, toRaw(value, SCALES.perLsb[sensor]),
+                       static_cast<SensorId>(sensor)}));
+        }
+    }
+    std::fclose(file);
+}
+
+TEST(OrientationEstimatorTest, replayed_log_followed)
+{
+    writeLog();
+    mart::ReplaySensor replay;
+    ASSERT_TRUE(replay.configure({LOG_PATH, CYCLE_COUNTER_HZ, false}));
+
+    OrientationEstimator estimator(CYCLE_COUNTER_HZ);
+    Fusion fusion(estimator, SCALES);
+    uint32_t updates = 0;
+    uint32_t checked = 0;
+    mart::drain(replay, [&](const RawSample* burst, uint32_t count) {
+        updates += fusion.consume(burst, count);
+        if (updates == 0) {
+            return;
+        }
+
+        const auto& x = estimator.state();
+        for (uint16_t i = 0; i < OrientationEstimator::EKF::StateSize; ++i) {
+            ASSERT_TRUE(std::isfinite(x[i])) << "state " << i << " after " << updates;
+        }
+
+        // Compared with the truth at the last gyroscope sample, after the
+        // filter has settled
+        bool gyroscope = false;
+        uint32_t stamp = 0;
+        for (uint32_t i = 0; i < count; ++i) {
+            if (burst[i].sensor == SensorId::GYROSCOPE) {
+                gyroscope = true;
+                stamp = burst[i].timestamp;
+            }
+        }
+        const float t = static_cast<float>(stamp - START) / CYCLE_COUNTER_HZ;
+        if (!gyroscope || t < 0.5f) {
+            return;
+        }
+        float g[3];
+        float m[3];
+        rotated(G0, t, g);
+        rotated(M0, t, m);
+        EXPECT_NEAR(x[0], RATE, 0.01f);
+        EXPECT_NEAR(x[1], 0.0f, 0.01f);
+        EXPECT_NEAR(x[2], 0.0f, 0.01f);
+        for (uint16_t axis = 0; axis < 3; ++axis) {
+            EXPECT_NEAR(x[6 + axis], g[axis], 0.01f);
+            EXPECT_NEAR(x[9 + axis], m[axis], 0.01f);
+        }
+        ++checked;
+    });
+    std::remove(LOG_PATH);
+
+    EXPECT_GT(updates, 1400u);
+    EXPECT_GT(checked, 50u);
+
+    // The covariance has shrunk from its initial value
+    EXPECT_LT(estimator.covariance()(6, 6), 0.1f);
+    EXPECT_GT(estimator.covariance()(6, 6), 0.0f);
+}
+
+TEST(OrientationEstimatorTest, first_update_finite)
+{
+    OrientationEstimator estimator(CYCLE_COUNTER_HZ);
+    OrientationEstimator::Measurement::Alloc z;
+    z[0] = 0.1f;
+    z[5] = 1.0f;
+    z[6] = 0.3f;
+    estimator.update(z, 1234);
+    for (uint16_t i = 0; i < OrientationEstimator::EKF::StateSize; ++i) {
+        EXPECT_TRUE(std::isfinite(estimator.state()[i]));
+    }
+    // Pulled most of the way to the measurement
+    EXPECT_NEAR(estimator.state()[0], 0.1f, 0.01f);
+    EXPECT_NEAR(estimator.state()[8], 1.0f, 0.01f);
+    EXPECT_NEAR(estimator.state()[9], 0.3f, 0.01f);
+
+    // Forgotten again
+    estimator.reset();
+    EXPECT_EQ(estimator.state()[8], 0.0f);
+    EXPECT_EQ(estimator.covariance()(8, 8), 1.0f);
+}
+
+}  // namespace
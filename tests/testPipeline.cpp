@@ -0,0 +1,77 @@
+#include <pipeline.h>
+#include <vector.h>
+#include <gtest/gtest.h>
+#include <vector>
+
+namespace
+{
+
+// Records what the fusion feeds an estimator
+struct RecordingEstimator
+{
+    using Measurement = mart::Vector<float, 9>;
+
+    void update(const Measurement& z, uint32_t timestamp)
+    {
+        std::vector<float> values;
+        for (uint16_t i = 0; i < Measurement::Size; ++i) {
+            values.push_back(z[i]);
+        }
+        measurements.push_back(values);
+        timestamps.push_back(timestamp);
+    }
+
+    std::vector<std::vector<float>> measurements;
+    std::vector<uint32_t> timestamps;
+};
+
+using Fusion = mart::SampleFusion<RecordingEstimator>;
+
+const Fusion::Scales SCALES = {{{0.5f, 0.5f, 0.5f},
+                                {0.25f, 0.25f, 0.25f},
+                                {1.0f, 2.0f, 4.0f}}};
+
+TEST(SampleFusionTest, waits_for_every_sensor)
+{
+    RecordingEstimator estimator;
+    Fusion fusion(estimator, SCALES);
+
+    const RawSample samples[] = {
+        {10, {2, 4, 6}, SensorId::GYROSCOPE},
+        {11, {4, 8, 12}, SensorId::ACCELEROMETER},
+        {12, {2, 4, 6}, SensorId::GYROSCOPE},
+    };
+    EXPECT_EQ(fusion.consume(samples, 3), 0u);
+    EXPECT_TRUE(estimator.measurements.empty());
+}
+
+TEST(SampleFusionTest, one_update_per_gyroscope_sample)
+{
+    RecordingEstimator estimator;
+    Fusion fusion(estimator, SCALES);
+
+    const RawSample samples[] = {
+        {10, {4, 8, 12}, SensorId::ACCELEROMETER},
+        {11, {1, 1, 1}, SensorId::MAGNETOMETER},
+        {12, {2, 4, 6}, SensorId::GYROSCOPE},
+        {13, {-2, 0, 2}, SensorId::GYROSCOPE},
+        {14, {8, 8, 8}, SensorId::ACCELEROMETER},
+    };
+    EXPECT_EQ(fusion.consume(samples, 5), 2u);
+
+    ASSERT_EQ(estimator.measurements.size(), 2u);
+    EXPECT_EQ(estimator.timestamps[0], 12u);
+    EXPECT_EQ(estimator.timestamps[1], 13u);
+
+    const std::vector<float> first = {1, 2, 3, 1, 2, 3, 1, 2, 4};
+    const std::vector<float> second = {-1, 0, 1, 1, 2, 3, 1, 2, 4};
+    EXPECT_EQ(estimator.measurements[0], first);
+    EXPECT_EQ(estimator.measurements[1], second);
+
+    // The newer acceleration is held for the next gyroscope sample
+    const RawSample next = {15, {0, 0, 0}, SensorId::GYROSCOPE};
+    EXPECT_EQ(fusion.consume(&next, 1), 1u);
+    EXPECT_FLOAT_EQ(estimator.measurements[2][3], 2);
+}
+
+}  // namespace
@@ -0,0 +1,64 @@
+#include <regshadow.h>
+#include <gtest/gtest.h>
+
+namespace
+{
+
+// Registers 0x20..0x27, 0x26 and 0x27 are status registers
+using Shadow = mart::RegisterShadow<0x20, 8>;
+constexpr uint32_t CACHEABLE = 0x3F;
+
+TEST(RegisterShadowTest, unknown_until_stored)
+{
+    Shadow shadow(CACHEABLE);
+    EXPECT_FALSE(shadow.known(0x20));
+    EXPECT_TRUE(shadow.needsWrite(0x20, 0));
+
+    shadow.store(0x20, 0x57);
+    EXPECT_TRUE(shadow.known(0x20));
+    EXPECT_EQ(shadow.value(0x20), 0x57);
+    EXPECT_FALSE(shadow.needsWrite(0x20, 0x57));
+    EXPECT_TRUE(shadow.needsWrite(0x20, 0x77));
+
+    shadow.forget();
+    EXPECT_FALSE(shadow.known(0x20));
+}
+
+TEST(RegisterShadowTest, status_and_outside_registers_are_not_kept)
+{
+    Shadow shadow(CACHEABLE);
+    const uint8_t data[] = {1, 2, 3, 4, 5, 6, 7, 8, 9};
+    shadow.store(0x1F, data, sizeof(data));
+
+    EXPECT_FALSE(shadow.known(0x1F));
+    EXPECT_EQ(shadow.value(0x20), 2);
+    EXPECT_EQ(shadow.value(0x25), 7);
+    EXPECT_FALSE(shadow.known(0x26));
+    EXPECT_FALSE(shadow.known(0x27));
+    EXPECT_TRUE(shadow.needsWrite(0x26, 8));
+}
+
+TEST(RegisterShadowTest, changed_span_of_a_profile)
+{
+    Shadow shadow(CACHEABLE);
+    const uint8_t current[] = {0x77, 0x00, 0x04, 0x38, 0x40};
+    shadow.store(0x20, current, sizeof(current));
+
+    uint8_t offset = 0xFF;
+    uint8_t count = 0xFF;
+    EXPECT_FALSE(shadow.changedSpan(0x20, current, sizeof(current), offset, count));
+
+    // Only CTRL 2 and 4 change, 3 goes along to keep one burst
+    const uint8_t profile[] = {0x77, 0x10, 0x04, 0x18, 0x40};
+    ASSERT_TRUE(shadow.changedSpan(0x20, profile, sizeof(profile), offset, count));
+    EXPECT_EQ(offset, 1);
+    EXPECT_EQ(count, 3);
+
+    // Unknown registers always have to be written
+    shadow.forget();
+    ASSERT_TRUE(shadow.changedSpan(0x20, current, sizeof(current), offset, count));
+    EXPECT_EQ(offset, 0);
+    EXPECT_EQ(count, 5);
+}
+
+}  // namespace
@@ -0,0 +1,92 @@
+#include <replay.h>
+#include <chrono>
+#include <cstdio>
+#include <gtest/gtest.h>
+#include <vector>
+
+namespace
+{
+
+using mart::ReplaySensor;
+
+class ReplaySensorTest : public ::testing::Test
+{
+protected:
+    void TearDown() override { std::remove(path_); }
+
+    void writeLog(const std::vector<RawSample>& samples)
+    {
+        std::FILE* file = std::fopen(path_, "wb");
+        ASSERT_NE(file, nullptr);
+        for (const RawSample& sample : samples) {
+            ASSERT_TRUE(ReplaySensor::writeRecord(file, sample));
+        }
+        std::fclose(file);
+    }
+
+    const char* path_ = "testReplay.log";
+};
+
+TEST_F(ReplaySensorTest, missing_log)
+{
+    ReplaySensor replay;
+    EXPECT_FALSE(replay.configure({"does/not/exist.log", 1000, false}));
+    RawSample sample;
+    EXPECT_EQ(replay.readBurst(&sample, 1), 0);
+}
+
+TEST_F(ReplaySensorTest, full_speed_round_trip)
+{
+    std::vector<RawSample> samples;
+    for (uint32_t i = 0; i < 70; ++i) {
+        const int16_t v = static_cast<int16_t>(i * 1000 - 30000);
+        samples.push_back({0xFFFFFF00u + i * 10, {v, static_cast<int16_t>(-v), -1},
+                           static_cast<SensorId>(i % 3)});
+    }
+    writeLog(samples);
+
+    ReplaySensor replay;
+    ASSERT_TRUE(replay.configure({path_, 1000, false}));
+
+    std::vector<RawSample> replayed;
+    const uint32_t total = mart::drain(replay, [&](const RawSample* burst, uint32_t count) {
+        EXPECT_LE(count, ReplaySensor::MAX_BURST);
+        replayed.insert(replayed.end(), burst, burst + count);
+    });
+
+    EXPECT_EQ(total, samples.size());
+    ASSERT_EQ(replayed.size(), samples.size());
+    for (std::size_t i = 0; i < samples.size(); ++i) {
+        EXPECT_EQ(replayed[i].timestamp, samples[i].timestamp);
+        EXPECT_EQ(replayed[i].value.x, samples[i].value.x);
+        EXPECT_EQ(replayed[i].value.y, samples[i].value.y);
+        EXPECT_EQ(replayed[i].value.z, samples[i].value.z);
+        EXPECT_EQ(replayed[i].sensor, samples[i].sensor);
+    }
+    EXPECT_TRUE(replay.finished());
+}
+
+TEST_F(ReplaySensorTest, real_time_follows_stamps)
+{
+    // 1 kHz stamps, three samples 20 ms apart across the counter wrap
+    writeLog({{0xFFFFFFF0u, {1, 0, 0}, SensorId::GYROSCOPE},
+              {0xFFFFFFF0u + 20, {2, 0, 0}, SensorId::GYROSCOPE},
+              {0xFFFFFFF0u + 40, {3, 0, 0}, SensorId::GYROSCOPE}});
+
+    ReplaySensor replay;
+    ASSERT_TRUE(replay.configure({path_, 1000, true}));
+
+    const auto start = std::chrono::steady_clock::now();
+    RawSample burst[ReplaySensor::MAX_BURST];
+    uint32_t total = 0;
+    while (!replay.finished()) {
+        total += replay.readBurst(burst, ReplaySensor::MAX_BURST);
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    EXPECT_EQ(total, 3u);
+    EXPECT_EQ(burst[0].value.x, 3);
+    EXPECT_GE(elapsed, std::chrono::milliseconds(40));
+}
+
+}  // namespace
@@ -0,0 +1,79 @@
+#include <ringbuffer.h>
+#include <gtest/gtest.h>
+#include <thread>
+
+namespace
+{
+
+TEST(RingBufferTest, push_pop_in_order)
+{
+    mart::RingBuffer<int, 4> queue;
+    EXPECT_TRUE(queue.empty());
+
+    int value = 0;
+    EXPECT_FALSE(queue.pop(value));
+
+    const int items[] = {1, 2, 3};
+    EXPECT_EQ(queue.push(items, 3), 3u);
+    EXPECT_EQ(queue.size(), 3u);
+    EXPECT_TRUE(queue.pop(value));
+    EXPECT_EQ(value, 1);
+
+    // Wraps around the end of the storage
+    const int more[] = {4, 5, 6};
+    EXPECT_EQ(queue.push(more, 3), 2u);
+    EXPECT_EQ(queue.overflows(), 1u);
+    EXPECT_FALSE(queue.push(7));
+    EXPECT_EQ(queue.overflows(), 2u);
+
+    int out[8];
+    ASSERT_EQ(queue.pop(out, 8), 4u);
+    EXPECT_EQ(out[0], 2);
+    EXPECT_EQ(out[1], 3);
+    EXPECT_EQ(out[2], 4);
+    EXPECT_EQ(out[3], 5);
+    EXPECT_TRUE(queue.empty());
+}
+
+TEST(RingBufferTest, producer_and_consumer_threads)
+{
+    static mart::RingBuffer<uint32_t, 64> queue;
+    constexpr uint32_t COUNT = 50000;
+
+    std::thread producer([] {
+        uint32_t batch[7];
+        for (uint32_t next = 0; next < COUNT;) {
+            uint32_t n = 0;
+            for (; n < 7 && next + n < COUNT; ++n) {
+                batch[n] = next + n;
+            }
+            uint32_t pushed = 0;
+            while (pushed < n) {
+                // Only push what fits so nothing counts as an overflow
+                const uint32_t space = 64 - queue.size();
+                const uint32_t chunk = n - pushed < space ? n - pushed : space;
+                pushed += queue.push(batch + pushed, chunk);
+                if (chunk == 0) {
+                    std::this_thread::yield();
+                }
+            }
+            next += n;
+        }
+    });
+
+    uint32_t expected = 0;
+    uint32_t batch[16];
+    while (expected < COUNT) {
+        const uint32_t n = queue.pop(batch, 16);
+        if (n == 0) {
+            std::this_thread::yield();
+        }
+        for (uint32_t i = 0; i < n; ++i) {
+            ASSERT_EQ(batch[i], expected++);
+        }
+    }
+    producer.join();
+    EXPECT_EQ(queue.overflows(), 0u);
+}
+
+}  // namespace
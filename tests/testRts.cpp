@@ -0,0 +1,117 @@
+#include <extkalman.h>
+#include <rts.h>
+#include <gtest/gtest.h>
+#include <vector>
+
+namespace
+{
+
+using EKF = mart::ExtendedKalmanFilter<float, 2, 1>;
+enum { Pos, Vel };
+
+EKF constantVelocity()
+{
+    return EKF(
+        [](EKF::State& next, const EKF::State& current, float dt) {
+            next[Pos] = current[Pos] + current[Vel] * dt;
+            next[Vel] = current[Vel];
+        },
+        [](const EKF::State&, EKF::ProcessMatrix& F, float dt) {
+            F(Pos, Pos) = 1;
+            F(Pos, Vel) = dt;
+            F(Vel, Pos) = 0;
+            F(Vel, Vel) = 1;
+        },
+        mart::alloc::Matrix<float, 2, 2>{1e-3f, 0, 0, 1e-2f},
+        [](const EKF::State& x, EKF::Measurement& z, float) { z[0] = x[Pos]; },
+        [](const EKF::State&, EKF::MeasurementMatrix& H, float) {
+            H(0, Pos) = 1;
+            H(0, Vel) = 0;
+        },
+        mart::alloc::Matrix<float, 1, 1>{0.25f});
+}
+
+struct Estimate {
+    float pos;
+    float vel;
+    float posVariance;
+};
+
+std::vector<Estimate> runSmoother(std::size_t ramSteps, std::size_t steps)
+{
+    mart::RtsSmoother<EKF> smoother(ramSteps,
+                                    testing::TempDir() + "rts_spill.bin");
+    auto ekf = constantVelocity();
+    EKF::Workspace ws;
+    ekf.reset(mart::alloc::Vector<float, 2>{0, 0},
+              mart::alloc::Matrix<float, 2, 2>{1, 0, 0, 1});
+
+    const float dt = 0.1f;
+    for (std::size_t k = 1; k <= steps; ++k) {
+        const float noise = (k % 2 ? 0.3f : -0.3f);
+        ekf.update(mart::alloc::Vector<float, 1>{k * dt + noise}, dt, ws);
+        EXPECT_TRUE(smoother.record(ekf, ws));
+    }
+    EXPECT_EQ(smoother.size(), steps);
+    EXPECT_EQ(smoother.spilled(), steps > ramSteps ? steps - ramSteps : 0);
+
+    std::vector<Estimate> smoothed(steps);
+    std::size_t calls = 0;
+    std::size_t expected = steps;
+    EXPECT_TRUE(smoother.smooth([&](std::size_t t, const EKF::State& mu,
+                                    const EKF::ProcessMatrix& Sigma) {
+        EXPECT_EQ(t, --expected);
+        smoothed[t] = {mu[Pos], mu[Vel], Sigma(Pos, Pos)};
+        ++calls;
+    }));
+    EXPECT_EQ(calls, steps);
+
+    // The last smoothed estimate is the filtered one
+    EXPECT_FLOAT_EQ(smoothed.back().pos, ekf.state()[Pos]);
+    EXPECT_FLOAT_EQ(smoothed.back().posVariance, ekf.covariance()(Pos, Pos));
+    return smoothed;
+}
+
+TEST(RtsSmootherTest, removes_measurement_noise)
+{
+    const auto smoothed = runSmoother(1000, 200);
+    for (std::size_t t = 20; t < 180; ++t) {
+        EXPECT_NEAR(smoothed[t].pos, (t + 1) * 0.1f, 0.1f);
+        EXPECT_NEAR(smoothed[t].vel, 1, 0.1f);
+    }
+}
+
+TEST(RtsSmootherTest, spilled_steps_give_same_result)
+{
+    const auto inMemory = runSmoother(1000, 200);
+    const auto spilled  = runSmoother(16, 200);
+    for (std::size_t t = 0; t < inMemory.size(); ++t) {
+        EXPECT_FLOAT_EQ(inMemory[t].pos, spilled[t].pos);
+        EXPECT_FLOAT_EQ(inMemory[t].vel, spilled[t].vel);
+        EXPECT_FLOAT_EQ(inMemory[t].posVariance, spilled[t].posVariance);
+    }
+}
+
+TEST(SmootherTest, pack_symmetric)
+{
+    const mart::alloc::Matrix<float, 3, 3> X = {
+        1, 2, 3,
+        2, 4, 5,
+        3, 5, 6
+    };
+    float packed[mart::packedSize<3>()];
+    mart::packSymmetric(X, packed);
+    for (uint16_t i = 0; i < 6; ++i) {
+        EXPECT_FLOAT_EQ(packed[i], i + 1);
+    }
+
+    mart::alloc::Matrix<float, 3, 3> Y;
+    mart::unpackSymmetric(packed, Y);
+    for (uint16_t row = 0; row < 3; ++row) {
+        for (uint16_t col = 0; col < 3; ++col) {
+            EXPECT_FLOAT_EQ(X(row, col), Y(row, col));
+        }
+    }
+}
+
+}  // namespace
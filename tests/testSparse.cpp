@@ -0,0 +1,91 @@
+#include <sparse.h>
+#include <gtest/gtest.h>
+
+namespace
+{
+
+using mart::CooMatrix;
+using mart::CsrMatrix;
+using mart::DynMatrix;
+using mart::DynVector;
+
+// 2x4 H picking state 1 and the difference of states 3 and 0
+CsrMatrix<double> makeH(mart::Arena& arena)
+{
+    auto coo = CooMatrix<double>::allocate(arena, 2, 4, 4);
+    coo.insert(1, 3, 1);
+    coo.insert(0, 1, 2);
+    coo.insert(1, 0, -1);
+    EXPECT_FALSE(coo.insert(2, 0, 1));
+    return CsrMatrix<double>::fromCoo(arena, coo);
+}
+
+TEST(SparseTest, csr_from_coo)
+{
+    mart::StaticArena<512> arena;
+    const auto H = makeH(arena);
+    ASSERT_TRUE(H.valid());
+    EXPECT_EQ(H.nonZeros(), 3u);
+    EXPECT_EQ(H.rowEnd(0) - H.rowBegin(0), 1u);
+    EXPECT_EQ(H(0, 1), 2);
+    EXPECT_EQ(H(1, 3), 1);
+    EXPECT_EQ(H(1, 0), -1);
+    EXPECT_EQ(H(1, 1), 0);
+
+    auto dense = DynMatrix<double>::allocate(arena, 2, 4);
+    ASSERT_TRUE(mart::toDense(H, dense));
+    const auto back = CsrMatrix<double>::fromDense(arena, dense);
+    EXPECT_EQ(back.nonZeros(), 3u);
+    EXPECT_EQ(back(1, 0), -1);
+}
+
+TEST(SparseTest, products_match_dense)
+{
+    mart::StaticArena<2048> arena;
+    const auto H = makeH(arena);
+    mart::alloc::Matrix<double, 4, 4> fixedP = {
+        4, 1, 0, 2,
+        1, 3, 1, 0,
+        0, 1, 5, 1,
+        2, 0, 1, 6
+    };
+    const DynMatrix<double> P(fixedP);
+    auto denseH = DynMatrix<double>::allocate(arena, 2, 4);
+    mart::toDense(H, denseH);
+
+    auto HP = DynMatrix<double>::allocate(arena, 2, 4);
+    auto expectedHP = DynMatrix<double>::allocate(arena, 2, 4);
+    ASSERT_TRUE(mart::multiply(H, P, HP));
+    mart::multiply(denseH, P, expectedHP);
+
+    auto PHT = DynMatrix<double>::allocate(arena, 4, 2);
+    auto expectedPHT = DynMatrix<double>::allocate(arena, 4, 2);
+    ASSERT_TRUE(mart::multiplyTransposed(P, H, PHT));
+    mart::multiply(P, mart::transposed(denseH), expectedPHT);
+
+    auto S = DynMatrix<double>::allocate(arena, 2, 2);
+    auto expectedS = DynMatrix<double>::allocate(arena, 2, 2);
+    ASSERT_TRUE(mart::sandwich(H, P, S));
+    mart::multiply(expectedHP, mart::transposed(denseH), expectedS);
+
+    for (uint16_t row = 0; row < 2; ++row) {
+        for (uint16_t col = 0; col < 4; ++col) {
+            EXPECT_DOUBLE_EQ(HP(row, col), expectedHP(row, col));
+            EXPECT_DOUBLE_EQ(PHT(col, row), expectedPHT(col, row));
+        }
+        for (uint16_t col = 0; col < 2; ++col) {
+            EXPECT_DOUBLE_EQ(S(row, col), expectedS(row, col));
+        }
+    }
+
+    const mart::alloc::Vector<double, 4> x{1, 2, 3, 4};
+    auto y = DynVector<double>::allocate(arena, 2);
+    ASSERT_TRUE(mart::multiply(H, DynVector<double>(x), y));
+    EXPECT_EQ(y[0], 4);
+    EXPECT_EQ(y[1], 3);
+
+    auto wrong = DynMatrix<double>::allocate(arena, 3, 3);
+    EXPECT_FALSE(mart::sandwich(H, P, wrong));
+}
+
+}  // namespace
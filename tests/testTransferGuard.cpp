@@ -0,0 +1,104 @@
+#include <transferguard.h>
+#include <gtest/gtest.h>
+
+namespace
+{
+
+using mart::TransferGuard;
+
+TEST(TransferGuardTest, latency_of_completed_transfers)
+{
+    TransferGuard guard;
+    guard.configure(100, 10, nullptr);
+
+    guard.start(0xFFFFFFF0u);
+    guard.complete(0x10u);
+    guard.start(0x100u);
+    guard.complete(0x108u);
+
+    EXPECT_EQ(guard.stats().transfers, 2u);
+    EXPECT_EQ(guard.stats().lastLatency, 0x8u);
+    EXPECT_EQ(guard.stats().maxLatency, 0x20u);
+    EXPECT_EQ(guard.stats().errors, 0u);
+}
+
+TEST(TransferGuardTest, timeout_across_wrap)
+{
+    TransferGuard guard;
+    guard.configure(100, 10, nullptr);
+
+    guard.start(0xFFFFFFC0u);
+    EXPECT_FALSE(guard.overdue(0x20u));
+    EXPECT_TRUE(guard.overdue(0x30u));
+
+    EXPECT_FALSE(guard.expire(0x20u, true));
+    EXPECT_FALSE(guard.expire(0x30u, false));
+    EXPECT_TRUE(guard.expire(0x30u, true));
+    EXPECT_TRUE(guard.failed());
+    EXPECT_EQ(guard.stats().timeouts, 1u);
+    EXPECT_EQ(guard.stats().errors, 1u);
+
+    guard.configure(0, 10, nullptr);
+    EXPECT_FALSE(guard.failed());
+    EXPECT_FALSE(guard.overdue(0x7FFFFFFFu));
+}
+
+TEST(TransferGuardTest, retries_back_off_until_success)
+{
+    TransferGuard guard;
+    guard.configure(100, 10, nullptr);
+
+    guard.fail(1000);
+    EXPECT_FALSE(guard.retryDue(1009));
+    EXPECT_TRUE(guard.retryDue(1010));
+
+    // Doubling with every failure in a row, up to 16 times
+    guard.fail(2000);
+    EXPECT_FALSE(guard.retryDue(2019));
+    EXPECT_TRUE(guard.retryDue(2020));
+    for (int i = 0; i < 10; ++i) {
+        guard.fail(3000);
+    }
+    EXPECT_FALSE(guard.retryDue(3159));
+    EXPECT_TRUE(guard.retryDue(3160));
+
+    guard.start(4000);
+    guard.complete(4001);
+    guard.fail(5000);
+    EXPECT_TRUE(guard.retryDue(5010));
+    EXPECT_EQ(guard.stats().errors, 13u);
+}
+
+int recoveries = 0;
+
+TEST(TransferGuardTest, service_recovers_once_retry_is_due)
+{
+    TransferGuard guard;
+    recoveries = 0;
+    guard.configure(100, 10, [] { ++recoveries; });
+
+    EXPECT_FALSE(guard.service(0));
+    guard.fail(1000);
+    EXPECT_FALSE(guard.service(1009));
+    EXPECT_TRUE(guard.failed());
+
+    EXPECT_TRUE(guard.service(1010));
+    EXPECT_FALSE(guard.failed());
+    EXPECT_EQ(recoveries, 1);
+    EXPECT_EQ(guard.stats().recoveries, 1u);
+    EXPECT_FALSE(guard.service(1011));
+
+    // Blocking failures recover right away
+    guard.countError();
+    guard.recover();
+    EXPECT_EQ(recoveries, 2);
+    EXPECT_EQ(guard.stats().errors, 2u);
+
+    // Without a hook the driver still restarts
+    guard.configure(100, 10, nullptr);
+    guard.fail(2000);
+    EXPECT_TRUE(guard.service(2010));
+    EXPECT_EQ(guard.stats().recoveries, 2u);
+}
+
+}  // namespace
@@ -0,0 +1,64 @@
+#include <gtest/gtest.h>
+#include <vanloan.h>
+#include <cmath>
+
+namespace
+{
+
+using mart::alloc::Matrix;
+
+TEST(VanLoanTest, scalar_model)
+{
+    // dx/dt = a * x + w: Phi = e^(a*dt), Q_d = q * (e^(2*a*dt) - 1) / (2*a)
+    const double a = -0.7, q = 0.3, dt = 0.5;
+    const Matrix<double, 1, 1> A{a};
+    const Matrix<double, 1, 1> Qc{q};
+    Matrix<double, 1, 1> Phi, Qd;
+    mart::vanLoan<double, 1>(A, Qc, dt, Phi, Qd);
+
+    EXPECT_NEAR(Phi(0, 0), std::exp(a * dt), 1e-12);
+    EXPECT_NEAR(Qd(0, 0), q * (std::exp(2 * a * dt) - 1) / (2 * a), 1e-12);
+}
+
+TEST(VanLoanTest, constant_velocity_model)
+{
+    // Position and velocity driven by white acceleration noise
+    const double q = 2, dt = 0.1;
+    const Matrix<double, 2, 2> A{0, 1, 0, 0};
+    const Matrix<double, 2, 2> GQcGT{0, 0, 0, q};
+    Matrix<double, 2, 2> Phi, Qd;
+    mart::vanLoan<double, 2>(A, GQcGT, dt, Phi, Qd);
+
+    EXPECT_NEAR(Phi(0, 0), 1, 1e-12);
+    EXPECT_NEAR(Phi(0, 1), dt, 1e-12);
+    EXPECT_NEAR(Phi(1, 0), 0, 1e-12);
+    EXPECT_NEAR(Phi(1, 1), 1, 1e-12);
+
+    EXPECT_NEAR(Qd(0, 0), q * dt * dt * dt / 3, 1e-12);
+    EXPECT_NEAR(Qd(0, 1), q * dt * dt / 2, 1e-12);
+    EXPECT_NEAR(Qd(1, 0), q * dt * dt / 2, 1e-12);
+    EXPECT_NEAR(Qd(1, 1), q * dt, 1e-12);
+}
+
+TEST(VanLoanTest, cache_per_dt)
+{
+    const Matrix<float, 2, 2> A{0, 1, 0, 0};
+    const Matrix<float, 2, 2> GQcGT{0, 0, 0, 1};
+    mart::VanLoanCache<float, 2, 2> cache(A, GQcGT, 1e-6f);
+
+    const auto& first = cache(0.01f);
+    const auto& again = cache(0.01f + 1e-7f);
+    EXPECT_EQ(&first, &again);
+    EXPECT_EQ(cache.misses(), 1u);
+    EXPECT_FLOAT_EQ(first.Phi(0, 1), 0.01f);
+
+    const auto& other = cache(0.02f);
+    EXPECT_NE(&first, &other);
+    EXPECT_FLOAT_EQ(other.Phi(0, 1), 0.02f);
+    EXPECT_FLOAT_EQ(other.Qd(1, 1), 0.02f);
+
+    cache(0.01f);
+    EXPECT_EQ(cache.misses(), 2u);
+}
+
+}  // namespace
@@ -38,6 +38,24 @@ TEST(VectorTest, assign_add)
     EXPECT_EQ(x[1], 6);
 }
 
+TEST(VectorTest, subtract)
+{
+    const Vector<int, 2> x{3, 4};
+    const Vector<int, 2> y{8, 2};
+    const auto z = x - y;
+    EXPECT_EQ(z[0], -5);
+    EXPECT_EQ(z[1], 2);
+}
+
+TEST(VectorTest, assign_subtract)
+{
+    Vector<int, 2> x{3, 4};
+    const Vector<int, 2> y{8, 2};
+    x -= y;
+    EXPECT_EQ(x[0], -5);
+    EXPECT_EQ(x[1], 2);
+}
+
 TEST(VectorTest, mul)
 {
     const Vector<int, 2> x{3, 4};
@@ -72,4 +90,103 @@ TEST(VectorTest, partition)
     EXPECT_EQ(y[1][1], 2);
 }
 
+TEST(VectorTest, block)
+{
+    Vector<int, 6> x{7, 4, 10, 2, 5, 1};
+    auto y = x.block<1, 2>();
+    EXPECT_EQ(y[0], 10);
+    EXPECT_EQ(y[1], 2);
+
+    y[1] = 9;
+    EXPECT_EQ(x[3], 9);
+}
+
+TEST(VectorTest, strided_view)
+{
+    Vector<int, 6> x{7, 4, 10, 2, 5, 1};
+    mart::Vector<int, 3> even(x.raw(), 2);
+    EXPECT_EQ(even[0], 7);
+    EXPECT_EQ(even[1], 10);
+    EXPECT_EQ(even[2], 5);
+
+    even += Vector<int, 3>{1, 1, 1};
+    EXPECT_EQ(x[4], 6);
+    EXPECT_EQ(x[5], 1);
+
+    const auto tail = even.subvec<2>(1);
+    EXPECT_EQ(tail[0], 11);
+    EXPECT_EQ(tail[1], 6);
+
+    const Vector<int, 3> copy(even);
+    EXPECT_EQ(copy[2], 6);
+}
+
+TEST(VectorTest, dot_and_norm)
+{
+    const Vector<float, 3> x{1, 2, 2};
+    const Vector<float, 3> y{3, -1, 4};
+    EXPECT_FLOAT_EQ(mart::dot(x, y), 9);
+    EXPECT_FLOAT_EQ(mart::norm(x), 3);
+}
+
+TEST(VectorTest, cross)
+{
+    const Vector<int, 3> x{1, 2, 3};
+    const Vector<int, 3> y{4, 5, 6};
+    const auto z = mart::cross(x, y);
+    EXPECT_EQ(z[0], -3);
+    EXPECT_EQ(z[1], 6);
+    EXPECT_EQ(z[2], -3);
+}
+
+TEST(VectorTest, cross_in_place)
+{
+    Vector<int, 3> x{1, 2, 3};
+    const Vector<int, 3> y{4, 5, 6};
+    mart::cross(x, y, x);
+    EXPECT_EQ(x[0], -3);
+    EXPECT_EQ(x[1], 6);
+    EXPECT_EQ(x[2], -3);
+}
+
+TEST(VectorTest, skew_matches_cross)
+{
+    const Vector<int, 3> w{1, 2, 3};
+    const Vector<int, 3> v{4, 5, 6};
+    const auto S = mart::skew(w) * 2;
+
+    const auto product = S * v;
+    const auto expected = mart::cross(w, v) * 2;
+    for (uint16_t row = 0; row < 3; ++row) {
+        EXPECT_EQ(product[row], expected[row]);
+        int viaElements = 0;
+        for (uint16_t col = 0; col < 3; ++col) {
+            viaElements += S(row, col) * v[col];
+        }
+        EXPECT_EQ(viaElements, expected[row]);
+        EXPECT_EQ(S(row, row), 0);
+    }
+
+    // -w_k when col follows row cyclically
+    EXPECT_EQ(S(0, 1), -2 * w[2]);
+    EXPECT_EQ(S(1, 0), 2 * w[2]);
+    EXPECT_EQ(S(1, 2), -2 * w[0]);
+    EXPECT_EQ(S(0, 2), 2 * w[1]);
+}
+
+TEST(VectorTest, skew_of_temporary)
+{
+    const Vector<int, 3> a{1, 0, 0};
+    const Vector<int, 3> b{0, 1, 0};
+    // w = a x b = (0, 0, 1) only lives until the end of the statement
+    const auto S = mart::skew(mart::cross(a, b));
+    const Vector<int, 3> overwrite = mart::cross(b, a);
+
+    EXPECT_EQ(S(0, 1), -1);
+    EXPECT_EQ(S(1, 0), 1);
+    const auto product = S * a;
+    EXPECT_EQ(product[1], 1);
+    EXPECT_EQ(overwrite[2], -1);
+}
+
 }  // namespace